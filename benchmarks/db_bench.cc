@@ -13,6 +13,7 @@
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/write_batch.h"
 #include "port/port.h"
 #include "util/crc32c.h"
@@ -34,8 +35,11 @@
 //      readreverse   -- read N times in reverse order
 //      readrandom    -- read N times in random order
 //      readmissing   -- read N missing keys in random order
+//      multireadrandom -- read N times in random order, --multiget_batch
+//                         keys per MultiGet() call
 //      readhot       -- read N times in random order from 1% section of DB
-//      seekrandom    -- N random seeks
+//      seekrandom    -- N random seeks, bounded to the prefix of the
+//                       target if --prefix_seek
 //      seekordered   -- N ordered seeks
 //      open          -- cost of opening a DB
 //      crc32c        -- repeated crc32c of 4K of data
@@ -43,6 +47,7 @@
 //      compact     -- Compact the entire DB
 //      stats       -- Print DB stats
 //      sstables    -- Print sstable info
+//      writestats  -- Print write batch group stats
 //      heapprofile -- Dump a heap profile (if supported by this port)
 static const char* FLAGS_benchmarks =
     "fillseq,"
@@ -73,6 +78,9 @@ static int FLAGS_reads = -1;
 // Number of concurrent threads to run.
 static int FLAGS_threads = 1;
 
+// Number of keys read by each MultiGet() call of multireadrandom.
+static int FLAGS_multiget_batch = 100;
+
 // Size of each value
 static int FLAGS_value_size = 100;
 
@@ -90,6 +98,29 @@ static bool FLAGS_comparisons = false;
 // (initialized to default value by "main")
 static int FLAGS_write_buffer_size = 0;
 
+// Maximum number of memtables held in memory, including those waiting to
+// be compacted (initialized to default value by "main")
+static int FLAGS_max_write_buffer_number = 0;
+
+// Rate in bytes per second that writes are slowed down to when compactions
+// fall behind (initialized to default value by "main")
+static int FLAGS_delayed_write_rate = 0;
+
+// Microseconds a sync write may wait for more writers to join its group
+static int FLAGS_sync_group_commit_micros = 0;
+
+// Stop waiting for more sync writers once this many bytes are queued
+static int FLAGS_sync_group_commit_bytes = 0;
+
+// Preallocate log files in chunks of this many bytes
+static int FLAGS_log_preallocation_block_size = 0;
+
+// Number of obsolete log files to keep for reuse
+static int FLAGS_recycle_log_file_num = 0;
+
+// Compression applied to log records (0: none, 1: snappy, 2: zstd)
+static int FLAGS_wal_compression = 0;
+
 // Number of bytes written to each file.
 // (initialized to default value by "main")
 static int FLAGS_max_file_size = 0;
@@ -98,10 +129,29 @@ static int FLAGS_max_file_size = 0;
 // (initialized to default value by "main")
 static int FLAGS_block_size = 0;
 
+// Approximate size of index partitions.  Zero means an unpartitioned index.
+static int FLAGS_index_partition_size = 0;
+
+// If true, data blocks have a hash index for point lookups.
+static bool FLAGS_data_block_hash_index = false;
+
 // Number of bytes to use as a cache of uncompressed data.
 // Negative means use default settings.
 static int FLAGS_cache_size = -1;
 
+// Fraction of the cache reserved for high-priority entries.
+static double FLAGS_cache_high_pri_pool_ratio = 0;
+
+// If true, index and filter blocks are kept in the cache.
+static bool FLAGS_cache_index_and_filter_blocks = false;
+
+// If true, index and filter blocks of level-0 files stay in the cache.
+static bool FLAGS_pin_l0_filter_and_index_blocks_in_cache = false;
+
+// Number of bytes to use as a cache of point lookup results.
+// Zero means no row cache.
+static int FLAGS_row_cache_size = 0;
+
 // Maximum number of files to keep open at the same time (use default if == 0)
 static int FLAGS_open_files = 0;
 
@@ -109,6 +159,34 @@ static int FLAGS_open_files = 0;
 // Negative means use default settings.
 static int FLAGS_bloom_bits = -1;
 
+// If true, use NewCacheLocalBloomFilterPolicy() for bloom filters.
+static bool FLAGS_cache_local_bloom = false;
+
+// If positive, use NewBinaryFuseFilterPolicy() with this many fingerprint
+// bits instead of bloom filters.
+static int FLAGS_fuse_filter_bits = 0;
+
+// If true, tables store one filter over all of their keys.
+static bool FLAGS_full_table_filter = false;
+
+// Memtable representation (0: skiplist, 1: hash of skiplists, 2: vector)
+static int FLAGS_memtable_rep = 0;
+
+// Number of hash buckets of hash memtables (use default if == 0)
+static int FLAGS_memtable_hash_bucket_count = 0;
+
+// Huge page size used for memtable memory (none if == 0)
+static int FLAGS_memtable_huge_page_size = 0;
+
+// Fraction of write_buffer_size used for memtable bloom filters
+static double FLAGS_memtable_bloom_size_ratio = 0;
+
+// Length of the key prefix used by prefix_extractor (none if == 0)
+static int FLAGS_prefix_size = 0;
+
+// If true, seekrandom uses ReadOptions::prefix_same_as_start
+static bool FLAGS_prefix_seek = false;
+
 // Common key prefix length.
 static int FLAGS_key_prefix = 0;
 
@@ -120,9 +198,18 @@ static bool FLAGS_use_existing_db = false;
 // If true, reuse existing log/MANIFEST files when re-opening a database.
 static bool FLAGS_reuse_logs = false;
 
+// If true, non-sync writes are not appended to the log.
+static bool FLAGS_disable_wal = false;
+
 // If true, use compression.
 static bool FLAGS_compression = true;
 
+// If true, pipeline log writes and memtable inserts of concurrent writers.
+static bool FLAGS_enable_pipelined_write = false;
+
+// If true, writers of a batch group insert into the memtable in parallel.
+static bool FLAGS_allow_concurrent_memtable_write = false;
+
 // Use the db with the following name.
 static const char* FLAGS_db = nullptr;
 
@@ -425,10 +512,24 @@ void Uncompress(
 
 }  // namespace
 
+// Returns the filter policy selected by the flags, or nullptr.
+static const FilterPolicy* NewFilterPolicy() {
+  if (FLAGS_fuse_filter_bits > 0) {
+    return NewBinaryFuseFilterPolicy(FLAGS_fuse_filter_bits);
+  }
+  if (FLAGS_bloom_bits < 0) {
+    return nullptr;
+  }
+  return FLAGS_cache_local_bloom ? NewCacheLocalBloomFilterPolicy(FLAGS_bloom_bits)
+                                 : NewBloomFilterPolicy(FLAGS_bloom_bits);
+}
+
 class Benchmark {
  private:
   Cache* cache_;
+  Cache* row_cache_;
   const FilterPolicy* filter_policy_;
+  const SliceTransform* prefix_extractor_;
   DB* db_;
   int num_;
   int value_size_;
@@ -519,10 +620,16 @@ class Benchmark {
 
  public:
   Benchmark()
-      : cache_(FLAGS_cache_size >= 0 ? NewLRUCache(FLAGS_cache_size) : nullptr),
-        filter_policy_(FLAGS_bloom_bits >= 0
-                           ? NewBloomFilterPolicy(FLAGS_bloom_bits)
-                           : nullptr),
+      : cache_(FLAGS_cache_size >= 0
+                   ? NewLRUCache(FLAGS_cache_size,
+                                 FLAGS_cache_high_pri_pool_ratio)
+                   : nullptr),
+        row_cache_(FLAGS_row_cache_size > 0 ? NewLRUCache(FLAGS_row_cache_size)
+                                            : nullptr),
+        filter_policy_(NewFilterPolicy()),
+        prefix_extractor_(FLAGS_prefix_size > 0
+                              ? NewFixedPrefixTransform(FLAGS_prefix_size)
+                              : nullptr),
         db_(nullptr),
         num_(FLAGS_num),
         value_size_(FLAGS_value_size),
@@ -546,7 +653,9 @@ class Benchmark {
   ~Benchmark() {
     delete db_;
     delete cache_;
+    delete row_cache_;
     delete filter_policy_;
+    delete prefix_extractor_;
   }
 
   void Run() {
@@ -571,6 +680,7 @@ class Benchmark {
       value_size_ = FLAGS_value_size;
       entries_per_batch_ = 1;
       write_options_ = WriteOptions();
+      write_options_.disable_wal = FLAGS_disable_wal;
 
       void (Benchmark::*method)(ThreadState*) = nullptr;
       bool fresh_db = false;
@@ -597,6 +707,7 @@ class Benchmark {
         fresh_db = true;
         num_ /= 1000;
         write_options_.sync = true;
+        write_options_.disable_wal = false;
         method = &Benchmark::WriteRandom;
       } else if (name == Slice("fill100K")) {
         fresh_db = true;
@@ -609,6 +720,8 @@ class Benchmark {
         method = &Benchmark::ReadReverse;
       } else if (name == Slice("readrandom")) {
         method = &Benchmark::ReadRandom;
+      } else if (name == Slice("multireadrandom")) {
+        method = &Benchmark::MultiReadRandom;
       } else if (name == Slice("readmissing")) {
         method = &Benchmark::ReadMissing;
       } else if (name == Slice("seekrandom")) {
@@ -645,6 +758,8 @@ class Benchmark {
         PrintStats("leveldb.stats");
       } else if (name == Slice("sstables")) {
         PrintStats("leveldb.sstables");
+      } else if (name == Slice("writestats")) {
+        PrintStats("leveldb.write-group-stats");
       } else {
         if (!name.empty()) {  // No error message for empty name
           std::fprintf(stderr, "unknown benchmark '%s'\n",
@@ -805,15 +920,40 @@ class Benchmark {
     options.env = g_env;
     options.create_if_missing = !FLAGS_use_existing_db;
     options.block_cache = cache_;
+    options.cache_index_and_filter_blocks = FLAGS_cache_index_and_filter_blocks;
+    options.pin_l0_filter_and_index_blocks_in_cache =
+        FLAGS_pin_l0_filter_and_index_blocks_in_cache;
+    options.row_cache = row_cache_;
     options.write_buffer_size = FLAGS_write_buffer_size;
+    options.max_write_buffer_number = FLAGS_max_write_buffer_number;
+    options.delayed_write_rate = FLAGS_delayed_write_rate;
+    options.sync_group_commit_micros = FLAGS_sync_group_commit_micros;
+    options.sync_group_commit_bytes = FLAGS_sync_group_commit_bytes;
+    options.log_preallocation_block_size = FLAGS_log_preallocation_block_size;
+    options.recycle_log_file_num = FLAGS_recycle_log_file_num;
+    options.wal_compression =
+        static_cast<CompressionType>(FLAGS_wal_compression);
     options.max_file_size = FLAGS_max_file_size;
     options.block_size = FLAGS_block_size;
+    options.index_partition_size = FLAGS_index_partition_size;
+    options.data_block_hash_index = FLAGS_data_block_hash_index;
     if (FLAGS_comparisons) {
       options.comparator = &count_comparator_;
     }
     options.max_open_files = FLAGS_open_files;
     options.filter_policy = filter_policy_;
+    options.full_table_filter = FLAGS_full_table_filter;
+    options.memtable_rep = static_cast<MemTableRepType>(FLAGS_memtable_rep);
+    if (FLAGS_memtable_hash_bucket_count > 0) {
+      options.memtable_hash_bucket_count = FLAGS_memtable_hash_bucket_count;
+    }
+    options.memtable_huge_page_size = FLAGS_memtable_huge_page_size;
+    options.memtable_bloom_size_ratio = FLAGS_memtable_bloom_size_ratio;
+    options.prefix_extractor = prefix_extractor_;
     options.reuse_logs = FLAGS_reuse_logs;
+    options.enable_pipelined_write = FLAGS_enable_pipelined_write;
+    options.allow_concurrent_memtable_write =
+        FLAGS_allow_concurrent_memtable_write;
     options.compression =
         FLAGS_compression ? kSnappyCompression : kNoCompression;
     Status s = DB::Open(options, FLAGS_db, &db_);
@@ -909,6 +1049,34 @@ class Benchmark {
     thread->stats.AddMessage(msg);
   }
 
+  void MultiReadRandom(ThreadState* thread) {
+    ReadOptions options;
+    const int batch = std::max(1, FLAGS_multiget_batch);
+    std::vector<KeyBuffer> keys(batch);
+    std::vector<Slice> key_slices(batch);
+    std::vector<std::string> values(batch);
+    std::vector<Status> statuses(batch);
+    int found = 0;
+    for (int i = 0; i < reads_; i += batch) {
+      const int n = std::min(batch, reads_ - i);
+      for (int j = 0; j < n; j++) {
+        keys[j].Set(thread->rand.Uniform(FLAGS_num));
+        key_slices[j] = keys[j].slice();
+      }
+      db_->MultiGet(options, n, key_slices.data(), values.data(),
+                    statuses.data());
+      for (int j = 0; j < n; j++) {
+        if (statuses[j].ok()) {
+          found++;
+        }
+        thread->stats.FinishedSingleOp();
+      }
+    }
+    char msg[100];
+    std::snprintf(msg, sizeof(msg), "(%d of %d found)", found, reads_);
+    thread->stats.AddMessage(msg);
+  }
+
   void ReadMissing(ThreadState* thread) {
     ReadOptions options;
     std::string value;
@@ -937,6 +1105,7 @@ class Benchmark {
 
   void SeekRandom(ThreadState* thread) {
     ReadOptions options;
+    options.prefix_same_as_start = FLAGS_prefix_seek;
     int found = 0;
     KeyBuffer key;
     for (int i = 0; i < reads_; i++) {
@@ -1065,6 +1234,8 @@ class Benchmark {
 
 int main(int argc, char** argv) {
   FLAGS_write_buffer_size = leveldb::Options().write_buffer_size;
+  FLAGS_max_write_buffer_number = leveldb::Options().max_write_buffer_number;
+  FLAGS_delayed_write_rate = leveldb::Options().delayed_write_rate;
   FLAGS_max_file_size = leveldb::Options().max_file_size;
   FLAGS_block_size = leveldb::Options().block_size;
   FLAGS_open_files = leveldb::Options().max_open_files;
@@ -1078,6 +1249,9 @@ int main(int argc, char** argv) {
       FLAGS_benchmarks = argv[i] + strlen("--benchmarks=");
     } else if (sscanf(argv[i], "--compression_ratio=%lf%c", &d, &junk) == 1) {
       FLAGS_compression_ratio = d;
+    } else if (sscanf(argv[i], "--memtable_bloom_size_ratio=%lf%c", &d,
+                      &junk) == 1) {
+      FLAGS_memtable_bloom_size_ratio = d;
     } else if (sscanf(argv[i], "--histogram=%d%c", &n, &junk) == 1 &&
                (n == 0 || n == 1)) {
       FLAGS_histogram = n;
@@ -1090,9 +1264,20 @@ int main(int argc, char** argv) {
     } else if (sscanf(argv[i], "--reuse_logs=%d%c", &n, &junk) == 1 &&
                (n == 0 || n == 1)) {
       FLAGS_reuse_logs = n;
+    } else if (sscanf(argv[i], "--disable_wal=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_disable_wal = n;
     } else if (sscanf(argv[i], "--compression=%d%c", &n, &junk) == 1 &&
                (n == 0 || n == 1)) {
       FLAGS_compression = n;
+    } else if (sscanf(argv[i], "--enable_pipelined_write=%d%c", &n, &junk) ==
+                   1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_enable_pipelined_write = n;
+    } else if (sscanf(argv[i], "--allow_concurrent_memtable_write=%d%c", &n,
+                      &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_allow_concurrent_memtable_write = n;
     } else if (sscanf(argv[i], "--num=%d%c", &n, &junk) == 1) {
       FLAGS_num = n;
     } else if (sscanf(argv[i], "--reads=%d%c", &n, &junk) == 1) {
@@ -1103,16 +1288,79 @@ int main(int argc, char** argv) {
       FLAGS_value_size = n;
     } else if (sscanf(argv[i], "--write_buffer_size=%d%c", &n, &junk) == 1) {
       FLAGS_write_buffer_size = n;
+    } else if (sscanf(argv[i], "--max_write_buffer_number=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_max_write_buffer_number = n;
+    } else if (sscanf(argv[i], "--delayed_write_rate=%d%c", &n, &junk) == 1) {
+      FLAGS_delayed_write_rate = n;
+    } else if (sscanf(argv[i], "--sync_group_commit_micros=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_sync_group_commit_micros = n;
+    } else if (sscanf(argv[i], "--sync_group_commit_bytes=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_sync_group_commit_bytes = n;
+    } else if (sscanf(argv[i], "--log_preallocation_block_size=%d%c", &n,
+                      &junk) == 1) {
+      FLAGS_log_preallocation_block_size = n;
+    } else if (sscanf(argv[i], "--recycle_log_file_num=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_recycle_log_file_num = n;
+    } else if (sscanf(argv[i], "--wal_compression=%d%c", &n, &junk) == 1) {
+      FLAGS_wal_compression = n;
     } else if (sscanf(argv[i], "--max_file_size=%d%c", &n, &junk) == 1) {
       FLAGS_max_file_size = n;
     } else if (sscanf(argv[i], "--block_size=%d%c", &n, &junk) == 1) {
       FLAGS_block_size = n;
+    } else if (sscanf(argv[i], "--index_partition_size=%d%c", &n, &junk) ==
+               1) {
+      FLAGS_index_partition_size = n;
+    } else if (sscanf(argv[i], "--data_block_hash_index=%d%c", &n, &junk) ==
+                   1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_data_block_hash_index = n;
     } else if (sscanf(argv[i], "--key_prefix=%d%c", &n, &junk) == 1) {
       FLAGS_key_prefix = n;
     } else if (sscanf(argv[i], "--cache_size=%d%c", &n, &junk) == 1) {
       FLAGS_cache_size = n;
+    } else if (sscanf(argv[i], "--cache_high_pri_pool_ratio=%lf%c", &d,
+                      &junk) == 1) {
+      FLAGS_cache_high_pri_pool_ratio = d;
+    } else if (sscanf(argv[i], "--cache_index_and_filter_blocks=%d%c", &n,
+                      &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_cache_index_and_filter_blocks = n;
+    } else if (sscanf(argv[i],
+                      "--pin_l0_filter_and_index_blocks_in_cache=%d%c", &n,
+                      &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_pin_l0_filter_and_index_blocks_in_cache = n;
+    } else if (sscanf(argv[i], "--row_cache_size=%d%c", &n, &junk) == 1) {
+      FLAGS_row_cache_size = n;
     } else if (sscanf(argv[i], "--bloom_bits=%d%c", &n, &junk) == 1) {
       FLAGS_bloom_bits = n;
+    } else if (sscanf(argv[i], "--cache_local_bloom=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_cache_local_bloom = n;
+    } else if (sscanf(argv[i], "--fuse_filter_bits=%d%c", &n, &junk) == 1) {
+      FLAGS_fuse_filter_bits = n;
+    } else if (sscanf(argv[i], "--full_table_filter=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_full_table_filter = n;
+    } else if (sscanf(argv[i], "--memtable_rep=%d%c", &n, &junk) == 1) {
+      FLAGS_memtable_rep = n;
+    } else if (sscanf(argv[i], "--memtable_huge_page_size=%d%c", &n,
+                      &junk) == 1) {
+      FLAGS_memtable_huge_page_size = n;
+    } else if (sscanf(argv[i], "--memtable_hash_bucket_count=%d%c", &n,
+                      &junk) == 1) {
+      FLAGS_memtable_hash_bucket_count = n;
+    } else if (sscanf(argv[i], "--prefix_size=%d%c", &n, &junk) == 1) {
+      FLAGS_prefix_size = n;
+    } else if (sscanf(argv[i], "--prefix_seek=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_prefix_seek = n;
+    } else if (sscanf(argv[i], "--multiget_batch=%d%c", &n, &junk) == 1) {
+      FLAGS_multiget_batch = n;
     } else if (sscanf(argv[i], "--open_files=%d%c", &n, &junk) == 1) {
       FLAGS_open_files = n;
     } else if (strncmp(argv[i], "--db=", 5) == 0) {
@@ -0,0 +1,79 @@
+// Copyright (c) 2019 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "db/dbformat.h"
+#include "leveldb/comparator.h"
+#include "leveldb/options.h"
+#include "table/block.h"
+#include "table/block_builder.h"
+#include "table/format.h"
+
+namespace leveldb {
+
+namespace {
+
+std::string UserKey(int i) {
+  char buf[20];
+  std::snprintf(buf, sizeof(buf), "user%012d", i);
+  return std::string(buf);
+}
+
+// Point lookups of the keys of one data block of about block_size bytes,
+// with (hash_index != 0) or without the data block hash index.  This is
+// the part of Table::InternalGet() the hash index speeds up; the rest of
+// a DB::Get() of cached data costs several times as much.
+void BM_BlockPointLookup(benchmark::State& state) {
+  const bool hash_index = state.range(0) != 0;
+  const size_t block_size = state.range(1);
+
+  InternalKeyComparator icmp(BytewiseComparator());
+  Options options;
+  options.comparator = &icmp;
+  BlockBuilder builder(&options, hash_index);
+  int num_keys = 0;
+  while (builder.CurrentSizeEstimate() < block_size) {
+    InternalKey key(UserKey(num_keys), 100, kTypeValue);
+    builder.Add(key.Encode(), std::string(16, 'v'));
+    num_keys++;
+  }
+  const std::string data = builder.Finish().ToString();
+  BlockContents contents;
+  contents.data = data;
+  contents.cachable = false;
+  contents.heap_allocated = false;
+  Block block(contents, hash_index);
+
+  std::vector<std::string> targets;
+  for (int i = 0; i < num_keys; i++) {
+    InternalKey target(UserKey(i), kMaxSequenceNumber, kValueTypeForSeek);
+    targets.push_back(target.Encode().ToString());
+  }
+
+  uint64_t i = 0;
+  int found = 0;
+  for (auto st : state) {
+    // Visit the keys in a scattered order.
+    const uint64_t k = (i++ * 0x9e3779b97f4a7c15ull) % num_keys;
+    Iterator* iter = block.NewPointLookupIterator(&icmp, targets[k]);
+    found += iter->Valid();
+    delete iter;
+  }
+  benchmark::DoNotOptimize(found);
+  state.counters["keys"] = num_keys;
+}
+
+BENCHMARK(BM_BlockPointLookup)
+    ->ArgNames({"hash_index", "block_size"})
+    ->ArgsProduct({{0, 1}, {4 << 10, 16 << 10, 64 << 10}});
+
+}  // namespace
+
+}  // namespace leveldb
+
+BENCHMARK_MAIN();
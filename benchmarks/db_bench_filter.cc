@@ -0,0 +1,74 @@
+// Copyright (c) 2019 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/slice.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+namespace {
+
+enum PolicyType { kBloom, kCacheLocalBloom, kBinaryFuse };
+
+// Policies with a false positive rate of about 1%.
+const FilterPolicy* NewPolicy(int type) {
+  switch (type) {
+    case kBloom:
+      return NewBloomFilterPolicy(10);
+    case kCacheLocalBloom:
+      return NewCacheLocalBloomFilterPolicy(10);
+    default:
+      return NewBinaryFuseFilterPolicy(7);
+  }
+}
+
+// Probes a filter over num_keys keys with keys that are in it (present
+// != 0) or not.  Large filters do not fit in the CPU caches, which is
+// where confining probes to one cache line pays off.
+void BM_FilterKeyMayMatch(benchmark::State& state) {
+  const FilterPolicy* policy = NewPolicy(state.range(0));
+  const int num_keys = state.range(1);
+  const bool present = state.range(2) != 0;
+
+  std::vector<std::string> keys(num_keys);
+  std::vector<Slice> key_slices(num_keys);
+  for (int i = 0; i < num_keys; i++) {
+    PutFixed64(&keys[i], i);
+    key_slices[i] = keys[i];
+  }
+  std::string filter;
+  policy->CreateFilter(key_slices.data(), num_keys, &filter);
+
+  uint64_t i = 0;
+  int matches = 0;
+  char buf[sizeof(uint64_t)];
+  for (auto st : state) {
+    // Visit the keys in a scattered order.
+    const uint64_t k = (i++ * 0x9e3779b97f4a7c15ull) % num_keys;
+    EncodeFixed64(buf, present ? k : k + num_keys);
+    matches += policy->KeyMayMatch(Slice(buf, sizeof(buf)), filter);
+  }
+  benchmark::DoNotOptimize(matches);
+  state.counters["fp_rate"] =
+      present ? 0 : static_cast<double>(matches) / state.iterations();
+  state.counters["bits_per_key"] = filter.size() * 8.0 / num_keys;
+  delete policy;
+}
+
+BENCHMARK(BM_FilterKeyMayMatch)
+    ->ArgNames({"policy", "keys", "present"})
+    ->ArgsProduct({{kBloom, kCacheLocalBloom, kBinaryFuse},
+                   {10000, 10000000},
+                   {0, 1}});
+
+}  // namespace
+
+}  // namespace leveldb
+
+BENCHMARK_MAIN();
@@ -521,6 +521,11 @@ void leveldb_writeoptions_set_sync(leveldb_writeoptions_t* opt, uint8_t v) {
   opt->rep.sync = v;
 }
 
+void leveldb_writeoptions_set_disable_wal(leveldb_writeoptions_t* opt,
+                                          uint8_t v) {
+  opt->rep.disable_wal = v;
+}
+
 leveldb_cache_t* leveldb_cache_create_lru(size_t capacity) {
   leveldb_cache_t* c = new leveldb_cache_t;
   c->rep = NewLRUCache(capacity);
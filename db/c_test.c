@@ -290,6 +290,15 @@ int main(int argc, char** argv) {
     CheckCondition(sizes[1] > 0);
   }
 
+  StartPhase("disable_wal");
+  {
+    leveldb_writeoptions_set_disable_wal(woptions, 1);
+    leveldb_put(db, woptions, "nowal", 5, "v", 1, &err);
+    CheckNoError(err);
+    CheckGet(db, roptions, "nowal", "v");
+    leveldb_writeoptions_set_disable_wal(woptions, 0);
+  }
+
   StartPhase("property");
   {
     char* prop = leveldb_property_value(db, "nosuchprop");
@@ -42,12 +42,40 @@ const int kNumNonTableCacheFiles = 10;
 // Information kept for every waiting writer
 struct DBImpl::Writer {
   explicit Writer(port::Mutex* mu)
-      : batch(nullptr), sync(false), done(false), cv(mu) {}
+      : batch(nullptr),
+        sync(false),
+        disable_wal(false),
+        done(false),
+        insert_into(nullptr),
+        leader(nullptr),
+        pending_inserts(0),
+        cv(mu) {}
 
   Status status;
   WriteBatch* batch;
   bool sync;
+  bool disable_wal;
   bool done;
+
+  // Set by the leader of a logged batch group to have this writer apply
+  // its own batch to the memtable (concurrent memtable writes only).
+  MemTable* insert_into;
+  Writer* leader;
+  int pending_inserts;  // Leader only: followers still inserting
+
+  port::CondVar cv;
+};
+
+// A batch group whose log record has been written and which is waiting
+// for its turn to be applied to the memtable (pipelined writes only).
+struct DBImpl::WriteGroup {
+  explicit WriteGroup(port::Mutex* mu)
+      : updates(nullptr), last_sequence(0), cv(mu) {}
+
+  std::vector<Writer*> writers;  // writers[0] is the leader of the group
+  WriteBatch* updates;           // Either writers[0]->batch or &batch
+  WriteBatch batch;              // Merged contents of the group, if needed
+  SequenceNumber last_sequence;
   port::CondVar cv;
 };
 
@@ -94,12 +122,16 @@ static void ClipToRange(T* ptr, V minvalue, V maxvalue) {
 Options SanitizeOptions(const std::string& dbname,
                         const InternalKeyComparator* icmp,
                         const InternalFilterPolicy* ipolicy,
+                        const InternalKeySliceTransform* iprefix,
                         const Options& src) {
   Options result = src;
   result.comparator = icmp;
   result.filter_policy = (src.filter_policy != nullptr) ? ipolicy : nullptr;
+  result.prefix_extractor =
+      (src.prefix_extractor != nullptr) ? iprefix : nullptr;
   ClipToRange(&result.max_open_files, 64 + kNumNonTableCacheFiles, 50000);
   ClipToRange(&result.write_buffer_size, 64 << 10, 1 << 30);
+  ClipToRange(&result.max_write_buffer_number, 2, 64);
   ClipToRange(&result.max_file_size, 1 << 20, 1 << 30);
   ClipToRange(&result.block_size, 1 << 10, 4 << 20);
   if (result.info_log == nullptr) {
@@ -127,8 +159,10 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
     : env_(raw_options.env),
       internal_comparator_(raw_options.comparator),
       internal_filter_policy_(raw_options.filter_policy),
+      internal_prefix_extractor_(raw_options.prefix_extractor),
       options_(SanitizeOptions(dbname, &internal_comparator_,
-                               &internal_filter_policy_, raw_options)),
+                               &internal_filter_policy_,
+                               &internal_prefix_extractor_, raw_options)),
       owns_info_log_(options_.info_log != raw_options.info_log),
       owns_cache_(options_.block_cache != raw_options.block_cache),
       dbname_(dbname),
@@ -137,19 +171,36 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       shutting_down_(false),
       background_work_finished_signal_(&mutex_),
       mem_(nullptr),
-      imm_(nullptr),
       has_imm_(false),
       logfile_(nullptr),
       logfile_number_(0),
       log_(nullptr),
+      first_recyclable_log_number_(0),
       seed_(0),
+      group_commit_leader_(nullptr),
       tmp_batch_(new WriteBatch),
+      has_unpersisted_data_(false),
       background_compaction_scheduled_(false),
       manual_compaction_(nullptr),
       versions_(new VersionSet(dbname_, &options_, table_cache_,
                                &internal_comparator_)) {}
 
 DBImpl::~DBImpl() {
+  // Writes that skipped the log only live in the memtables.
+  mutex_.Lock();
+  bool flush = has_unpersisted_data_;
+  for (const ImmutableMemTable& imm : imm_) {
+    flush = flush || imm.has_unpersisted_data;
+  }
+  flush = flush && bg_error_.ok();
+  mutex_.Unlock();
+  if (flush) {
+    Status s = FlushMemTable();
+    if (!s.ok()) {
+      Log(options_.info_log, "Flush on close failed: %s", s.ToString().c_str());
+    }
+  }
+
   // Wait for background work to finish.
   mutex_.Lock();
   shutting_down_.store(true, std::memory_order_release);
@@ -164,7 +215,9 @@ DBImpl::~DBImpl() {
 
   delete versions_;
   if (mem_ != nullptr) mem_->Unref();
-  if (imm_ != nullptr) imm_->Unref();
+  for (const ImmutableMemTable& imm : imm_) {
+    imm.mem->Unref();
+  }
   delete tmp_batch_;
   delete log_;
   delete logfile_;
@@ -247,6 +300,21 @@ void DBImpl::RemoveObsoleteFiles() {
         case kLogFile:
           keep = ((number >= versions_->LogNumber()) ||
                   (number == versions_->PrevLogNumber()));
+          if (!keep && first_recyclable_log_number_ != 0 &&
+              number >= first_recyclable_log_number_) {
+            // Keep logs written in the recyclable format around to be
+            // reused for new logs.
+            if (std::find(log_recycle_files_.begin(), log_recycle_files_.end(),
+                          number) != log_recycle_files_.end()) {
+              keep = true;
+            } else if (log_recycle_files_.size() <
+                       options_.recycle_log_file_num) {
+              Log(options_.info_log, "Recycle log #%llu\n",
+                  static_cast<unsigned long long>(number));
+              log_recycle_files_.push_back(number);
+              keep = true;
+            }
+          }
           break;
         case kDescriptorFile:
           // Keep my manifest file, and any newer incarnations'
@@ -289,6 +357,43 @@ void DBImpl::RemoveObsoleteFiles() {
   mutex_.Lock();
 }
 
+Status DBImpl::NewLogFile(uint64_t log_number, WritableFile** file,
+                          log::Writer** writer) {
+  mutex_.AssertHeld();
+  const std::string fname = LogFileName(dbname_, log_number);
+  Status s;
+  if (!log_recycle_files_.empty()) {
+    const uint64_t old_log_number = log_recycle_files_.front();
+    log_recycle_files_.pop_front();
+    Log(options_.info_log, "Reusing log #%llu as #%llu\n",
+        static_cast<unsigned long long>(old_log_number),
+        static_cast<unsigned long long>(log_number));
+    s = env_->ReuseWritableFile(fname, LogFileName(dbname_, old_log_number),
+                                file);
+  } else {
+    s = env_->NewWritableFile(fname, file);
+  }
+  if (s.ok()) {
+    (*file)->SetPreallocationBlockSize(options_.log_preallocation_block_size);
+    const bool recycle = options_.recycle_log_file_num > 0;
+    if (recycle && first_recyclable_log_number_ == 0) {
+      first_recyclable_log_number_ = log_number;
+    }
+    *writer = new log::Writer(*file, log_number, recycle);
+    if (options_.wal_compression != kNoCompression) {
+      s = (*writer)->AddCompressionTypeRecord(options_.wal_compression,
+                                              options_.zstd_compression_level);
+      if (!s.ok()) {
+        delete *writer;
+        delete *file;
+        *writer = nullptr;
+        *file = nullptr;
+      }
+    }
+  }
+  return s;
+}
+
 Status DBImpl::Recover(VersionEdit* edit, bool* save_manifest) {
   mutex_.AssertHeld();
 
@@ -419,7 +524,8 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
   // paranoid_checks==false so that corruptions cause entire commits
   // to be skipped instead of propagating bad information (like overly
   // large sequence numbers).
-  log::Reader reader(file, &reporter, true /*checksum*/, 0 /*initial_offset*/);
+  log::Reader reader(file, &reporter, true /*checksum*/, 0 /*initial_offset*/,
+                     log_number);
   Log(options_.info_log, "Recovering log #%llu",
       (unsigned long long)log_number);
 
@@ -438,7 +544,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     WriteBatchInternal::SetContents(&batch, record); // 这里的 数据拷贝 能避免吗
 
     if (mem == nullptr) {
-      mem = new MemTable(internal_comparator_);
+      mem = new MemTable(internal_comparator_, options_);
       mem->Ref();
     }
     status = WriteBatchInternal::InsertInto(&batch, mem);
@@ -455,7 +561,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
       compactions++;
       *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, nullptr);
+      status = WriteLevel0Table(std::vector<MemTable*>(1, mem), edit, nullptr);
       mem->Unref();
       mem = nullptr;
       if (!status.ok()) {
@@ -468,8 +574,12 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
 
   delete file;
 
-  // See if we should keep reusing the last log file.
-  if (status.ok() && options_.reuse_logs && last_log && compactions == 0) {
+  // See if we should keep reusing the last log file.  A recycled log file
+  // that still holds stale records cannot be appended to, and neither can
+  // a compressed log since the appended records would not be compressed.
+  if (status.ok() && options_.reuse_logs && last_log && compactions == 0 &&
+      !reader.ReachedStaleData() &&
+      reader.compression_type() == kNoCompression) {
     assert(logfile_ == nullptr);
     assert(log_ == nullptr);
     assert(mem_ == nullptr);
@@ -477,14 +587,17 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     if (env_->GetFileSize(fname, &lfile_size).ok() &&
         env_->NewAppendableFile(fname, &logfile_).ok()) {
       Log(options_.info_log, "Reusing old log %s \n", fname.c_str());
-      log_ = new log::Writer(logfile_, lfile_size);
+      // Keep appending in the format of the existing records: the reader
+      // takes a legacy record after recyclable ones for the end of the log.
+      log_ = new log::Writer(logfile_, lfile_size, log_number,
+                             reader.ReadRecyclableRecords());
       logfile_number_ = log_number;
       if (mem != nullptr) {
         mem_ = mem;
         mem = nullptr;
       } else {
         // mem can be nullptr if lognum exists but was empty.
-        mem_ = new MemTable(internal_comparator_);
+        mem_ = new MemTable(internal_comparator_, options_);
         mem_->Ref();
       }
     }
@@ -494,7 +607,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     // mem did not get reused; compact it.
     if (status.ok()) {
       *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, nullptr);
+      status = WriteLevel0Table(std::vector<MemTable*>(1, mem), edit, nullptr);
     }
     mem->Unref();
   }
@@ -502,16 +615,28 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
   return status;
 }
 
-Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
-                                Version* base) {
+Status DBImpl::WriteLevel0Table(const std::vector<MemTable*>& mems,
+                                VersionEdit* edit, Version* base) {
   mutex_.AssertHeld();
+  assert(!mems.empty());
   const uint64_t start_micros = env_->NowMicros();
   FileMetaData meta;
   meta.number = versions_->NewFileNumber();
   pending_outputs_.insert(meta.number);
-  Iterator* iter = mem->NewIterator();
-  Log(options_.info_log, "Level-0 table #%llu: started",
-      (unsigned long long)meta.number);
+  // Several memtables are merged into a single table.  Their entries
+  // never collide since every entry has a distinct sequence number.
+  Iterator* iter;
+  if (mems.size() == 1) {
+    iter = mems[0]->NewIterator();
+  } else {
+    std::vector<Iterator*> list;
+    for (MemTable* mem : mems) {
+      list.push_back(mem->NewIterator());
+    }
+    iter = NewMergingIterator(&internal_comparator_, &list[0], list.size());
+  }
+  Log(options_.info_log, "Level-0 table #%llu: started (%d memtables)",
+      (unsigned long long)meta.number, static_cast<int>(mems.size()));
 
   Status s;
   {
@@ -548,13 +673,20 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
 
 void DBImpl::CompactMemTable() {
   mutex_.AssertHeld();
-  assert(imm_ != nullptr);
+  assert(!imm_.empty());
 
-  // Save the contents of the memtable as a new Table
+  // Save the contents of all immutable memtables that are currently
+  // queued as a single new Table.  More memtables may be queued while
+  // the table is being built; they are left for the next compaction.
+  std::vector<MemTable*> mems;
+  for (const ImmutableMemTable& imm : imm_) {
+    mems.push_back(imm.mem);
+  }
+  const size_t num_compacted = mems.size();
   VersionEdit edit;
   Version* base = versions_->current();
   base->Ref();
-  Status s = WriteLevel0Table(imm_, &edit, base);
+  Status s = WriteLevel0Table(mems, &edit, base);
   base->Unref();
 
   if (s.ok() && shutting_down_.load(std::memory_order_acquire)) {
@@ -563,16 +695,22 @@ void DBImpl::CompactMemTable() {
 
   // Replace immutable memtable with the generated Table
   if (s.ok()) {
+    // Logs older than the one holding the oldest remaining memtable are
+    // no longer needed.
     edit.SetPrevLogNumber(0);
-    edit.SetLogNumber(logfile_number_);  // Earlier logs no longer needed
+    edit.SetLogNumber(num_compacted < imm_.size()
+                          ? imm_[num_compacted].log_number
+                          : logfile_number_);
     s = versions_->LogAndApply(&edit, &mutex_);
   }
 
   if (s.ok()) {
     // Commit to the new state
-    imm_->Unref();
-    imm_ = nullptr;
-    has_imm_.store(false, std::memory_order_release);
+    for (size_t i = 0; i < num_compacted; i++) {
+      imm_[i].mem->Unref();
+    }
+    imm_.erase(imm_.begin(), imm_.begin() + num_compacted);
+    has_imm_.store(!imm_.empty(), std::memory_order_release);
     RemoveObsoleteFiles();
   } else {
     RecordBackgroundError(s);
@@ -635,22 +773,36 @@ void DBImpl::TEST_CompactRange(int level, const Slice* begin,
   }
 }
 
-Status DBImpl::TEST_CompactMemTable() {
+Status DBImpl::FlushMemTable() {
   // nullptr batch means just wait for earlier writes to be done
   Status s = Write(WriteOptions(), nullptr);
   if (s.ok()) {
     // Wait until the compaction completes
     MutexLock l(&mutex_);
-    while (imm_ != nullptr && bg_error_.ok()) {
+    while (!imm_.empty() && bg_error_.ok()) {
       background_work_finished_signal_.Wait();
     }
-    if (imm_ != nullptr) {
+    if (!imm_.empty()) {
       s = bg_error_;
     }
   }
   return s;
 }
 
+Status DBImpl::TEST_CompactMemTable() {
+  Status s = FlushMemTable();
+  if (s.ok()) {
+    // The memtable compaction may have scheduled a compaction of level-0.
+    // Let it run now rather than at some later point of the test.
+    MutexLock l(&mutex_);
+    while (background_compaction_scheduled_ && bg_error_.ok()) {
+      background_work_finished_signal_.Wait();
+    }
+    s = bg_error_;
+  }
+  return s;
+}
+
 void DBImpl::RecordBackgroundError(const Status& s) {
   mutex_.AssertHeld();
   if (bg_error_.ok()) {
@@ -667,7 +819,7 @@ void DBImpl::MaybeScheduleCompaction() {
     // DB is being deleted; no more background compactions
   } else if (!bg_error_.ok()) {
     // Already got an error; no more changes
-  } else if (imm_ == nullptr && manual_compaction_ == nullptr &&
+  } else if (imm_.empty() && manual_compaction_ == nullptr &&
              !versions_->NeedsCompaction()) {
     // No work to be done
   } else {
@@ -702,7 +854,7 @@ void DBImpl::BackgroundCall() {
 void DBImpl::BackgroundCompaction() {
   mutex_.AssertHeld();
 
-  if (imm_ != nullptr) {
+  if (!imm_.empty()) {
     CompactMemTable();
     return;
   }
@@ -817,6 +969,8 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
   std::string fname = TableFileName(dbname_, file_number);
   Status s = env_->NewWritableFile(fname, &compact->outfile);
   if (s.ok()) {
+    compact->outfile->SetPreallocationBlockSize(
+        options_.table_preallocation_block_size);
     compact->builder = new TableBuilder(options_, compact->outfile);
   }
   return s;
@@ -923,7 +1077,7 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     if (has_imm_.load(std::memory_order_relaxed)) {
       const uint64_t imm_start = env_->NowMicros();
       mutex_.Lock();
-      if (imm_ != nullptr) {
+      if (!imm_.empty()) {
         CompactMemTable();
         // Wake up MakeRoomForWrite() if necessary.
         background_work_finished_signal_.SignalAll();
@@ -1056,17 +1210,19 @@ struct IterState {
   port::Mutex* const mu;
   Version* const version GUARDED_BY(mu);
   MemTable* const mem GUARDED_BY(mu);
-  MemTable* const imm GUARDED_BY(mu);
+  std::vector<MemTable*> imm GUARDED_BY(mu);
 
-  IterState(port::Mutex* mutex, MemTable* mem, MemTable* imm, Version* version)
-      : mu(mutex), version(version), mem(mem), imm(imm) {}
+  IterState(port::Mutex* mutex, MemTable* mem, Version* version)
+      : mu(mutex), version(version), mem(mem) {}
 };
 
 static void CleanupIteratorState(void* arg1, void* arg2) {
   IterState* state = reinterpret_cast<IterState*>(arg1);
   state->mu->Lock();
   state->mem->Unref();
-  if (state->imm != nullptr) state->imm->Unref();
+  for (MemTable* imm : state->imm) {
+    imm->Unref();
+  }
   state->version->Unref();
   state->mu->Unlock();
   delete state;
@@ -1082,18 +1238,19 @@ Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
 
   // Collect together all needed child iterators
   std::vector<Iterator*> list;
+  IterState* cleanup = new IterState(&mutex_, mem_, versions_->current());
   list.push_back(mem_->NewIterator());
   mem_->Ref();
-  if (imm_ != nullptr) {
-    list.push_back(imm_->NewIterator());
-    imm_->Ref();
+  for (const ImmutableMemTable& imm : imm_) {
+    list.push_back(imm.mem->NewIterator());
+    imm.mem->Ref();
+    cleanup->imm.push_back(imm.mem);
   }
   versions_->current()->AddIterators(options, &list);
   Iterator* internal_iter =
       NewMergingIterator(&internal_comparator_, &list[0], list.size());
   versions_->current()->Ref();
 
-  IterState* cleanup = new IterState(&mutex_, mem_, imm_, versions_->current());
   internal_iter->RegisterCleanup(CleanupIteratorState, cleanup, nullptr);
 
   *seed = ++seed_;
@@ -1125,10 +1282,13 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
   }
 
   MemTable* mem = mem_;
-  MemTable* imm = imm_;
+  std::vector<MemTable*> imms;  // Newest first
+  for (auto it = imm_.rbegin(); it != imm_.rend(); ++it) {
+    imms.push_back(it->mem);
+    it->mem->Ref();
+  }
   Version* current = versions_->current();
   mem->Ref();
-  if (imm != nullptr) imm->Ref();
   current->Ref();
 
   bool have_stat_update = false;
@@ -1137,13 +1297,14 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
   // Unlock while reading from files and memtables
   {
     mutex_.Unlock();
-    // First look in the memtable, then in the immutable memtable (if any).
+    // First look in the memtable, then in the immutable memtables (if
+    // any) from newest to oldest.
     LookupKey lkey(key, snapshot);
-    if (mem->Get(lkey, value, &s)) {
-      // Done
-    } else if (imm != nullptr && imm->Get(lkey, value, &s)) {
-      // Done
-    } else {
+    bool done = mem->Get(lkey, value, &s);
+    for (size_t i = 0; !done && i < imms.size(); i++) {
+      done = imms[i]->Get(lkey, value, &s);
+    }
+    if (!done) {
       s = current->Get(options, lkey, value, &stats);
       have_stat_update = true;
     }
@@ -1154,11 +1315,102 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
     MaybeScheduleCompaction();
   }
   mem->Unref();
-  if (imm != nullptr) imm->Unref();
+  for (MemTable* imm : imms) {
+    imm->Unref();
+  }
   current->Unref();
   return s;
 }
 
+void DBImpl::MultiGet(const ReadOptions& options, int n, const Slice* keys,
+                      std::string* values, Status* statuses) {
+  if (n <= 0) {
+    return;
+  }
+  MutexLock l(&mutex_);
+  SequenceNumber snapshot;
+  if (options.snapshot != nullptr) {
+    snapshot =
+        static_cast<const SnapshotImpl*>(options.snapshot)->sequence_number();
+  } else {
+    snapshot = versions_->LastSequence();
+  }
+
+  MemTable* mem = mem_;
+  std::vector<MemTable*> imms;  // Newest first
+  for (auto it = imm_.rbegin(); it != imm_.rend(); ++it) {
+    imms.push_back(it->mem);
+    it->mem->Ref();
+  }
+  Version* current = versions_->current();
+  mem->Ref();
+  current->Ref();
+
+  std::vector<Version::GetStats> stats;
+
+  // Unlock while reading from files and memtables
+  {
+    mutex_.Unlock();
+    // Visit the keys in sorted order, so that files are searched for
+    // consecutive keys and tables can walk their index blocks once.
+    const Comparator* ucmp = user_comparator();
+    std::vector<int> order(n);
+    for (int i = 0; i < n; i++) {
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+      return ucmp->Compare(keys[a], keys[b]) < 0;
+    });
+
+    std::vector<LookupKey*> lkeys;
+    std::vector<std::string*> pending_values;
+    std::vector<Status*> pending_statuses;
+    for (int i : order) {
+      LookupKey* lkey = new LookupKey(keys[i], snapshot);
+      // First look in the memtable, then in the immutable memtables (if
+      // any) from newest to oldest.
+      Status s;
+      bool done = mem->Get(*lkey, &values[i], &s);
+      for (size_t j = 0; !done && j < imms.size(); j++) {
+        done = imms[j]->Get(*lkey, &values[i], &s);
+      }
+      if (done) {
+        statuses[i] = s;
+        delete lkey;
+      } else {
+        lkeys.push_back(lkey);
+        pending_values.push_back(&values[i]);
+        pending_statuses.push_back(&statuses[i]);
+      }
+    }
+    if (!lkeys.empty()) {
+      stats.resize(lkeys.size());
+      current->MultiGet(options, static_cast<int>(lkeys.size()), lkeys.data(),
+                        pending_values.data(), pending_statuses.data(),
+                        stats.data());
+    }
+    for (LookupKey* lkey : lkeys) {
+      delete lkey;
+    }
+    mutex_.Lock();
+  }
+
+  bool compaction_needed = false;
+  for (const Version::GetStats& s : stats) {
+    if (current->UpdateStats(s)) {
+      compaction_needed = true;
+    }
+  }
+  if (compaction_needed) {
+    MaybeScheduleCompaction();
+  }
+  mem->Unref();
+  for (MemTable* imm : imms) {
+    imm->Unref();
+  }
+  current->Unref();
+}
+
 Iterator* DBImpl::NewIterator(const ReadOptions& options) {
   SequenceNumber latest_snapshot;
   uint32_t seed;
@@ -1168,7 +1420,10 @@ Iterator* DBImpl::NewIterator(const ReadOptions& options) {
                             ? static_cast<const SnapshotImpl*>(options.snapshot)
                                   ->sequence_number()
                             : latest_snapshot),
-                       seed);
+                       seed,
+                       options.prefix_same_as_start
+                           ? internal_prefix_extractor_.user_transform()
+                           : nullptr);
 }
 
 void DBImpl::RecordReadSample(Slice key) {
@@ -1198,16 +1453,26 @@ Status DBImpl::Delete(const WriteOptions& options, const Slice& key) {
 }
 
 Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
+  if (options.sync && options.disable_wal) {
+    return Status::InvalidArgument("sync writes cannot disable the log");
+  }
+  if (options_.enable_pipelined_write) {
+    return PipelinedWrite(options, updates);
+  }
+
   Writer w(&mutex_);
   w.batch = updates;
   w.sync = options.sync;
+  w.disable_wal = options.disable_wal;
   w.done = false;
 
   MutexLock l(&mutex_);
   writers_.push_back(&w);
-  while (!w.done && &w != writers_.front()) {
-    w.cv.Wait();
+  if (group_commit_leader_ != nullptr) {
+    // Let the leader check whether its group is big enough now.
+    group_commit_leader_->cv.Signal();
   }
+  WaitForWriteTurn(&w);
   if (w.done) {
     return w.status;
   }
@@ -1217,17 +1482,27 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
   uint64_t last_sequence = versions_->LastSequence();
   Writer* last_writer = &w;
   if (status.ok() && updates != nullptr) {  // nullptr batch is for compactions
-    WriteBatch* write_batch = BuildBatchGroup(&last_writer);
+    GatherSyncWriters();
+    WriteBatch* write_batch = BuildBatchGroup(&last_writer, tmp_batch_);
+    DelayWrite(WriteBatchInternal::ByteSize(write_batch));
     WriteBatchInternal::SetSequence(write_batch, last_sequence + 1);
     last_sequence += WriteBatchInternal::Count(write_batch);
+    const bool parallel =
+        options_.allow_concurrent_memtable_write && last_writer != &w;
 
     // Add to log and apply to memtable.  We can release the lock
     // during this phase since &w is currently responsible for logging
     // and protects against concurrent loggers and concurrent writes
-    // into mem_.
+    // into mem_.  Groups of writes that disable the log only go to the
+    // memtable.
+    if (w.disable_wal) {
+      has_unpersisted_data_ = true;
+    }
     {
       mutex_.Unlock();
-      status = log_->AddRecord(WriteBatchInternal::Contents(write_batch));
+      if (!w.disable_wal) {
+        status = log_->AddRecord(WriteBatchInternal::Contents(write_batch));
+      }
       bool sync_error = false;
       if (status.ok() && options.sync) {
         status = logfile_->Sync();
@@ -1235,7 +1510,7 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
           sync_error = true;
         }
       }
-      if (status.ok()) {
+      if (status.ok() && !parallel) {
         status = WriteBatchInternal::InsertInto(write_batch, mem_);
       }
       mutex_.Lock();
@@ -1246,6 +1521,15 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
         RecordBackgroundError(status);
       }
     }
+    if (status.ok() && parallel) {
+      std::vector<Writer*> group;
+      for (Writer* writer : writers_) {
+        group.push_back(writer);
+        if (writer == last_writer) break;
+      }
+      status = ParallelInsertBatchGroup(
+          group, WriteBatchInternal::Sequence(write_batch), mem_);
+    }
     if (write_batch == tmp_batch_) tmp_batch_->Clear();
 
     versions_->SetLastSequence(last_sequence);
@@ -1270,9 +1554,200 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
   return status;
 }
 
+Status DBImpl::PipelinedWrite(const WriteOptions& options,
+                              WriteBatch* updates) {
+  Writer w(&mutex_);
+  w.batch = updates;
+  w.sync = options.sync;
+  w.disable_wal = options.disable_wal;
+  w.done = false;
+
+  MutexLock l(&mutex_);
+  writers_.push_back(&w);
+  if (group_commit_leader_ != nullptr) {
+    // Let the leader check whether its group is big enough now.
+    group_commit_leader_->cv.Signal();
+  }
+  WaitForWriteTurn(&w);
+  if (w.done) {
+    return w.status;
+  }
+
+  // Stage 1: write the log record for the group led by w.  May
+  // temporarily unlock and wait.
+  WriteGroup group(&mutex_);
+  Status status = MakeRoomForWrite(updates == nullptr);
+  Writer* last_writer = &w;
+  bool queued = false;
+  if (status.ok() && updates != nullptr) {  // nullptr batch is for compactions
+    GatherSyncWriters();
+    group.updates = BuildBatchGroup(&last_writer, &group.batch);
+    DelayWrite(WriteBatchInternal::ByteSize(group.updates));
+
+    // Groups that are still waiting for their memtable insert have not
+    // published their sequence numbers yet, so continue after the last one.
+    uint64_t last_sequence = memtable_writers_.empty()
+                                 ? versions_->LastSequence()
+                                 : memtable_writers_.back()->last_sequence;
+    WriteBatchInternal::SetSequence(group.updates, last_sequence + 1);
+    last_sequence += WriteBatchInternal::Count(group.updates);
+
+    // Add to log, unless the group disables it.  &w is at the front of
+    // writers_, which protects against concurrent loggers.
+    if (w.disable_wal) {
+      has_unpersisted_data_ = true;
+    }
+    {
+      mutex_.Unlock();
+      if (!w.disable_wal) {
+        status = log_->AddRecord(WriteBatchInternal::Contents(group.updates));
+      }
+      bool sync_error = false;
+      if (status.ok() && options.sync) {
+        status = logfile_->Sync();
+        if (!status.ok()) {
+          sync_error = true;
+        }
+      }
+      mutex_.Lock();
+      if (sync_error) {
+        // See the comment in Write().
+        RecordBackgroundError(status);
+      }
+    }
+
+    group.last_sequence = last_sequence;
+    memtable_writers_.push_back(&group);
+    queued = true;
+  }
+
+  // Hand the log over to the next group.  Writers of a queued group keep
+  // waiting until the memtable insert below has finished.
+  while (true) {
+    Writer* ready = writers_.front();
+    writers_.pop_front();
+    if (queued) {
+      group.writers.push_back(ready);
+    } else if (ready != &w) {
+      ready->status = status;
+      ready->done = true;
+      ready->cv.Signal();
+    }
+    if (ready == last_writer) break;
+  }
+  if (!writers_.empty()) {
+    writers_.front()->cv.Signal();
+  }
+  if (!queued) {
+    return status;
+  }
+
+  // Stage 2: apply the group to the memtable.  Groups are applied one at
+  // a time in log order so that the last sequence is published in order.
+  // mem_ cannot be switched while memtable_writers_ is non-empty (see
+  // MakeRoomForWrite()).
+  while (&group != memtable_writers_.front()) {
+    group.cv.Wait();
+  }
+  if (status.ok()) {
+    MemTable* mem = mem_;
+    if (options_.allow_concurrent_memtable_write &&
+        group.writers.size() > 1) {
+      status = ParallelInsertBatchGroup(
+          group.writers, WriteBatchInternal::Sequence(group.updates), mem);
+    } else {
+      mutex_.Unlock();
+      status = WriteBatchInternal::InsertInto(group.updates, mem);
+      mutex_.Lock();
+    }
+  }
+  versions_->SetLastSequence(group.last_sequence);
+  memtable_writers_.pop_front();
+
+  for (Writer* ready : group.writers) {
+    if (ready != &w) {
+      ready->status = status;
+      ready->done = true;
+      ready->cv.Signal();
+    }
+  }
+
+  if (!memtable_writers_.empty()) {
+    memtable_writers_.front()->cv.Signal();
+  } else {
+    // A writer may be waiting in MakeRoomForWrite() for the queue to drain.
+    background_work_finished_signal_.SignalAll();
+  }
+
+  return status;
+}
+
+void DBImpl::WaitForWriteTurn(Writer* w) {
+  mutex_.AssertHeld();
+  while (true) {
+    // Followers of a group logged by a pipelined write are no longer in
+    // writers_, which may therefore be empty while they wait.
+    if (w->done || (!writers_.empty() && w == writers_.front())) {
+      return;
+    }
+    if (w->insert_into != nullptr) {
+      // Our group leader has logged the group and asks us to apply our
+      // own batch to the memtable.
+      MemTable* mem = w->insert_into;
+      w->insert_into = nullptr;
+      mutex_.Unlock();
+      Status s = WriteBatchInternal::InsertIntoConcurrently(w->batch, mem);
+      mutex_.Lock();
+      w->status = s;
+      if (--w->leader->pending_inserts == 0) {
+        w->leader->cv.Signal();
+      }
+      continue;
+    }
+    w->cv.Wait();
+  }
+}
+
+Status DBImpl::ParallelInsertBatchGroup(const std::vector<Writer*>& group,
+                                        SequenceNumber sequence,
+                                        MemTable* mem) {
+  mutex_.AssertHeld();
+  Writer* leader = group[0];
+  assert(leader->pending_inserts == 0);
+
+  // Give every batch the sequence numbers it was assigned inside the
+  // merged group batch, and wake up the followers to insert their own.
+  for (Writer* w : group) {
+    if (w->batch == nullptr) continue;
+    WriteBatchInternal::SetSequence(w->batch, sequence);
+    sequence += WriteBatchInternal::Count(w->batch);
+    if (w != leader) {
+      w->insert_into = mem;
+      w->leader = leader;
+      leader->pending_inserts++;
+      w->cv.Signal();
+    }
+  }
+
+  mutex_.Unlock();
+  Status status =
+      WriteBatchInternal::InsertIntoConcurrently(leader->batch, mem);
+  mutex_.Lock();
+  while (leader->pending_inserts > 0) {
+    leader->cv.Wait();
+  }
+  for (Writer* w : group) {
+    if (status.ok() && w != leader && w->batch != nullptr) {
+      status = w->status;
+    }
+  }
+  return status;
+}
+
 // REQUIRES: Writer list must be non-empty
 // REQUIRES: First writer must have a non-null batch
-WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
+WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer,
+                                    WriteBatch* tmp_batch) {
   mutex_.AssertHeld();
   assert(!writers_.empty());
   Writer* first = writers_.front();
@@ -1290,6 +1765,7 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
   }
 
   *last_writer = first;
+  int num_writers = 1;
   std::deque<Writer*>::iterator iter = writers_.begin();
   ++iter;  // Advance past "first"
   for (; iter != writers_.end(); ++iter) {
@@ -1299,6 +1775,11 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
       break;
     }
 
+    if (w->disable_wal != first->disable_wal) {
+      // Do not mix writes that skip the log with writes that do not.
+      break;
+    }
+
     if (w->batch != nullptr) {
       size += WriteBatchInternal::ByteSize(w->batch);
       if (size > max_size) {
@@ -1309,48 +1790,155 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
       // Append to *result
       if (result == first->batch) {
         // Switch to temporary batch instead of disturbing caller's batch
-        result = tmp_batch_;
+        result = tmp_batch;
         assert(WriteBatchInternal::Count(result) == 0);
         WriteBatchInternal::Append(result, first->batch);
       }
       WriteBatchInternal::Append(result, w->batch);
     }
     *last_writer = w;
+    num_writers++;
+  }
+
+  write_stats_.groups++;
+  write_stats_.writers += num_writers;
+  write_stats_.bytes += WriteBatchInternal::ByteSize(result);
+  if (first->sync) {
+    write_stats_.sync_groups++;
   }
   return result;
 }
 
+// REQUIRES: mutex_ is held
+// REQUIRES: this thread is currently at the front of the writer queue
+void DBImpl::GatherSyncWriters() {
+  mutex_.AssertHeld();
+  assert(!writers_.empty());
+  Writer* first = writers_.front();
+  if (!first->sync || options_.sync_group_commit_micros == 0) {
+    return;
+  }
+
+  // BuildBatchGroup() will not let the group grow past this size.
+  const size_t first_size = WriteBatchInternal::ByteSize(first->batch);
+  size_t max_size = 1 << 20;
+  if (first_size <= (128 << 10)) {
+    max_size = first_size + (128 << 10);
+  }
+  if (options_.sync_group_commit_bytes > 0) {
+    max_size = std::min(max_size, options_.sync_group_commit_bytes);
+  }
+
+  const uint64_t start_micros = env_->NowMicros();
+  const uint64_t deadline = start_micros + options_.sync_group_commit_micros;
+  group_commit_leader_ = first;
+  while (bg_error_.ok()) {
+    size_t size = 0;
+    for (Writer* w : writers_) {
+      if (w->batch != nullptr) {
+        size += WriteBatchInternal::ByteSize(w->batch);
+      }
+    }
+    const uint64_t now = env_->NowMicros();
+    if (size >= max_size || now >= deadline) {
+      break;
+    }
+    first->cv.WaitFor(deadline - now);
+  }
+  group_commit_leader_ = nullptr;
+  write_stats_.wait_micros += env_->NowMicros() - start_micros;
+}
+
+// REQUIRES: mutex_ is held
+// REQUIRES: this thread is currently at the front of the writer queue
+void DBImpl::DelayWrite(uint64_t num_bytes) {
+  mutex_.AssertHeld();
+  assert(!writers_.empty());
+
+  // Delays are slept off in steps of at most this many micros.
+  static const uint64_t kMaxDelayStepMicros = 100000;
+
+  write_controller_.set_delayed_write_rate(DelayedWriteRate());
+  uint64_t delay_micros =
+      write_controller_.GetDelay(env_->NowMicros(), num_bytes);
+  // Large batches at low rates can owe more time than a single sleep
+  // call takes, and compactions may catch up in the meantime, in which
+  // case the rest of the delay is dropped.
+  while (delay_micros > 0 && bg_error_.ok() &&
+         !shutting_down_.load(std::memory_order_acquire)) {
+    const uint64_t step = std::min(delay_micros, kMaxDelayStepMicros);
+    delay_micros -= step;
+    // Sleeping also hands over some CPU to the compaction thread in
+    // case it is sharing the same core as the writer.
+    mutex_.Unlock();
+    env_->SleepForMicroseconds(static_cast<int>(step));
+    mutex_.Lock();
+    if (delay_micros > 0 && DelayedWriteRate() == 0) {
+      write_controller_.set_delayed_write_rate(0);
+      break;
+    }
+  }
+}
+
+uint64_t DBImpl::DelayedWriteRate() {
+  mutex_.AssertHeld();
+
+  // Writes must never become slower than this, however far behind
+  // compactions are; the hard stop in MakeRoomForWrite() takes over.
+  static const uint64_t kMinDelayedWriteRate = 16 * 1024;
+
+  // Scale the delayed write rate by how close we are to a hard limit.
+  // With the default triggers, each level-0 file past the slowdown
+  // trigger removes another fifth of the rate.
+  double factor = 1.0;
+  bool delay = false;
+  const int l0_files = versions_->NumLevelFiles(0);
+  if (l0_files >= config::kL0_SlowdownWritesTrigger) {
+    delay = true;
+    const int files_left =
+        std::max(config::kL0_StopWritesTrigger - l0_files, 0);
+    factor = std::min(factor, static_cast<double>(files_left) /
+                                  (config::kL0_StopWritesTrigger -
+                                   config::kL0_SlowdownWritesTrigger + 1));
+  }
+  const uint64_t pending_bytes = versions_->EstimatedCompactionNeededBytes();
+  const uint64_t soft_limit = options_.soft_pending_compaction_bytes_limit;
+  if (soft_limit > 0 && pending_bytes >= soft_limit) {
+    delay = true;
+    factor = std::min(factor, static_cast<double>(soft_limit) / pending_bytes);
+  }
+
+  if (!delay || options_.delayed_write_rate == 0) {
+    return 0;
+  }
+  return std::max(
+      static_cast<uint64_t>(options_.delayed_write_rate * factor),
+      std::min(kMinDelayedWriteRate, options_.delayed_write_rate));
+}
+
 // REQUIRES: mutex_ is held
 // REQUIRES: this thread is currently at the front of the writer queue
 Status DBImpl::MakeRoomForWrite(bool force) {
   mutex_.AssertHeld();
   assert(!writers_.empty());
-  bool allow_delay = !force;
   Status s;
   while (true) {
     if (!bg_error_.ok()) {
       // Yield previous error
       s = bg_error_;
       break;
-    } else if (allow_delay && versions_->NumLevelFiles(0) >=
-                                  config::kL0_SlowdownWritesTrigger) {
-      // We are getting close to hitting a hard limit on the number of
-      // L0 files.  Rather than delaying a single write by several
-      // seconds when we hit the hard limit, start delaying each
-      // individual write by 1ms to reduce latency variance.  Also,
-      // this delay hands over some CPU to the compaction thread in
-      // case it is sharing the same core as the writer.
-      mutex_.Unlock();
-      env_->SleepForMicroseconds(1000);
-      allow_delay = false;  // Do not delay a single write more than once
-      mutex_.Lock();
     } else if (!force &&
                (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
       // There is room in current memtable
       break;
-    } else if (imm_ != nullptr) {
-      // We have filled up the current memtable, but the previous
-      // one is still being compacted, so we wait.
+    } else if (!memtable_writers_.empty()) {
+      // Pipelined writes that have already been logged are still being
+      // applied to the current memtable; wait for them before switching.
+      background_work_finished_signal_.Wait();
+    } else if (imm_.size() + 1 >=
+               static_cast<size_t>(options_.max_write_buffer_number)) {
+      // We have filled up the current memtable, but the maximum number
+      // of earlier ones are still waiting to be compacted, so we wait.
       Log(options_.info_log, "Current memtable full; waiting...\n");
       background_work_finished_signal_.Wait();
     } else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) {
@@ -1362,7 +1950,8 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       assert(versions_->PrevLogNumber() == 0);
       uint64_t new_log_number = versions_->NewFileNumber();
       WritableFile* lfile = nullptr;
-      s = env_->NewWritableFile(LogFileName(dbname_, new_log_number), &lfile);
+      log::Writer* new_log = nullptr;
+      s = NewLogFile(new_log_number, &lfile, &new_log);
       if (!s.ok()) {
         // Avoid chewing through file number space in a tight loop.
         versions_->ReuseFileNumber(new_log_number);
@@ -1384,12 +1973,14 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       }
       delete logfile_;
 
+      imm_.push_back(
+          ImmutableMemTable{mem_, logfile_number_, has_unpersisted_data_});
+      has_unpersisted_data_ = false;
+      has_imm_.store(true, std::memory_order_release);
       logfile_ = lfile;
       logfile_number_ = new_log_number;
-      log_ = new log::Writer(lfile);
-      imm_ = mem_;
-      has_imm_.store(true, std::memory_order_release);
-      mem_ = new MemTable(internal_comparator_);
+      log_ = new_log;
+      mem_ = new MemTable(internal_comparator_, options_);
       mem_->Ref();
       force = false;  // Do not force another compaction if have room
       MaybeScheduleCompaction();
@@ -1439,16 +2030,35 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
       }
     }
     return true;
+  } else if (in == "write-group-stats") {
+    char buf[200];
+    const double groups = std::max<int64_t>(write_stats_.groups, 1);
+    std::snprintf(buf, sizeof(buf),
+                  "Groups: %lld, sync groups: %lld\n"
+                  "Writers per group: %.2f\n"
+                  "Bytes per group: %.0f\n"
+                  "Group commit wait(sec): %.3f\n",
+                  static_cast<long long>(write_stats_.groups),
+                  static_cast<long long>(write_stats_.sync_groups),
+                  write_stats_.writers / groups, write_stats_.bytes / groups,
+                  write_stats_.wait_micros / 1e6);
+    value->append(buf);
+    return true;
   } else if (in == "sstables") {
     *value = versions_->current()->DebugString();
     return true;
+  } else if (in == "num-immutable-mem-table") {
+    char buf[50];
+    std::snprintf(buf, sizeof(buf), "%d", static_cast<int>(imm_.size()));
+    value->append(buf);
+    return true;
   } else if (in == "approximate-memory-usage") {
     size_t total_usage = options_.block_cache->TotalCharge();
     if (mem_) {
       total_usage += mem_->ApproximateMemoryUsage();
     }
-    if (imm_) {
-      total_usage += imm_->ApproximateMemoryUsage();
+    for (const ImmutableMemTable& imm : imm_) {
+      total_usage += imm.mem->ApproximateMemoryUsage();
     }
     char buf[50];
     std::snprintf(buf, sizeof(buf), "%llu",
@@ -1492,6 +2102,26 @@ Status DB::Delete(const WriteOptions& opt, const Slice& key) {
   return Write(opt, &batch);
 }
 
+void DB::MultiGet(const ReadOptions& options, int n, const Slice* keys,
+                  std::string* values, Status* statuses) {
+  ReadOptions snapshot_options = options;
+  const Snapshot* snapshot = nullptr;
+  if (options.snapshot == nullptr) {
+    snapshot = GetSnapshot();
+    snapshot_options.snapshot = snapshot;
+  }
+  for (int i = 0; i < n; i++) {
+    statuses[i] = Get(snapshot_options, keys[i], &values[i]);
+  }
+  if (snapshot != nullptr) {
+    ReleaseSnapshot(snapshot);
+  }
+}
+
+Status DB::FlushMemTable() {
+  return Status::NotSupported("FlushMemTable");
+}
+
 DB::~DB() = default;
 
 Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
@@ -1507,14 +2137,14 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
     // Create new log and a corresponding memtable.
     uint64_t new_log_number = impl->versions_->NewFileNumber();
     WritableFile* lfile;
-    s = options.env->NewWritableFile(LogFileName(dbname, new_log_number),
-                                     &lfile);
+    log::Writer* log;
+    s = impl->NewLogFile(new_log_number, &lfile, &log);
     if (s.ok()) {
       edit.SetLogNumber(new_log_number);
       impl->logfile_ = lfile;
       impl->logfile_number_ = new_log_number;
-      impl->log_ = new log::Writer(lfile);
-      impl->mem_ = new MemTable(impl->internal_comparator_);
+      impl->log_ = log;
+      impl->mem_ = new MemTable(impl->internal_comparator_, impl->options_);
       impl->mem_->Ref();
     }
   }
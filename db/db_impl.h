@@ -9,10 +9,12 @@
 #include <deque>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "db/dbformat.h"
 #include "db/log_writer.h"
 #include "db/snapshot.h"
+#include "db/write_controller.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "port/port.h"
@@ -42,19 +44,23 @@ class DBImpl : public DB {
   Status Write(const WriteOptions& options, WriteBatch* updates) override;
   Status Get(const ReadOptions& options, const Slice& key,
              std::string* value) override;
+  void MultiGet(const ReadOptions& options, int n, const Slice* keys,
+                std::string* values, Status* statuses) override;
   Iterator* NewIterator(const ReadOptions&) override;
   const Snapshot* GetSnapshot() override;
   void ReleaseSnapshot(const Snapshot* snapshot) override;
   bool GetProperty(const Slice& property, std::string* value) override;
   void GetApproximateSizes(const Range* range, int n, uint64_t* sizes) override;
   void CompactRange(const Slice* begin, const Slice* end) override;
+  Status FlushMemTable() override;
 
   // Extra methods (for testing) that are not in the public DB interface
 
   // Compact any files in the named level that overlap [*begin,*end]
   void TEST_CompactRange(int level, const Slice* begin, const Slice* end);
 
-  // Force current memtable contents to be compacted.
+  // Force current memtable contents to be compacted, and wait for any
+  // compaction scheduled as a result to finish.
   Status TEST_CompactMemTable();
 
   // Return an internal iterator over the current state of the database.
@@ -75,6 +81,7 @@ class DBImpl : public DB {
   friend class DB;
   struct CompactionState;
   struct Writer;
+  struct WriteGroup;
 
   // Information for a manual compaction
   struct ManualCompaction {
@@ -85,6 +92,13 @@ class DBImpl : public DB {
     InternalKey tmp_storage;   // Used to keep track of compaction progress
   };
 
+  // A memtable that is no longer written to and waits to be compacted.
+  struct ImmutableMemTable {
+    MemTable* mem;
+    uint64_t log_number;  // Log file holding the contents of mem
+    bool has_unpersisted_data;  // Some writes to mem skipped the log
+  };
+
   // Per level compaction stats.  stats_[level] stores the stats for
   // compactions that produced data for the specified "level".
   struct CompactionStats {
@@ -101,6 +115,18 @@ class DBImpl : public DB {
     int64_t bytes_written;
   };
 
+  // Stats for the batch groups written to the log.
+  struct WriteGroupStats {
+    WriteGroupStats()
+        : groups(0), writers(0), bytes(0), sync_groups(0), wait_micros(0) {}
+
+    int64_t groups;
+    int64_t writers;
+    int64_t bytes;
+    int64_t sync_groups;
+    int64_t wait_micros;  // Time spent gathering sync writers
+  };
+
   Iterator* NewInternalIterator(const ReadOptions&,
                                 SequenceNumber* latest_snapshot,
                                 uint32_t* seed);
@@ -127,12 +153,52 @@ class DBImpl : public DB {
                         VersionEdit* edit, SequenceNumber* max_sequence)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
+  // Write the merged contents of mems to a new table.
+  Status WriteLevel0Table(const std::vector<MemTable*>& mems,
+                          VersionEdit* edit, Version* base)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Create the file and writer for the new log "log_number", reusing a
+  // recycled log file if one is available.
+  Status NewLogFile(uint64_t log_number, WritableFile** file,
+                    log::Writer** writer) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   Status MakeRoomForWrite(bool force /* compact even if there is room? */)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
-  WriteBatch* BuildBatchGroup(Writer** last_writer)
+  WriteBatch* BuildBatchGroup(Writer** last_writer, WriteBatch* tmp_batch)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // If the writer at the front of writers_ is a sync write, wait up to
+  // options_.sync_group_commit_micros for more writers to join its group.
+  // May temporarily unlock and wait.
+  void GatherSyncWriters() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Throttle a write of "num_bytes" to the delayed write rate if level-0
+  // or the pending compaction work is getting close to the point where
+  // writes have to stop.  May temporarily unlock and sleep.
+  void DelayWrite(uint64_t num_bytes) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Return the rate writes should currently be throttled to, or zero if
+  // they should not be throttled.
+  uint64_t DelayedWriteRate() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Implementation of Write() used when options_.enable_pipelined_write
+  // is set.  The log record of a batch group is written while holding the
+  // front of writers_; the memtable insert then happens in order through
+  // memtable_writers_ so the next group can start logging right away.
+  Status PipelinedWrite(const WriteOptions& options, WriteBatch* updates);
+
+  // Wait until *w has been completed by another writer or is at the front
+  // of writers_.  While waiting, *w may be asked by its group leader to
+  // insert its own batch into the memtable.
+  void WaitForWriteTurn(Writer* w) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Apply the logged batch group "group" (whose first element is the
+  // calling writer) to mem, with every writer inserting its own batch
+  // concurrently.  "sequence" is the first sequence number of the group.
+  // Temporarily unlocks mutex_.
+  Status ParallelInsertBatchGroup(const std::vector<Writer*>& group,
+                                  SequenceNumber sequence, MemTable* mem)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   void RecordBackgroundError(const Status& s);
@@ -159,6 +225,7 @@ class DBImpl : public DB {
   Env* const env_;
   const InternalKeyComparator internal_comparator_;
   const InternalFilterPolicy internal_filter_policy_;
+  const InternalKeySliceTransform internal_prefix_extractor_;
   const Options options_;  // options_.comparator == &internal_comparator_
   const bool owns_info_log_;
   const bool owns_cache_;
@@ -175,16 +242,34 @@ class DBImpl : public DB {
   std::atomic<bool> shutting_down_;
   port::CondVar background_work_finished_signal_ GUARDED_BY(mutex_);
   MemTable* mem_;
-  MemTable* imm_ GUARDED_BY(mutex_);  // Memtable being compacted
-  std::atomic<bool> has_imm_;         // So bg thread can detect non-null imm_
+  // Memtables waiting to be compacted, oldest first.
+  std::vector<ImmutableMemTable> imm_ GUARDED_BY(mutex_);
+  std::atomic<bool> has_imm_;  // So bg thread can detect non-empty imm_
   WritableFile* logfile_;
   uint64_t logfile_number_ GUARDED_BY(mutex_);
   log::Writer* log_;
+  // Obsolete log files that will be reused for new logs, oldest first.
+  std::deque<uint64_t> log_recycle_files_ GUARDED_BY(mutex_);
+  // Number of the first log this DBImpl wrote in the recyclable format,
+  // or zero.  Only such logs can be recycled.
+  uint64_t first_recyclable_log_number_ GUARDED_BY(mutex_);
   uint32_t seed_ GUARDED_BY(mutex_);  // For sampling.
 
   // Queue of writers.
   std::deque<Writer*> writers_ GUARDED_BY(mutex_);
+  // Non-null while the front of writers_ waits for a group commit.
+  Writer* group_commit_leader_ GUARDED_BY(mutex_);
   WriteBatch* tmp_batch_ GUARDED_BY(mutex_);
+  // Set once a write to mem_ has skipped the log.  Memtables holding such
+  // writes are flushed when the DB is closed.
+  bool has_unpersisted_data_ GUARDED_BY(mutex_);
+
+  // Batch groups that have been logged but not yet applied to mem_, in
+  // sequence number order.  Only used for pipelined writes.
+  std::deque<WriteGroup*> memtable_writers_ GUARDED_BY(mutex_);
+
+  // Token bucket used to slow down writes while compactions catch up.
+  WriteController write_controller_ GUARDED_BY(mutex_);
 
   SnapshotList snapshots_ GUARDED_BY(mutex_);
 
@@ -203,6 +288,7 @@ class DBImpl : public DB {
   Status bg_error_ GUARDED_BY(mutex_);
 
   CompactionStats stats_[config::kNumLevels] GUARDED_BY(mutex_);
+  WriteGroupStats write_stats_ GUARDED_BY(mutex_);
 };
 
 // Sanitize db options.  The caller should delete result.info_log if
@@ -210,6 +296,7 @@ class DBImpl : public DB {
 Options SanitizeOptions(const std::string& db,
                         const InternalKeyComparator* icmp,
                         const InternalFilterPolicy* ipolicy,
+                        const InternalKeySliceTransform* iprefix,
                         const Options& src);
 
 }  // namespace leveldb
@@ -11,11 +11,13 @@
 #include "gtest/gtest.h"
 #include "db/db_impl.h"
 #include "db/filename.h"
+#include "db/log_writer.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
 #include "leveldb/cache.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/table.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
@@ -138,8 +140,18 @@ class SpecialEnv : public EnvWrapper {
   // Force log file close to fail while this bool is true.
   std::atomic<bool> log_file_close_;
 
+  // Sleeps advance the clock seen by NowMicros() instead of blocking
+  // while this is true.
+  std::atomic<bool> fake_sleep_;
+  std::atomic<uint64_t> fake_sleep_micros_;
+
   bool count_random_reads_;
   AtomicCounter random_read_counter_;
+  // Env::MultiRead() calls, and the reads they were asked to make.
+  AtomicCounter multi_read_counter_;
+  AtomicCounter multi_read_request_counter_;
+
+  AtomicCounter reused_file_counter_;
 
   explicit SpecialEnv(Env* base)
       : EnvWrapper(base),
@@ -150,9 +162,26 @@ class SpecialEnv : public EnvWrapper {
         manifest_sync_error_(false),
         manifest_write_error_(false),
         log_file_close_(false),
+        fake_sleep_(false),
+        fake_sleep_micros_(0),
         count_random_reads_(false) {}
 
-  Status NewWritableFile(const std::string& f, WritableFile** r) {
+  uint64_t NowMicros() override {
+    return target()->NowMicros() +
+           fake_sleep_micros_.load(std::memory_order_acquire);
+  }
+
+  void SleepForMicroseconds(int micros) override {
+    if (fake_sleep_.load(std::memory_order_acquire)) {
+      fake_sleep_micros_.fetch_add(micros, std::memory_order_acq_rel);
+    } else {
+      target()->SleepForMicroseconds(micros);
+    }
+  }
+
+  // Wrap the newly opened file *r so that the simulated errors above
+  // apply to it.
+  void WrapWritableFile(const std::string& f, WritableFile** r) {
     class DataFile : public WritableFile {
      private:
       SpecialEnv* const env_;
@@ -190,6 +219,9 @@ class SpecialEnv : public EnvWrapper {
         }
         return base_->Sync();
       }
+      void SetPreallocationBlockSize(size_t block_size) override {
+        base_->SetPreallocationBlockSize(block_size);
+      }
     };
     class ManifestFile : public WritableFile {
      private:
@@ -217,17 +249,35 @@ class SpecialEnv : public EnvWrapper {
       }
     };
 
+    if (IsLdbFile(f) || IsLogFile(f)) {
+      *r = new DataFile(this, *r, f);
+    } else if (IsManifestFile(f)) {
+      *r = new ManifestFile(this, *r);
+    }
+  }
+
+  Status NewWritableFile(const std::string& f, WritableFile** r) {
     if (non_writable_.load(std::memory_order_acquire)) {
       return Status::IOError("simulated write error");
     }
 
     Status s = target()->NewWritableFile(f, r);
     if (s.ok()) {
-      if (IsLdbFile(f) || IsLogFile(f)) {
-        *r = new DataFile(this, *r, f);
-      } else if (IsManifestFile(f)) {
-        *r = new ManifestFile(this, *r);
-      }
+      WrapWritableFile(f, r);
+    }
+    return s;
+  }
+
+  Status ReuseWritableFile(const std::string& f, const std::string& old_f,
+                           WritableFile** r) {
+    if (non_writable_.load(std::memory_order_acquire)) {
+      return Status::IOError("simulated write error");
+    }
+
+    Status s = target()->ReuseWritableFile(f, old_f, r);
+    if (s.ok()) {
+      reused_file_counter_.Increment();
+      WrapWritableFile(f, r);
     }
     return s;
   }
@@ -255,6 +305,13 @@ class SpecialEnv : public EnvWrapper {
     }
     return s;
   }
+
+  void MultiRead(const RandomAccessFile* const* files, ReadRequest* reqs,
+                 size_t num_reqs) override {
+    multi_read_counter_.Increment();
+    multi_read_request_counter_.IncrementBy(static_cast<int>(num_reqs));
+    target()->MultiRead(files, reqs, num_reqs);
+  }
 };
 
 class DBTest : public testing::Test {
@@ -267,6 +324,10 @@ class DBTest : public testing::Test {
 
   DBTest() : env_(new SpecialEnv(Env::Default())), option_config_(kDefault) {
     filter_policy_ = NewBloomFilterPolicy(10);
+    fuse_filter_policy_ = NewBinaryFuseFilterPolicy(8);
+    prefix_extractor_ = NewFixedPrefixTransform(3);
+    row_cache_ = NewLRUCache(1 << 20);
+    block_cache_ = NewLRUCache(64 << 10, 0.5);
     dbname_ = testing::TempDir() + "db_test";
     DestroyDB(dbname_, Options());
     db_ = nullptr;
@@ -278,6 +339,10 @@ class DBTest : public testing::Test {
     DestroyDB(dbname_, Options());
     delete env_;
     delete filter_policy_;
+    delete fuse_filter_policy_;
+    delete prefix_extractor_;
+    delete row_cache_;
+    delete block_cache_;
   }
 
   // Switch to a fresh database with the next option configuration to
@@ -302,10 +367,61 @@ class DBTest : public testing::Test {
         break;
       case kFilter:
         options.filter_policy = filter_policy_;
+        options.memtable_bloom_size_ratio = 0.02;
         break;
       case kUncompressed:
         options.compression = kNoCompression;
         break;
+      case kPipelinedWrite:
+        options.enable_pipelined_write = true;
+        break;
+      case kConcurrentMemTableWrite:
+        options.allow_concurrent_memtable_write = true;
+        break;
+      case kRecycleLog:
+        options.recycle_log_file_num = 2;
+        options.log_preallocation_block_size = 64 << 10;
+        break;
+      case kReuseRecycledLog:
+        options.reuse_logs = true;
+        options.recycle_log_file_num = 2;
+        break;
+      case kHashMemTable:
+        options.memtable_rep = kHashSkipListRep;
+        options.memtable_hash_bucket_count = 1000;
+        options.prefix_extractor = prefix_extractor_;
+        break;
+      case kVectorMemTable:
+        options.memtable_rep = kVectorRep;
+        break;
+      case kRowCache:
+        options.row_cache = row_cache_;
+        break;
+      case kPartitionedIndex:
+        options.index_partition_size = 128;
+        break;
+      case kDataBlockHashIndex:
+        options.data_block_hash_index = true;
+        break;
+      case kCacheIndexAndFilters:
+        // A small cache, so that index and filter blocks get evicted
+        options.filter_policy = filter_policy_;
+        options.block_cache = block_cache_;
+        options.cache_index_and_filter_blocks = true;
+        options.pin_l0_filter_and_index_blocks_in_cache = true;
+        break;
+      case kFullFilter:
+        options.filter_policy = filter_policy_;
+        options.full_table_filter = true;
+        break;
+      case kFuseFilter:
+        options.filter_policy = fuse_filter_policy_;
+        options.full_table_filter = true;
+        break;
+      case kPrefixFilter:
+        options.filter_policy = filter_policy_;
+        options.prefix_extractor = prefix_extractor_;
+        break;
       default:
         break;
     }
@@ -364,6 +480,31 @@ class DBTest : public testing::Test {
     return result;
   }
 
+  // Returns the results of a MultiGet() of keys, formatted like "v1,v2".
+  std::string MultiGet(const std::vector<std::string>& keys,
+                       const Snapshot* snapshot = nullptr) {
+    ReadOptions options;
+    options.snapshot = snapshot;
+    const int n = static_cast<int>(keys.size());
+    std::vector<Slice> key_slices(keys.begin(), keys.end());
+    std::vector<std::string> values(n);
+    std::vector<Status> statuses(n);
+    db_->MultiGet(options, n, key_slices.data(), values.data(),
+                  statuses.data());
+    std::string result;
+    for (int i = 0; i < n; i++) {
+      if (i > 0) result += ",";
+      if (statuses[i].IsNotFound()) {
+        result += "NOT_FOUND";
+      } else if (!statuses[i].ok()) {
+        result += statuses[i].ToString();
+      } else {
+        result += values[i];
+      }
+    }
+    return result;
+  }
+
   // Return a string that contains all key,value pairs in order,
   // formatted like "(k1->v1)(k2->v2)".
   std::string Contents() {
@@ -471,6 +612,23 @@ class DBTest : public testing::Test {
     return static_cast<int>(files.size());
   }
 
+  // Return the total size of the log files of the DB.
+  uint64_t LogFileBytes() {
+    std::vector<std::string> filenames;
+    EXPECT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+    uint64_t number;
+    FileType type;
+    uint64_t result = 0;
+    for (const std::string& filename : filenames) {
+      uint64_t size;
+      if (ParseFileName(filename, &number, &type) && type == kLogFile &&
+          env_->GetFileSize(dbname_ + "/" + filename, &size).ok()) {
+        result += size;
+      }
+    }
+    return result;
+  }
+
   uint64_t Size(const Slice& start, const Slice& limit) {
     Range r(start, limit);
     uint64_t size;
@@ -562,9 +720,32 @@ class DBTest : public testing::Test {
 
  private:
   // Sequence of option configurations to try
-  enum OptionConfig { kDefault, kReuse, kFilter, kUncompressed, kEnd };
+  enum OptionConfig {
+    kDefault,
+    kReuse,
+    kFilter,
+    kUncompressed,
+    kPipelinedWrite,
+    kConcurrentMemTableWrite,
+    kRecycleLog,
+    kReuseRecycledLog,
+    kHashMemTable,
+    kVectorMemTable,
+    kRowCache,
+    kPartitionedIndex,
+    kDataBlockHashIndex,
+    kCacheIndexAndFilters,
+    kFullFilter,
+    kFuseFilter,
+    kPrefixFilter,
+    kEnd
+  };
 
   const FilterPolicy* filter_policy_;
+  const FilterPolicy* fuse_filter_policy_;
+  const SliceTransform* prefix_extractor_;
+  Cache* row_cache_;
+  Cache* block_cache_;
   int option_config_;
 };
 
@@ -637,6 +818,110 @@ TEST_F(DBTest, GetFromImmutableLayer) {
   } while (ChangeOptions());
 }
 
+TEST_F(DBTest, MultiGet) {
+  do {
+    ASSERT_EQ("", MultiGet({}));
+    ASSERT_EQ("NOT_FOUND,NOT_FOUND", MultiGet({"a", "b"}));
+
+    // Spread the keys over several levels and the memtable.
+    ASSERT_LEVELDB_OK(Put("a", "va1"));
+    ASSERT_LEVELDB_OK(Put("c", "vc1"));
+    ASSERT_LEVELDB_OK(Put("e", "ve1"));
+    ASSERT_LEVELDB_OK(Put("g", "vg1"));
+    dbfull()->TEST_CompactMemTable();
+    dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+    ASSERT_LEVELDB_OK(Put("b", "vb2"));
+    ASSERT_LEVELDB_OK(Put("c", "vc2"));
+    ASSERT_LEVELDB_OK(Delete("e"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_LEVELDB_OK(Put("d", "vd3"));
+    ASSERT_LEVELDB_OK(Delete("g"));
+
+    // Unsorted and repeated keys.
+    const std::vector<std::string> keys = {"g", "a", "e", "c", "x",
+                                           "d", "b", "a", "f"};
+    ASSERT_EQ("NOT_FOUND,va1,NOT_FOUND,vc2,NOT_FOUND,vd3,vb2,va1,NOT_FOUND",
+              MultiGet(keys));
+    std::string expected;
+    for (const std::string& key : keys) {
+      if (!expected.empty()) expected += ",";
+      expected += Get(key);
+    }
+    ASSERT_EQ(expected, MultiGet(keys));
+
+    // All keys are read from the same snapshot.
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_LEVELDB_OK(Put("a", "va4"));
+    ASSERT_LEVELDB_OK(Delete("c"));
+    ASSERT_EQ("va1,vc2", MultiGet({"a", "c"}, snapshot));
+    ASSERT_EQ("va4,NOT_FOUND", MultiGet({"a", "c"}));
+    db_->ReleaseSnapshot(snapshot);
+  } while (ChangeOptions());
+}
+
+TEST_F(DBTest, MultiGetReadsEachLevelAtOnce) {
+  Cache* block_cache = NewLRUCache(0);  // Disables block caching
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.create_if_missing = true;
+  options.block_cache = block_cache;
+  DestroyAndReopen(&options);
+
+  // Two files in level 2 that hold different keys.
+  ASSERT_LEVELDB_OK(Put("a", "va"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_LEVELDB_OK(Put("m", "vm"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("0,0,2", FilesPerLevel());
+
+  env_->multi_read_counter_.Reset();
+  env_->multi_read_request_counter_.Reset();
+  ASSERT_EQ("va,vm", MultiGet({"a", "m"}));
+  ASSERT_EQ(1, env_->multi_read_counter_.Read());
+  ASSERT_EQ(2, env_->multi_read_request_counter_.Read());
+
+  // Files of b, c and d in levels 2 and 1, so that later flushes of them
+  // stay in level 0.
+  for (int i = 1; i <= 2; i++) {
+    ASSERT_LEVELDB_OK(Put("b", "vb" + std::to_string(i)));
+    ASSERT_LEVELDB_OK(Put("c", "vc" + std::to_string(i)));
+    ASSERT_LEVELDB_OK(Put("d", "vd" + std::to_string(i)));
+    dbfull()->TEST_CompactMemTable();
+  }
+  ASSERT_EQ("0,1,3", FilesPerLevel());
+
+  // Three overlapping level-0 files, each shadowing some of the entries
+  // of the ones before it.
+  ASSERT_LEVELDB_OK(Put("b", "vb3"));
+  ASSERT_LEVELDB_OK(Put("c", "vc3"));
+  ASSERT_LEVELDB_OK(Put("d", "vd3"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_LEVELDB_OK(Delete("c"));
+  ASSERT_LEVELDB_OK(Put("d", "vd4"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_LEVELDB_OK(Put("d", "vd5"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("3,1,3", FilesPerLevel());
+
+  // The level-0 files are read together, and the other levels are not
+  // read since level 0 settles every key.
+  env_->multi_read_counter_.Reset();
+  env_->multi_read_request_counter_.Reset();
+  ASSERT_EQ("vb3,NOT_FOUND,vd5", MultiGet({"b", "c", "d"}));
+  ASSERT_EQ(1, env_->multi_read_counter_.Read());
+  ASSERT_EQ(3, env_->multi_read_request_counter_.Read());
+
+  // Keys that level 0 does not settle are looked for in the other levels.
+  env_->multi_read_counter_.Reset();
+  env_->multi_read_request_counter_.Reset();
+  ASSERT_EQ("va,vb3,vm", MultiGet({"a", "b", "m"}));
+  ASSERT_EQ(2, env_->multi_read_counter_.Read());
+  ASSERT_EQ(3, env_->multi_read_request_counter_.Read());
+
+  Close();
+  delete block_cache;
+}
+
 TEST_F(DBTest, GetFromVersions) {
   do {
     ASSERT_LEVELDB_OK(Put("foo", "v1"));
@@ -645,6 +930,109 @@ TEST_F(DBTest, GetFromVersions) {
   } while (ChangeOptions());
 }
 
+TEST_F(DBTest, CacheIndexAndFilterBlocks) {
+  const FilterPolicy* filter_policy = NewBloomFilterPolicy(10);
+  for (bool pin : {false, true}) {
+    Cache* block_cache = NewLRUCache(1 << 20, 0.5);
+    Options options = CurrentOptions();
+    options.env = env_;
+    options.create_if_missing = true;
+    options.filter_policy = filter_policy;
+    options.block_cache = block_cache;
+    options.cache_index_and_filter_blocks = true;
+    options.pin_l0_filter_and_index_blocks_in_cache = pin;
+    env_->count_random_reads_ = true;
+    DestroyAndReopen(&options);
+
+    // One file in each of levels 0, 1 and 2
+    for (int i = 0; i < 3; i++) {
+      ASSERT_LEVELDB_OK(Put("a", "va" + std::to_string(i)));
+      ASSERT_LEVELDB_OK(Put("z", "vz" + std::to_string(i)));
+      dbfull()->TEST_CompactMemTable();
+    }
+    ASSERT_EQ("1,1,1", FilesPerLevel());
+    ASSERT_EQ("va2", Get("a"));
+    ASSERT_GT(block_cache->TotalCharge(), 0);
+
+    // Only pinned blocks survive a prune.
+    block_cache->Prune();
+    if (pin) {
+      ASSERT_GT(block_cache->TotalCharge(), 0);
+    } else {
+      ASSERT_EQ(0, block_cache->TotalCharge());
+    }
+
+    // Evicted index and filter blocks are read again.
+    env_->random_read_counter_.Reset();
+    ASSERT_EQ("va2", Get("a"));
+    if (pin) {
+      ASSERT_EQ(1, env_->random_read_counter_.Read());  // Data block
+    } else {
+      ASSERT_GT(env_->random_read_counter_.Read(), 1);
+    }
+    env_->count_random_reads_ = false;
+
+    Close();  // The cache must not have handles left when deleted
+    delete block_cache;
+  }
+  delete filter_policy;
+}
+
+TEST_F(DBTest, RowCache) {
+  Cache* row_cache = NewLRUCache(1 << 20);
+  Cache* block_cache = NewLRUCache(0);  // Disables block caching
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.create_if_missing = true;
+  options.row_cache = row_cache;
+  options.block_cache = block_cache;
+  env_->count_random_reads_ = true;
+  DestroyAndReopen(&options);
+
+  ASSERT_LEVELDB_OK(Put("a", "va1"));
+  ASSERT_LEVELDB_OK(Put("b", "vb1"));
+  ASSERT_LEVELDB_OK(Delete("c"));
+  dbfull()->TEST_CompactMemTable();
+
+  // Hits are answered without reading the table file.
+  for (int i = 0; i < 2; i++) {
+    env_->random_read_counter_.Reset();
+    ASSERT_EQ("va1", Get("a"));
+    ASSERT_EQ("NOT_FOUND", Get("c"));
+    ASSERT_EQ("va1,vb1,NOT_FOUND", MultiGet({"a", "b", "c"}));
+    if (i == 0) {
+      ASSERT_GT(env_->random_read_counter_.Read(), 0);
+    } else {
+      ASSERT_EQ(0, env_->random_read_counter_.Read());
+    }
+  }
+  ASSERT_GT(row_cache->TotalCharge(), 0);
+
+  // Keys that are not in the file are not cached.
+  env_->random_read_counter_.Reset();
+  ASSERT_EQ("NOT_FOUND", Get("bb"));
+  ASSERT_EQ("NOT_FOUND", Get("bb"));
+  ASSERT_GT(env_->random_read_counter_.Read(), 0);
+  env_->count_random_reads_ = false;
+
+  // Newer files shadow the cached entries of older ones.
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_LEVELDB_OK(Put("a", "va2"));
+  ASSERT_LEVELDB_OK(Put("c", "vc2"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("va2", Get("a"));
+  ASSERT_EQ("vc2", Get("c"));
+  ASSERT_EQ("va1", Get("a", snapshot));
+  ASSERT_EQ("NOT_FOUND", Get("c", snapshot));
+  db_->ReleaseSnapshot(snapshot);
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  ASSERT_EQ("va2,vb1,vc2", MultiGet({"a", "b", "c"}));
+
+  Close();
+  delete block_cache;
+  delete row_cache;
+}
+
 TEST_F(DBTest, GetMemUsage) {
   do {
     ASSERT_LEVELDB_OK(Put("foo", "v1"));
@@ -1073,12 +1461,212 @@ TEST_F(DBTest, RecoverDuringMemtableCompaction) {
   } while (ChangeOptions());
 }
 
+TEST_F(DBTest, RecoverCompressedLog) {
+  int tested = 0;
+  for (CompressionType type : {kSnappyCompression, kZstdCompression}) {
+    if (!log::CompressionSupported(type, /*zstd_level=*/1)) {
+      continue;
+    }
+    tested++;
+    Options options = CurrentOptions();
+    options.create_if_missing = true;
+    options.wal_compression = type;
+    DestroyAndReopen(&options);
+    ASSERT_LEVELDB_OK(Put("foo", "v1"));
+    ASSERT_LEVELDB_OK(Put("big", std::string(100000, 'x')));
+
+    // The log holds the big value in compressed form.
+    ASSERT_LT(LogFileBytes(), 10000);
+
+    Reopen(&options);
+    ASSERT_EQ("v1", Get("foo"));
+    ASSERT_EQ(std::string(100000, 'x'), Get("big"));
+    ASSERT_LEVELDB_OK(Put("bar", "v2"));
+    ASSERT_LEVELDB_OK(Put("foo", "v3"));
+
+    Reopen(&options);
+    ASSERT_EQ("v3", Get("foo"));
+    ASSERT_EQ("v2", Get("bar"));
+    ASSERT_EQ(std::string(100000, 'x'), Get("big"));
+  }
+  if (tested == 0) {
+    GTEST_SKIP() << "skipping compressed log test: no compression support";
+  }
+}
+
 static std::string Key(int i) {
   char buf[100];
   std::snprintf(buf, sizeof(buf), "key%06d", i);
   return std::string(buf);
 }
 
+TEST_F(DBTest, RecycleLogFiles) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.create_if_missing = true;
+  options.write_buffer_size = 100000;  // Small write buffer
+  options.recycle_log_file_num = 2;
+  DestroyAndReopen(&options);
+
+  // Write enough to switch logs many times.  Later logs overwrite the
+  // files of earlier ones, and since each memtable gets a similar amount
+  // of data, their stale tails are short.
+  std::string value(1000, 'v');
+  for (int i = 0; i < 2000; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), value + Key(i)));
+  }
+  std::vector<std::string> filenames;
+  ASSERT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+  int log_files = 0;
+  uint64_t number;
+  FileType type;
+  for (const std::string& filename : filenames) {
+    if (ParseFileName(filename, &number, &type) && type == kLogFile) {
+      log_files++;
+    }
+  }
+  // The current log, the logs of memtables still being compacted, and
+  // up to two recycled files.
+  ASSERT_LE(log_files, 1 + options.max_write_buffer_number + 2);
+  ASSERT_GT(env_->reused_file_counter_.Read(), 0);
+
+  // Write less than a memtable worth of data so that the current,
+  // recycled log ends before the stale data written by its previous use.
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_LEVELDB_OK(Put("foo", "v1"));
+  ASSERT_LEVELDB_OK(Put("bar", "v2"));
+
+  // A recycled log with a stale tail must not be appended to, even with
+  // reuse_logs.
+  for (int reopen = 0; reopen < 2; reopen++) {
+    options.reuse_logs = (reopen == 0);
+    Reopen(&options);
+    ASSERT_EQ("v1", Get("foo"));
+    ASSERT_EQ("v2", Get("bar"));
+    for (int i = 0; i < 2000; i++) {
+      ASSERT_EQ(value + Key(i), Get(Key(i)));
+    }
+  }
+}
+
+TEST_F(DBTest, ReuseRecycledLog) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.create_if_missing = true;
+  options.reuse_logs = true;
+  options.recycle_log_file_num = 2;
+  DestroyAndReopen(&options);
+
+  // Writes appended to a reused log written in the recyclable format
+  // must survive the next recovery.
+  ASSERT_LEVELDB_OK(Put("a", "v1"));
+  Reopen(&options);
+  ASSERT_LEVELDB_OK(Put("b", "v2"));
+  Reopen(&options);
+  ASSERT_LEVELDB_OK(Put("c", "v3"));
+  Reopen(&options);
+  ASSERT_EQ("v1", Get("a"));
+  ASSERT_EQ("v2", Get("b"));
+  ASSERT_EQ("v3", Get("c"));
+  ASSERT_EQ("", FilesPerLevel());  // The log was reused every time
+}
+
+TEST_F(DBTest, DisableWAL) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  WriteOptions write_options;
+  write_options.disable_wal = true;
+  write_options.sync = true;
+  ASSERT_TRUE(db_->Put(write_options, "foo", "v1").IsInvalidArgument());
+
+  write_options.sync = false;
+  ASSERT_LEVELDB_OK(db_->Put(write_options, "foo", "v1"));
+  ASSERT_LEVELDB_OK(db_->Put(write_options, "bar", "v2"));
+  ASSERT_EQ("v1", Get("foo"));
+
+  // Nothing was appended to the log.
+  ASSERT_EQ(0, LogFileBytes());
+
+  // An explicit flush makes the writes durable.
+  ASSERT_EQ(0, TotalTableFiles());
+  ASSERT_LEVELDB_OK(db_->FlushMemTable());
+  ASSERT_EQ(1, TotalTableFiles());
+
+  // So does closing the DB.
+  ASSERT_LEVELDB_OK(db_->Put(write_options, "foo", "v3"));
+  ASSERT_LEVELDB_OK(Put("baz", "v4"));
+  Reopen(&options);
+  ASSERT_EQ("v3", Get("foo"));
+  ASSERT_EQ("v2", Get("bar"));
+  ASSERT_EQ("v4", Get("baz"));
+
+  // Once unlogged writes have been flushed, closing the DB does not flush
+  // again, so later writes are recovered from the log.
+  ASSERT_LEVELDB_OK(db_->Put(write_options, "foo", "v5"));
+  ASSERT_LEVELDB_OK(db_->FlushMemTable());
+  ASSERT_LEVELDB_OK(Put("baz", "v6"));
+  Close();
+  ASSERT_GT(LogFileBytes(), 0);
+  Reopen(&options);
+  ASSERT_EQ("v5", Get("foo"));
+  ASSERT_EQ("v6", Get("baz"));
+}
+
+TEST_F(DBTest, GetFromMultipleImmutableLayers) {
+  do {
+    Options options = CurrentOptions();
+    options.env = env_;
+    options.write_buffer_size = 100000;  // Small write buffer
+    options.max_write_buffer_number = 4;
+    Reopen(&options);
+
+    // Block sync calls so that full memtables pile up behind the first
+    // memtable compaction.
+    env_->delay_data_sync_.store(true, std::memory_order_release);
+    for (int i = 0; i < 8; i++) {
+      ASSERT_LEVELDB_OK(Put(Key(i), std::string(40000, 'a' + i)));
+    }
+    // Switch to a new memtable without waiting for the compaction.
+    ASSERT_LEVELDB_OK(dbfull()->Write(WriteOptions(), nullptr));
+    std::string num_imm;
+    ASSERT_TRUE(
+        db_->GetProperty("leveldb.num-immutable-mem-table", &num_imm));
+    ASSERT_EQ("3", num_imm);
+    ASSERT_LEVELDB_OK(Put(Key(0), "v0"));
+    for (int i = 1; i < 8; i++) {
+      ASSERT_EQ(std::string(40000, 'a' + i), Get(Key(i)));
+    }
+    ASSERT_EQ("v0", Get(Key(0)));
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    iter->SeekToFirst();
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ("v0", iter->value().ToString());
+    int count = 0;
+    for (; iter->Valid(); iter->Next()) {
+      count++;
+    }
+    ASSERT_EQ(8, count);
+    delete iter;
+
+    // Release sync calls.  The memtables still queued behind the first
+    // compaction are merged into a single table.
+    env_->delay_data_sync_.store(false, std::memory_order_release);
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    ASSERT_LE(TotalTableFiles(), 3);
+    for (int i = 1; i < 8; i++) {
+      ASSERT_EQ(std::string(40000, 'a' + i), Get(Key(i)));
+    }
+    ASSERT_EQ("v0", Get(Key(0)));
+
+    Reopen(&options);
+    ASSERT_EQ("v0", Get(Key(0)));
+    ASSERT_EQ(std::string(40000, 'h'), Get(Key(7)));
+  } while (ChangeOptions());
+}
+
 TEST_F(DBTest, MinorCompactionsHappen) {
   Options options = CurrentOptions();
   options.write_buffer_size = 10000;
@@ -1173,6 +1761,76 @@ TEST_F(DBTest, RepeatedWritesToSameKey) {
   }
 }
 
+// Occupies the background thread of an Env, which keeps compactions
+// from running, until it is destroyed.
+class BackgroundBlocker {
+ public:
+  explicit BackgroundBlocker(Env* env) : released_(false), running_(true) {
+    env->Schedule(&BackgroundBlocker::Run, this);
+  }
+
+  ~BackgroundBlocker() {
+    released_.store(true, std::memory_order_release);
+    while (running_.load(std::memory_order_acquire)) {
+      DelayMilliseconds(1);
+    }
+  }
+
+ private:
+  static void Run(void* arg) {
+    BackgroundBlocker* blocker = reinterpret_cast<BackgroundBlocker*>(arg);
+    while (!blocker->released_.load(std::memory_order_acquire)) {
+      DelayMilliseconds(1);
+    }
+    blocker->running_.store(false, std::memory_order_release);
+  }
+
+  std::atomic<bool> released_;
+  std::atomic<bool> running_;
+};
+
+TEST_F(DBTest, DelayedWriteRate) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  Reopen(&options);
+
+  // Leave one more level-0 file's worth of updates in the log than the
+  // slowdown trigger.
+  const int kL0Files = config::kL0_SlowdownWritesTrigger + 1;
+  Random rnd(301);
+  for (int i = 0; i < kL0Files; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), RandomString(&rnd, 70000)));
+  }
+
+  // Recovering with a small write buffer writes each of them to its own
+  // level-0 file, which no compaction can pick up while the background
+  // thread is busy.
+  BackgroundBlocker blocker(env_);
+  options.write_buffer_size = 64 << 10;
+  options.max_write_buffer_number = 64;
+  // A rate this low is not scaled down any further.
+  options.delayed_write_rate = 1000;
+  Reopen(&options);
+  ASSERT_EQ(kL0Files, NumTableFilesAtLevel(0));
+
+  env_->fake_sleep_.store(true, std::memory_order_release);
+  uint64_t start = env_->NowMicros();
+  for (int i = 0; i < 10; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), std::string(1000, 'x')));
+  }
+  uint64_t micros = env_->NowMicros() - start;
+  ASSERT_GT(micros, 9500000);
+  ASSERT_LT(micros, 11000000);
+
+  // A single batch may owe more micros than fit in an int.
+  start = env_->NowMicros();
+  ASSERT_LEVELDB_OK(Put("big", std::string(3000000, 'x')));
+  micros = env_->NowMicros() - start;
+  ASSERT_GT(micros, 2990000000ull);
+  ASSERT_LT(micros, 3010000000ull);
+  env_->fake_sleep_.store(false, std::memory_order_release);
+}
+
 TEST_F(DBTest, SparseMerge) {
   Options options = CurrentOptions();
   options.compression = kNoCompression;
@@ -1977,6 +2635,157 @@ TEST_F(DBTest, BloomFilter) {
   delete options.filter_policy;
 }
 
+TEST_F(DBTest, FullTableFilter) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.full_table_filter = true;
+  Reopen(&options);
+
+  const int N = 10000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+  }
+  Compact("a", "z");
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+  int reads = env_->random_read_counter_.Read();
+  ASSERT_GE(reads, N);
+  ASSERT_LE(reads, N + 2 * N / 100);
+
+  // Missing keys are ruled out without reading index or data blocks.
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+  }
+  reads = env_->random_read_counter_.Read();
+  ASSERT_LE(reads, 3 * N / 100);
+
+  // Tables written with per-block filters can still be read.
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+  options.full_table_filter = false;
+  Reopen(&options);
+  for (int i = 0; i < N; i += 100) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i) + "v2"));
+  }
+  dbfull()->TEST_CompactMemTable();
+  for (int i = 0; i < N; i += 10) {
+    ASSERT_EQ(i % 100 == 0 ? Key(i) + "v2" : Key(i), Get(Key(i)));
+  }
+
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
+static std::string TenantKey(int tenant, int entity) {
+  char buf[100];
+  std::snprintf(buf, sizeof(buf), "tenant%03d/e%04d", tenant, entity);
+  return std::string(buf);
+}
+
+TEST_F(DBTest, PrefixSeek) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.prefix_extractor = NewFixedPrefixTransform(10);
+  Reopen(&options);
+
+  // Every table holds the even tenants of one range of ten tenants.
+  const int kTenants = 100;
+  const int kEntities = 50;
+  for (int t = 0; t < kTenants; t++) {
+    if (t % 2 == 0) {
+      for (int e = 0; e < kEntities; e++) {
+        ASSERT_LEVELDB_OK(Put(TenantKey(t, e), std::string(100, 'v')));
+      }
+    }
+    if (t % 10 == 9) {
+      dbfull()->TEST_CompactMemTable();
+    }
+  }
+  // Tables in level 0 and level 1 overlap all of the others.
+  for (int i = 0; i < 2; i++) {
+    ASSERT_LEVELDB_OK(Put("tenant", "short"));
+    ASSERT_LEVELDB_OK(Put("tenant999/", "last"));
+    dbfull()->TEST_CompactMemTable();
+  }
+  ASSERT_EQ("1,1,10", FilesPerLevel());
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+
+  ReadOptions prefix_seek;
+  prefix_seek.prefix_same_as_start = true;
+  Iterator* iter = db_->NewIterator(prefix_seek);
+  for (int t = 0; t < kTenants; t += 2) {
+    int count = 0;
+    for (iter->Seek(TenantKey(t, 10)); iter->Valid(); iter->Next()) {
+      ASSERT_EQ(TenantKey(t, 10 + count), iter->key().ToString());
+      count++;
+    }
+    ASSERT_EQ(kEntities - 10, count);
+  }
+  delete iter;
+
+  // A bounded iterator cannot move backwards.
+  iter = db_->NewIterator(prefix_seek);
+  iter->Seek(TenantKey(2, 10));
+  ASSERT_TRUE(iter->Valid());
+  iter->Prev();
+  ASSERT_TRUE(!iter->Valid());
+  ASSERT_TRUE(iter->status().IsNotSupportedError());
+  delete iter;
+
+  // Seeks into missing tenants are ruled out without reading data blocks.
+  env_->random_read_counter_.Reset();
+  for (int t = 1; t < kTenants; t += 2) {
+    iter = db_->NewIterator(prefix_seek);
+    iter->Seek(TenantKey(t, 0));
+    ASSERT_TRUE(!iter->Valid());
+    delete iter;
+  }
+  ASSERT_LE(env_->random_read_counter_.Read(), 5);
+
+  // Seeks to keys outside the domain of the extractor are not bounded,
+  // and neither is a scan from the start.
+  iter = db_->NewIterator(prefix_seek);
+  iter->Seek("tenant0");
+  ASSERT_EQ(TenantKey(0, 0), iter->key().ToString());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_EQ(kTenants / 2 * kEntities + 2, count);
+  ASSERT_LEVELDB_OK(iter->status());
+  delete iter;
+
+  // Without prefix seek, the same seeks read the next tenant.
+  env_->random_read_counter_.Reset();
+  for (int t = 1; t < kTenants - 1; t += 2) {
+    iter = db_->NewIterator(ReadOptions());
+    iter->Seek(TenantKey(t, 0));
+    ASSERT_EQ(TenantKey(t + 1, 0), iter->key().ToString());
+    delete iter;
+  }
+  ASSERT_GE(env_->random_read_counter_.Read(), kTenants - 2);
+
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+  delete options.prefix_extractor;
+}
+
 TEST_F(DBTest, LogCloseError) {
   // Regression test for bug where we could ignore log file
   // Close() error when switching to a new log file.
@@ -2101,6 +2910,72 @@ TEST_F(DBTest, MultiThreaded) {
   } while (ChangeOptions());
 }
 
+namespace {
+
+static const int kGroupCommitWrites = 25;
+
+struct GroupCommitThread {
+  DB* db;
+  int id;
+  std::atomic<bool> done;
+};
+
+static void GroupCommitThreadBody(void* arg) {
+  GroupCommitThread* t = reinterpret_cast<GroupCommitThread*>(arg);
+  WriteOptions options;
+  options.sync = true;
+  for (int i = 0; i < kGroupCommitWrites; i++) {
+    char keybuf[20];
+    std::snprintf(keybuf, sizeof(keybuf), "%d.%04d", t->id, i);
+    ASSERT_LEVELDB_OK(t->db->Put(options, keybuf, "v"));
+  }
+  t->done.store(true, std::memory_order_release);
+}
+
+}  // namespace
+
+TEST_F(DBTest, SyncGroupCommit) {
+  WriteBatch batch;
+  batch.Put("0.0000", "v");
+
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.sync_group_commit_micros = 100000;
+  // Stop waiting as soon as a second writer has joined the leader.
+  options.sync_group_commit_bytes = 2 * WriteBatchInternal::ByteSize(&batch);
+  DestroyAndReopen(&options);
+
+  GroupCommitThread thread[kNumThreads];
+  for (int id = 0; id < kNumThreads; id++) {
+    thread[id].db = db_;
+    thread[id].id = id;
+    thread[id].done.store(false, std::memory_order_release);
+    env_->StartThread(GroupCommitThreadBody, &thread[id]);
+  }
+  for (int id = 0; id < kNumThreads; id++) {
+    while (!thread[id].done.load(std::memory_order_acquire)) {
+      DelayMilliseconds(10);
+    }
+  }
+
+  for (int id = 0; id < kNumThreads; id++) {
+    for (int i = 0; i < kGroupCommitWrites; i++) {
+      char keybuf[20];
+      std::snprintf(keybuf, sizeof(keybuf), "%d.%04d", id, i);
+      ASSERT_EQ("v", Get(keybuf));
+    }
+  }
+
+  std::string stats;
+  ASSERT_TRUE(db_->GetProperty("leveldb.write-group-stats", &stats));
+  long long groups, sync_groups;
+  ASSERT_EQ(2, std::sscanf(stats.c_str(), "Groups: %lld, sync groups: %lld",
+                           &groups, &sync_groups))
+      << stats;
+  ASSERT_EQ(groups, sync_groups);
+  ASSERT_LT(groups, kNumThreads * kGroupCommitWrites);
+}
+
 namespace {
 typedef std::map<std::string, std::string> KVMap;
 }
@@ -23,7 +23,7 @@ namespace leveldb {
 
 namespace {
 
-bool GuessType(const std::string& fname, FileType* type) {
+bool GuessType(const std::string& fname, uint64_t* number, FileType* type) {
   size_t pos = fname.rfind('/');
   std::string basename;
   if (pos == std::string::npos) {
@@ -31,8 +31,12 @@ bool GuessType(const std::string& fname, FileType* type) {
   } else {
     basename = std::string(fname.data() + pos + 1, fname.size() - pos - 1);
   }
+  return ParseFileName(basename, number, type);
+}
+
+bool GuessType(const std::string& fname, FileType* type) {
   uint64_t ignored;
-  return ParseFileName(basename, &ignored, type);
+  return GuessType(fname, &ignored, type);
 }
 
 // Notified when log reader encounters corruption.
@@ -61,7 +65,11 @@ Status PrintLogContents(Env* env, const std::string& fname,
   }
   CorruptionReporter reporter;
   reporter.dst_ = dst;
-  log::Reader reader(file, &reporter, true, 0);
+  // Records in a recycled log file are tagged with the log number.
+  uint64_t log_number = 0;
+  FileType ignored_type;
+  GuessType(fname, &log_number, &ignored_type);
+  log::Reader reader(file, &reporter, true, 0, log_number);
   Slice record;
   std::string scratch;
   while (reader.ReadRecord(&record, &scratch)) {
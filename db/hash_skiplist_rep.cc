@@ -0,0 +1,142 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A MemTableRep that hashes the prefix of every user key to one of a
+// fixed number of buckets, each of which is a skiplist of the entries
+// whose prefix maps to it.  A point lookup only has to search the
+// (typically short) skiplist of its bucket.  Iterating over the whole
+// representation merges all of the buckets into a sorted array first.
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <vector>
+
+#include "db/memtablerep.h"
+#include "db/skiplist.h"
+#include "leveldb/slice_transform.h"
+#include "util/arena.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+namespace {
+
+typedef SkipList<const char*, const MemTableKeyComparator&> Bucket;
+
+class HashSkipListRep : public MemTableRep {
+ public:
+  HashSkipListRep(const MemTableKeyComparator& cmp, Arena* arena,
+                  const SliceTransform* prefix_extractor, size_t bucket_count)
+      : MemTableRep(arena),
+        compare_(cmp),
+        prefix_extractor_(prefix_extractor),
+        bucket_count_(std::max<size_t>(bucket_count, 1)) {
+    char* mem =
+        arena_->AllocateAligned(sizeof(std::atomic<Bucket*>) * bucket_count_);
+    buckets_ = reinterpret_cast<std::atomic<Bucket*>*>(mem);
+    for (size_t i = 0; i < bucket_count_; i++) {
+      new (&buckets_[i]) std::atomic<Bucket*>(nullptr);
+    }
+  }
+
+  void Insert(const char* entry) override {
+    std::atomic<Bucket*>* slot = BucketSlot(entry);
+    Bucket* bucket = slot->load(std::memory_order_relaxed);
+    if (bucket == nullptr) {
+      char* mem = arena_->AllocateAligned(sizeof(Bucket));
+      bucket = new (mem) Bucket(compare_, arena_);
+      // Release-store so that readers see a fully initialized bucket.
+      slot->store(bucket, std::memory_order_release);
+    }
+    bucket->Insert(entry);
+  }
+
+  void InsertConcurrently(const char* entry) override {
+    std::atomic<Bucket*>* slot = BucketSlot(entry);
+    Bucket* bucket = slot->load(std::memory_order_acquire);
+    if (bucket == nullptr) {
+      char* mem = arena_->AllocateAlignedConcurrently(sizeof(Bucket));
+      Bucket* created = new (mem) Bucket(compare_, arena_, true);
+      // If another thread created the bucket first, use its bucket.  The
+      // memory of ours stays in the arena unused.
+      if (slot->compare_exchange_strong(bucket, created,
+                                        std::memory_order_release,
+                                        std::memory_order_acquire)) {
+        bucket = created;
+      }
+    }
+    bucket->InsertConcurrently(entry);
+  }
+
+  const char* Lookup(const char* key) const override {
+    Bucket* bucket = BucketSlot(key)->load(std::memory_order_acquire);
+    if (bucket == nullptr) {
+      return nullptr;
+    }
+    Bucket::Iterator iter(bucket);
+    iter.Seek(key);
+    return iter.Valid() ? iter.key() : nullptr;
+  }
+
+  Iterator* NewIterator() const override {
+    // Merge the sorted buckets into one sorted array.
+    std::vector<Bucket::Iterator> heap;
+    for (size_t i = 0; i < bucket_count_; i++) {
+      Bucket* bucket = buckets_[i].load(std::memory_order_acquire);
+      if (bucket != nullptr) {
+        Bucket::Iterator iter(bucket);
+        iter.SeekToFirst();
+        if (iter.Valid()) {
+          heap.push_back(iter);
+        }
+      }
+    }
+    // Orders the heap so that the iterator with the smallest key is first.
+    auto greater = [this](const Bucket::Iterator& a,
+                          const Bucket::Iterator& b) {
+      return compare_(a.key(), b.key()) > 0;
+    };
+    std::make_heap(heap.begin(), heap.end(), greater);
+    std::vector<const char*> entries;
+    while (!heap.empty()) {
+      std::pop_heap(heap.begin(), heap.end(), greater);
+      Bucket::Iterator& iter = heap.back();
+      entries.push_back(iter.key());
+      iter.Next();
+      if (iter.Valid()) {
+        std::push_heap(heap.begin(), heap.end(), greater);
+      } else {
+        heap.pop_back();
+      }
+    }
+    return NewSortedArrayIterator(compare_, &entries);
+  }
+
+ private:
+  // Return the slot of the bucket of the entry (or encoded key) at "key".
+  std::atomic<Bucket*>* BucketSlot(const char* key) const {
+    Slice prefix = GetMemTableEntryKey(key);
+    if (prefix_extractor_ != nullptr && prefix_extractor_->InDomain(prefix)) {
+      prefix = prefix_extractor_->Transform(prefix);
+    }
+    prefix = ExtractUserKey(prefix);
+    return &buckets_[Hash(prefix.data(), prefix.size(), 0) % bucket_count_];
+  }
+
+  const MemTableKeyComparator& compare_;
+  const SliceTransform* const prefix_extractor_;
+  const size_t bucket_count_;
+  std::atomic<Bucket*>* buckets_;  // Allocated from arena_
+};
+
+}  // namespace
+
+MemTableRep* NewHashSkipListRep(const MemTableKeyComparator& cmp, Arena* arena,
+                                const SliceTransform* prefix_extractor,
+                                size_t bucket_count) {
+  return new HashSkipListRep(cmp, arena, prefix_extractor, bucket_count);
+}
+
+}  // namespace leveldb
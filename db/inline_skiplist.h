@@ -0,0 +1,552 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_INLINE_SKIPLIST_H_
+#define STORAGE_LEVELDB_DB_INLINE_SKIPLIST_H_
+
+// InlineSkipList is a SkipList (see skiplist.h) of variable-length keys
+// that are stored inside the nodes of the list.  Every node is a single
+// arena allocation that holds its links followed by the key, so comparing
+// a key during a search reads the cache lines of the node itself instead
+// of chasing a pointer to a separately allocated key.  Searches also
+// prefetch the node after the one being compared.
+//
+// A key is inserted in two steps: AllocateKey() returns the memory of the
+// key inside a new node, which the caller fills in before passing it to
+// Insert().
+//
+// Memory layout of a node of height h, which is referred to by a pointer
+// to its level 0 link:
+//
+//     next_[-(h-1)] ... next_[-1] next_[0] key bytes
+//
+// Thread safety and invariants are the same as for SkipList.
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <thread>
+
+#include "port/port.h"
+#include "util/arena.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+template <class Comparator>
+class InlineSkipList {
+ private:
+  struct Node;
+
+ public:
+  // Create a new InlineSkipList object that will use "cmp" for comparing
+  // keys, and will allocate memory using "*arena".  Objects allocated in
+  // the arena must remain allocated for the lifetime of the list.
+  explicit InlineSkipList(Comparator cmp, Arena* arena);
+
+  InlineSkipList(const InlineSkipList&) = delete;
+  InlineSkipList& operator=(const InlineSkipList&) = delete;
+
+  // Allocate a new node with room for a key of key_size bytes and return
+  // a pointer to the key, which must be filled in and then passed to
+  // Insert().
+  char* AllocateKey(size_t key_size);
+
+  // Like AllocateKey(), but may be called from several threads at once.
+  // The result must be passed to InsertConcurrently().
+  char* AllocateKeyConcurrently(size_t key_size);
+
+  // Insert a key returned by AllocateKey() into the list.  Inserts that
+  // land next to the previous insert, such as keys inserted in increasing
+  // order, are O(1) amortized.
+  // REQUIRES: nothing that compares equal to key is currently in the list.
+  void Insert(const char* key);
+
+  // Like Insert(), but safe to call from several threads at once without
+  // external synchronization.  Must not be mixed with concurrent calls to
+  // Insert().
+  // REQUIRES: nothing that compares equal to key is currently in the list.
+  void InsertConcurrently(const char* key);
+
+  // Returns true iff an entry that compares equal to key is in the list.
+  bool Contains(const char* key) const;
+
+  // Iteration over the contents of a skip list
+  class Iterator {
+   public:
+    // Initialize an iterator over the specified list.
+    // The returned iterator is not valid.
+    explicit Iterator(const InlineSkipList* list);
+
+    // Returns true iff the iterator is positioned at a valid node.
+    bool Valid() const;
+
+    // Returns the key at the current position.
+    // REQUIRES: Valid()
+    const char* key() const;
+
+    // Advances to the next position.
+    // REQUIRES: Valid()
+    void Next();
+
+    // Advances to the previous position.
+    // REQUIRES: Valid()
+    void Prev();
+
+    // Advance to the first entry with a key >= target
+    void Seek(const char* target);
+
+    // Position at the first entry in list.
+    // Final state of iterator is Valid() iff list is not empty.
+    void SeekToFirst();
+
+    // Position at the last entry in list.
+    // Final state of iterator is Valid() iff list is not empty.
+    void SeekToLast();
+
+   private:
+    const InlineSkipList* list_;
+    Node* node_;
+    // Intentionally copyable
+  };
+
+ private:
+  enum { kMaxHeight = 12 };
+
+  inline int GetMaxHeight() const {
+    return max_height_.load(std::memory_order_relaxed);
+  }
+
+  Node* AllocateNode(size_t key_size, int height, bool concurrent);
+  static int RandomHeight(Random* rnd);
+  bool Equal(const char* a, const char* b) const {
+    return (compare_(a, b) == 0);
+  }
+
+  // Return true if key is greater than the data stored in "n"
+  bool KeyIsAfterNode(const char* key, Node* n) const;
+
+  // Return the earliest node that comes at or after key.
+  // Return nullptr if there is no such node.
+  Node* FindGreaterOrEqual(const char* key) const;
+
+  // Starting from "before" (which must come before key), find the nodes
+  // between which key belongs at "level" and store them in *out_prev and
+  // *out_next.
+  void FindSpliceForLevel(const char* key, Node* before, int level,
+                          Node** out_prev, Node** out_next) const;
+
+  // Return the latest node with a key < key.
+  // Return head_ if there is no such node.
+  Node* FindLessThan(const char* key) const;
+
+  // Return the last node in the list.
+  // Return head_ if list is empty.
+  Node* FindLast() const;
+
+  // Immutable after construction
+  Comparator const compare_;
+  Arena* const arena_;  // Arena used for allocations of nodes
+
+  Node* const head_;
+
+  // Modified only by Insert() and InsertConcurrently().  Read racily by
+  // readers, but stale values are ok.
+  std::atomic<int> max_height_;  // Height of the entire list
+
+  // Read/written only by AllocateKey().  AllocateKeyConcurrently() uses a
+  // thread-local generator instead.
+  Random rnd_;
+
+  // Read/written only by Insert().  The splice of the last inserted key,
+  // as in SkipList.
+  Node* splice_prev_[kMaxHeight];
+  Node* splice_next_[kMaxHeight];
+
+  // Cleared by InsertConcurrently(), which does not maintain the splice.
+  std::atomic<bool> splice_valid_;
+};
+
+// Implementation details follow
+template <class Comparator>
+struct InlineSkipList<Comparator>::Node {
+  // The key stored right after the level 0 link.
+  const char* Key() const {
+    return reinterpret_cast<const char*>(&next_[1]);
+  }
+
+  // Return the node whose key is stored at key.
+  static Node* FromKey(const char* key) {
+    return reinterpret_cast<Node*>(const_cast<char*>(key)) - 1;
+  }
+
+  // Between AllocateKey() and Insert(), the level 0 link holds the
+  // height of the node instead.
+  void StashHeight(int height) {
+    next_[0].store(reinterpret_cast<Node*>(static_cast<intptr_t>(height)),
+                   std::memory_order_relaxed);
+  }
+  int UnstashHeight() const {
+    return static_cast<int>(
+        reinterpret_cast<intptr_t>(next_[0].load(std::memory_order_relaxed)));
+  }
+
+  // Accessors/mutators for links.  Wrapped in methods so we can
+  // add the appropriate barriers as necessary.
+  Node* Next(int n) {
+    assert(n >= 0);
+    // Use an 'acquire load' so that we observe a fully initialized
+    // version of the returned Node.
+    return (&next_[0] - n)->load(std::memory_order_acquire);
+  }
+  void SetNext(int n, Node* x) {
+    assert(n >= 0);
+    // Use a 'release store' so that anybody who reads through this
+    // pointer observes a fully initialized version of the inserted node.
+    (&next_[0] - n)->store(x, std::memory_order_release);
+  }
+
+  // No-barrier variants that can be safely used in a few locations.
+  Node* NoBarrier_Next(int n) {
+    assert(n >= 0);
+    return (&next_[0] - n)->load(std::memory_order_relaxed);
+  }
+  void NoBarrier_SetNext(int n, Node* x) {
+    assert(n >= 0);
+    (&next_[0] - n)->store(x, std::memory_order_relaxed);
+  }
+
+  // Atomically replace the link at level n with x if it still points to
+  // expected.  Has release semantics on success, like SetNext().
+  bool CASNext(int n, Node* expected, Node* x) {
+    assert(n >= 0);
+    return (&next_[0] - n)
+        ->compare_exchange_strong(expected, x, std::memory_order_release,
+                                  std::memory_order_relaxed);
+  }
+
+ private:
+  // The level 0 link.  The link at level n is stored n slots before it.
+  std::atomic<Node*> next_[1];
+};
+
+template <class Comparator>
+typename InlineSkipList<Comparator>::Node*
+InlineSkipList<Comparator>::AllocateNode(size_t key_size, int height,
+                                         bool concurrent) {
+  const size_t links_size = sizeof(std::atomic<Node*>) * height;
+  const size_t node_size = links_size + key_size;
+  char* const node_memory = concurrent
+                                ? arena_->AllocateAlignedConcurrently(node_size)
+                                : arena_->AllocateAligned(node_size);
+  for (int i = 0; i < height; i++) {
+    new (node_memory + i * sizeof(std::atomic<Node*>))
+        std::atomic<Node*>(nullptr);
+  }
+  return reinterpret_cast<Node*>(node_memory + links_size -
+                                 sizeof(std::atomic<Node*>));
+}
+
+template <class Comparator>
+char* InlineSkipList<Comparator>::AllocateKey(size_t key_size) {
+  const int height = RandomHeight(&rnd_);
+  Node* x = AllocateNode(key_size, height, false);
+  x->StashHeight(height);
+  return const_cast<char*>(x->Key());
+}
+
+template <class Comparator>
+char* InlineSkipList<Comparator>::AllocateKeyConcurrently(size_t key_size) {
+  // rnd_ belongs to AllocateKey(), so use a generator private to this
+  // thread.
+  static thread_local Random rnd(static_cast<uint32_t>(
+      std::hash<std::thread::id>()(std::this_thread::get_id())));
+  const int height = RandomHeight(&rnd);
+  Node* x = AllocateNode(key_size, height, true);
+  x->StashHeight(height);
+  return const_cast<char*>(x->Key());
+}
+
+template <class Comparator>
+inline InlineSkipList<Comparator>::Iterator::Iterator(
+    const InlineSkipList* list) {
+  list_ = list;
+  node_ = nullptr;
+}
+
+template <class Comparator>
+inline bool InlineSkipList<Comparator>::Iterator::Valid() const {
+  return node_ != nullptr;
+}
+
+template <class Comparator>
+inline const char* InlineSkipList<Comparator>::Iterator::key() const {
+  assert(Valid());
+  return node_->Key();
+}
+
+template <class Comparator>
+inline void InlineSkipList<Comparator>::Iterator::Next() {
+  assert(Valid());
+  node_ = node_->Next(0);
+}
+
+template <class Comparator>
+inline void InlineSkipList<Comparator>::Iterator::Prev() {
+  // Instead of using explicit "prev" links, we just search for the
+  // last node that falls before key.
+  assert(Valid());
+  node_ = list_->FindLessThan(node_->Key());
+  if (node_ == list_->head_) {
+    node_ = nullptr;
+  }
+}
+
+template <class Comparator>
+inline void InlineSkipList<Comparator>::Iterator::Seek(const char* target) {
+  node_ = list_->FindGreaterOrEqual(target);
+}
+
+template <class Comparator>
+inline void InlineSkipList<Comparator>::Iterator::SeekToFirst() {
+  node_ = list_->head_->Next(0);
+}
+
+template <class Comparator>
+inline void InlineSkipList<Comparator>::Iterator::SeekToLast() {
+  node_ = list_->FindLast();
+  if (node_ == list_->head_) {
+    node_ = nullptr;
+  }
+}
+
+template <class Comparator>
+int InlineSkipList<Comparator>::RandomHeight(Random* rnd) {
+  // Increase height with probability 1 in kBranching
+  static const unsigned int kBranching = 4;
+  int height = 1;
+  while (height < kMaxHeight && rnd->OneIn(kBranching)) {
+    height++;
+  }
+  assert(height > 0);
+  assert(height <= kMaxHeight);
+  return height;
+}
+
+template <class Comparator>
+bool InlineSkipList<Comparator>::KeyIsAfterNode(const char* key,
+                                                Node* n) const {
+  // null n is considered infinite
+  return (n != nullptr) && (compare_(n->Key(), key) < 0);
+}
+
+template <class Comparator>
+typename InlineSkipList<Comparator>::Node*
+InlineSkipList<Comparator>::FindGreaterOrEqual(const char* key) const {
+  Node* x = head_;
+  int level = GetMaxHeight() - 1;
+  while (true) {
+    Node* next = x->Next(level);
+    if (next != nullptr) {
+      // Fetch the node that follows next while its key is compared.
+      port::Prefetch(next->Next(level));
+    }
+    if (KeyIsAfterNode(key, next)) {
+      // Keep searching in this list
+      x = next;
+    } else if (level == 0) {
+      return next;
+    } else {
+      // Switch to next list
+      level--;
+    }
+  }
+}
+
+template <class Comparator>
+void InlineSkipList<Comparator>::FindSpliceForLevel(const char* key,
+                                                    Node* before, int level,
+                                                    Node** out_prev,
+                                                    Node** out_next) const {
+  while (true) {
+    Node* next = before->Next(level);
+    if (next != nullptr) {
+      port::Prefetch(next->Next(level));
+    }
+    if (KeyIsAfterNode(key, next)) {
+      before = next;
+    } else {
+      *out_prev = before;
+      *out_next = next;
+      return;
+    }
+  }
+}
+
+template <class Comparator>
+typename InlineSkipList<Comparator>::Node*
+InlineSkipList<Comparator>::FindLessThan(const char* key) const {
+  Node* x = head_;
+  int level = GetMaxHeight() - 1;
+  while (true) {
+    assert(x == head_ || compare_(x->Key(), key) < 0);
+    Node* next = x->Next(level);
+    if (next == nullptr || compare_(next->Key(), key) >= 0) {
+      if (level == 0) {
+        return x;
+      } else {
+        // Switch to next list
+        level--;
+      }
+    } else {
+      x = next;
+    }
+  }
+}
+
+template <class Comparator>
+typename InlineSkipList<Comparator>::Node*
+InlineSkipList<Comparator>::FindLast() const {
+  Node* x = head_;
+  int level = GetMaxHeight() - 1;
+  while (true) {
+    Node* next = x->Next(level);
+    if (next == nullptr) {
+      if (level == 0) {
+        return x;
+      } else {
+        // Switch to next list
+        level--;
+      }
+    } else {
+      x = next;
+    }
+  }
+}
+
+template <class Comparator>
+InlineSkipList<Comparator>::InlineSkipList(Comparator cmp, Arena* arena)
+    : compare_(cmp),
+      arena_(arena),
+      head_(AllocateNode(0, kMaxHeight, false)),
+      max_height_(1),
+      rnd_(0xdeadbeef),
+      splice_valid_(true) {
+  for (int i = 0; i < kMaxHeight; i++) {
+    head_->SetNext(i, nullptr);
+    splice_prev_[i] = head_;
+    splice_next_[i] = nullptr;
+  }
+}
+
+template <class Comparator>
+void InlineSkipList<Comparator>::Insert(const char* key) {
+  Node* const x = Node::FromKey(key);
+  const int height = x->UnstashHeight();
+
+  Node** const prev = splice_prev_;
+  Node** const next = splice_next_;
+  int level = 0;
+  if (!splice_valid_.load(std::memory_order_relaxed)) {
+    // Search from the top.
+    level = kMaxHeight;
+    splice_valid_.store(true, std::memory_order_relaxed);
+  }
+
+  // Find the lowest level of the previous splice that still brackets
+  // key, as in SkipList::Insert().
+  while (level < kMaxHeight) {
+    if (prev[level] != head_ && !KeyIsAfterNode(key, prev[level])) {
+      level = kMaxHeight;
+    } else if (KeyIsAfterNode(key, next[level])) {
+      level++;
+    } else {
+      break;
+    }
+  }
+
+  // Recompute the splice below that level.  Levels at or above the
+  // height of the list are empty, so their splice is always head_ and
+  // nullptr.
+  level = std::min(level, GetMaxHeight());
+  for (int i = level - 1; i >= 0; i--) {
+    Node* before = (i + 1 < kMaxHeight) ? prev[i + 1] : head_;
+    FindSpliceForLevel(key, before, i, &prev[i], &next[i]);
+  }
+
+  // Our data structure does not allow duplicate insertion
+  assert(next[0] == nullptr || !Equal(key, next[0]->Key()));
+
+  if (height > GetMaxHeight()) {
+    // It is ok to mutate max_height_ without any synchronization
+    // with concurrent readers (see SkipList::Insert()).
+    max_height_.store(height, std::memory_order_relaxed);
+  }
+
+  for (int i = 0; i < height; i++) {
+    // NoBarrier_SetNext() suffices since we will add a barrier when
+    // we publish a pointer to "x" in prev[i].
+    x->NoBarrier_SetNext(i, next[i]);
+    prev[i]->SetNext(i, x);
+    prev[i] = x;
+  }
+}
+
+template <class Comparator>
+void InlineSkipList<Comparator>::InsertConcurrently(const char* key) {
+  splice_valid_.store(false, std::memory_order_relaxed);
+
+  Node* const x = Node::FromKey(key);
+  const int height = x->UnstashHeight();
+
+  // Raise max_height_ first so that the search below visits every level
+  // we are going to link into.
+  int max_height = GetMaxHeight();
+  while (height > max_height &&
+         !max_height_.compare_exchange_weak(max_height, height,
+                                            std::memory_order_relaxed)) {
+  }
+
+  Node* prev[kMaxHeight];
+  Node* next[kMaxHeight];
+  Node* before = head_;
+  for (int i = GetMaxHeight() - 1; i >= 0; i--) {
+    FindSpliceForLevel(key, before, i, &prev[i], &next[i]);
+    before = prev[i];
+  }
+
+  // Our data structure does not allow duplicate insertion
+  assert(next[0] == nullptr || !Equal(key, next[0]->Key()));
+
+  for (int i = 0; i < height; i++) {
+    // Link bottom-up.  If another writer changed the splice at this level
+    // since we computed it, the CAS fails and we search again starting
+    // from prev[i], which still precedes key.
+    while (true) {
+      x->NoBarrier_SetNext(i, next[i]);
+      if (prev[i]->CASNext(i, next[i], x)) {
+        break;
+      }
+      FindSpliceForLevel(key, prev[i], i, &prev[i], &next[i]);
+    }
+  }
+}
+
+template <class Comparator>
+bool InlineSkipList<Comparator>::Contains(const char* key) const {
+  Node* x = FindGreaterOrEqual(key);
+  if (x != nullptr && Equal(key, x->Key())) {
+    return true;
+  } else {
+    return false;
+  }
+}
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_INLINE_SKIPLIST_H_
@@ -0,0 +1,171 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/inline_skiplist.h"
+
+#include <set>
+
+#include "gtest/gtest.h"
+#include "util/arena.h"
+#include "util/coding.h"
+#include "util/random.h"
+#include "util/testutil.h"
+
+namespace leveldb {
+
+typedef uint64_t Key;
+
+// Keys are stored in the list as 8 fixed-width bytes.
+static Key Decode(const char* key) { return DecodeFixed64(key); }
+
+struct TestComparator {
+  int operator()(const char* a, const char* b) const {
+    const Key ka = Decode(a);
+    const Key kb = Decode(b);
+    if (ka < kb) {
+      return -1;
+    } else if (ka > kb) {
+      return +1;
+    } else {
+      return 0;
+    }
+  }
+};
+
+typedef InlineSkipList<TestComparator> TestList;
+
+static void Insert(TestList* list, Key key) {
+  char* buf = list->AllocateKey(sizeof(Key));
+  EncodeFixed64(buf, key);
+  list->Insert(buf);
+}
+
+static bool Contains(const TestList& list, Key key) {
+  char buf[sizeof(Key)];
+  EncodeFixed64(buf, key);
+  return list.Contains(buf);
+}
+
+// Checks that list holds exactly the keys of model, using both the
+// lowest level (iteration) and the upper levels (Seek).
+static void CheckContents(const TestList& list, const std::set<Key>& model) {
+  TestList::Iterator iter(&list);
+  iter.SeekToFirst();
+  for (Key k : model) {
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(k, Decode(iter.key()));
+    iter.Next();
+  }
+  ASSERT_TRUE(!iter.Valid());
+
+  iter.SeekToLast();
+  for (auto it = model.rbegin(); it != model.rend(); ++it) {
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(*it, Decode(iter.key()));
+    iter.Prev();
+  }
+  ASSERT_TRUE(!iter.Valid());
+
+  char buf[sizeof(Key)];
+  for (Key k : model) {
+    EncodeFixed64(buf, k);
+    iter.Seek(buf);
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(k, Decode(iter.key()));
+    ASSERT_TRUE(Contains(list, k));
+    ASSERT_EQ(model.count(k + 1), Contains(list, k + 1) ? 1 : 0);
+  }
+}
+
+TEST(InlineSkipTest, Empty) {
+  Arena arena;
+  TestList list(TestComparator(), &arena);
+  ASSERT_TRUE(!Contains(list, 10));
+
+  TestList::Iterator iter(&list);
+  ASSERT_TRUE(!iter.Valid());
+  iter.SeekToFirst();
+  ASSERT_TRUE(!iter.Valid());
+  char buf[sizeof(Key)];
+  EncodeFixed64(buf, 100);
+  iter.Seek(buf);
+  ASSERT_TRUE(!iter.Valid());
+  iter.SeekToLast();
+  ASSERT_TRUE(!iter.Valid());
+}
+
+TEST(InlineSkipTest, InsertAndLookup) {
+  const int N = 2000;
+  const int R = 5000;
+  Random rnd(1000);
+  std::set<Key> model;
+  Arena arena;
+  TestList list(TestComparator(), &arena);
+  for (int i = 0; i < N; i++) {
+    Key key = rnd.Next() % R;
+    if (model.insert(key).second) {
+      Insert(&list, key);
+    }
+  }
+  CheckContents(list, model);
+}
+
+TEST(InlineSkipTest, InsertPatterns) {
+  Arena arena;
+  TestList list(TestComparator(), &arena);
+  std::set<Key> model;
+  auto insert = [&](Key key) {
+    if (model.insert(key).second) {
+      Insert(&list, key);
+    }
+  };
+
+  // Increasing, decreasing, interleaved and gap-filling sequences.
+  for (Key k = 1000; k < 3000; k += 2) insert(k);
+  for (int k = 999; k > 0; k -= 2) insert(k);
+  for (Key k = 0; k < 1000; k++) {
+    insert(10000 + 2 * k);
+    insert(20000 + 2 * k);
+  }
+  for (Key k = 1001; k < 3000; k += 2) insert(k);
+  Random rnd(301);
+  for (int i = 0; i < 2000; i++) insert(rnd.Uniform(30000));
+  CheckContents(list, model);
+}
+
+// Several threads calling InsertConcurrently() on the same list.
+static const int kInsertThreads = 4;
+static const int kKeysPerInsertThread = 20000;
+
+static void ConcurrentInserter(void* arg, int id) {
+  TestList* list = reinterpret_cast<TestList*>(arg);
+  // Interleave the keys of all threads so that their splices collide.
+  for (int i = 0; i < kKeysPerInsertThread; i++) {
+    char* buf = list->AllocateKeyConcurrently(sizeof(Key));
+    EncodeFixed64(buf, static_cast<Key>(i) * kInsertThreads + id);
+    list->InsertConcurrently(buf);
+  }
+}
+
+TEST(InlineSkipTest, InsertConcurrently) {
+  Arena arena;
+  TestList list(TestComparator(), &arena);
+  test::RunConcurrently(kInsertThreads, ConcurrentInserter, &list);
+
+  std::set<Key> model;
+  const Key total = static_cast<Key>(kInsertThreads) * kKeysPerInsertThread;
+  for (Key k = 0; k < total; k++) {
+    model.insert(k);
+  }
+  CheckContents(list, model);
+
+  // Inserts after concurrent inserts do not trust the old splice.
+  for (Key k = total + 10; k > total; k--) {
+    model.insert(k);
+    Insert(&list, k);
+  }
+  CheckContents(list, model);
+}
+
+}  // namespace leveldb
@@ -20,15 +20,37 @@ enum RecordType {
   // For fragments
   kFirstType = 2,
   kMiddleType = 3,
-  kLastType = 4
+  kLastType = 4,
+
+  // For logs written to recycled files.  These records also carry the
+  // number of the log they belong to, so stale records left behind by
+  // the file's previous use can be told apart from new ones.
+  kRecyclableFullType = 5,
+  kRecyclableFirstType = 6,
+  kRecyclableMiddleType = 7,
+  kRecyclableLastType = 8,
+
+  // Sets the compression type for the payload of all following records.
+  kSetCompressionType = 9,
+  kRecyclableSetCompressionType = 10
 };
-static const int kMaxRecordType = kLastType;
+static const int kMaxRecordType = kRecyclableSetCompressionType;
+
+// Returns true iff records of the given type carry a log number.
+inline bool IsRecyclableType(unsigned int type) {
+  return (type >= kRecyclableFullType && type <= kRecyclableLastType) ||
+         type == kRecyclableSetCompressionType;
+}
 
 static const int kBlockSize = 32768;
 
 // Header is checksum (4 bytes), length (2 bytes), type (1 byte).
 static const int kHeaderSize = 4 + 2 + 1;
 
+// Recyclable header is checksum (4 bytes), length (2 bytes), type (1 byte),
+// log number (4 bytes).
+static const int kRecyclableHeaderSize = 4 + 2 + 1 + 4;
+
 }  // namespace log
 }  // namespace leveldb
 
@@ -7,6 +7,7 @@
 #include <cstdio>
 
 #include "leveldb/env.h"
+#include "port/port.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
 
@@ -16,7 +17,7 @@ namespace log {
 Reader::Reporter::~Reporter() = default;
 
 Reader::Reader(SequentialFile* file, Reporter* reporter, bool checksum,
-               uint64_t initial_offset)
+               uint64_t initial_offset, uint64_t log_number)
     : file_(file),
       reporter_(reporter),
       checksum_(checksum),
@@ -26,7 +27,12 @@ Reader::Reader(SequentialFile* file, Reporter* reporter, bool checksum,
       last_record_offset_(0),
       end_of_buffer_offset_(0),
       initial_offset_(initial_offset),
-      resyncing_(initial_offset > 0) {}
+      resyncing_(initial_offset > 0),
+      log_number_(log_number),
+      recycled_(false),
+      stale_data_(false),
+      suspect_bytes_(0),
+      compression_type_(kNoCompression) {}
 
 Reader::~Reader() { delete[] backing_store_; }
 
@@ -41,9 +47,15 @@ bool Reader::SkipToInitialBlock() {
 
   end_of_buffer_offset_ = block_start_location;
 
-  // Skip to start of first block that can contain the initial record
+  // Skip to start of first block that can contain the initial record.  The
+  // first record of the log is read on the way, since it sets the
+  // compression type of the records that follow.
   if (block_start_location > 0) {
-    Status skip_status = file_->Skip(block_start_location);
+    uint64_t header_bytes = 0;
+    Status skip_status = ReadCompressionTypeRecord(&header_bytes);
+    if (skip_status.ok()) {
+      skip_status = file_->Skip(block_start_location - header_bytes);
+    }
     if (!skip_status.ok()) {
       ReportDrop(block_start_location, skip_status);
       return false;
@@ -74,8 +86,9 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
     // ReadPhysicalRecord may have only had an empty trailer remaining in its
     // internal buffer. Calculate the offset of the next physical record now
     // that it has returned, properly accounting for its header size.
+    const int header_size = recycled_ ? kRecyclableHeaderSize : kHeaderSize;
     uint64_t physical_record_offset =
-        end_of_buffer_offset_ - buffer_.size() - kHeaderSize - fragment.size();
+        end_of_buffer_offset_ - buffer_.size() - header_size - fragment.size();
 
     if (resyncing_) {
       if (record_type == kMiddleType) {
@@ -102,6 +115,10 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
         prospective_record_offset = physical_record_offset;
         scratch->clear();
         *record = fragment;
+        if (!DecompressRecord(record)) {
+          ReportCorruption(fragment.size(), "corrupted compressed record");
+          break;
+        }
         last_record_offset_ = prospective_record_offset;
         return true;
 
@@ -136,12 +153,36 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
         } else {
           scratch->append(fragment.data(), fragment.size());
           *record = Slice(*scratch);
+          in_fragmented_record = false;
+          if (!DecompressRecord(record)) {
+            ReportCorruption(scratch->size(), "corrupted compressed record");
+            scratch->clear();
+            break;
+          }
           last_record_offset_ = prospective_record_offset;
           return true;
         }
         break;
 
+      case kSetCompressionType:
+        if (in_fragmented_record) {
+          ReportCorruption(scratch->size(), "partial record without end(3)");
+          in_fragmented_record = false;
+          scratch->clear();
+        }
+        if (compression_type_ != kNoCompression || fragment.size() != 1) {
+          ReportCorruption(fragment.size(), "bad compression type record");
+        } else {
+          compression_type_ = static_cast<CompressionType>(fragment[0]);
+        }
+        break;
+
       case kEof:
+        if (suspect_bytes_ > 0) {
+          // Nothing of this log followed the bytes dropped last, so they
+          // were left behind by the previous use of a recycled log file.
+          stale_data_ = true;
+        }
         if (in_fragmented_record) {
           // This can be caused by the writer dying immediately after
           // writing a physical record but before completing the next; don't
@@ -152,7 +193,11 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
 
       case kBadRecord:
         if (in_fragmented_record) {
-          ReportCorruption(scratch->size(), "error in middle of record");
+          if (suspect_bytes_ > 0) {
+            suspect_bytes_ += scratch->size();
+          } else {
+            ReportCorruption(scratch->size(), "error in middle of record");
+          }
           in_fragmented_record = false;
           scratch->clear();
         }
@@ -175,6 +220,92 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
 
 uint64_t Reader::LastRecordOffset() { return last_record_offset_; }
 
+Status Reader::ReadCompressionTypeRecord(uint64_t* bytes_read) {
+  char buf[kRecyclableHeaderSize + 1];
+  Slice record;
+  Status s = file_->Read(sizeof(buf), &record, buf);
+  *bytes_read = record.size();
+  if (!s.ok() || record.size() < kHeaderSize + 1) {
+    return s;
+  }
+  const char* header = record.data();
+  const unsigned int type = header[6];
+  if (type == kSetCompressionType) {
+    if (header[4] == 1 && header[5] == 0 &&
+        (!checksum_ || crc32c::Unmask(DecodeFixed32(header)) ==
+                           crc32c::Value(header + 6, 2))) {
+      SetSkippedCompressionType(Slice(header + kHeaderSize, 1));
+    }
+  } else if (type == kRecyclableSetCompressionType) {
+    if (IsRecordOfThisLog(header, record.size())) {
+      SetSkippedCompressionType(Slice(header + kRecyclableHeaderSize, 1));
+    }
+  }
+  return s;
+}
+
+void Reader::SetSkippedCompressionType(const Slice& payload) {
+  // Corrupted type records are reported once the records they apply to
+  // fail to decompress.
+  if (compression_type_ == kNoCompression && payload.size() == 1) {
+    compression_type_ = static_cast<CompressionType>(payload[0]);
+  }
+}
+
+bool Reader::IsRecordOfThisLog(const char* p, size_t n) const {
+  if (n < kRecyclableHeaderSize || !IsRecyclableType(p[6])) {
+    return false;
+  }
+  const uint32_t length = (static_cast<uint32_t>(p[4]) & 0xff) |
+                          ((static_cast<uint32_t>(p[5]) & 0xff) << 8);
+  if (kRecyclableHeaderSize + length > n ||
+      DecodeFixed32(p + kHeaderSize) != static_cast<uint32_t>(log_number_)) {
+    return false;
+  }
+  return crc32c::Unmask(DecodeFixed32(p)) ==
+         crc32c::Value(p + 6, kRecyclableHeaderSize - 6 + length);
+}
+
+bool Reader::DecompressRecord(Slice* record) {
+  if (compression_type_ == kNoCompression) {
+    return true;
+  }
+  // Each record starts with the compression type used for it.
+  if (record->empty()) {
+    return false;
+  }
+  const char* data = record->data() + 1;
+  const size_t n = record->size() - 1;
+  size_t ulength = 0;
+  switch (static_cast<CompressionType>((*record)[0])) {
+    case kNoCompression:
+      *record = Slice(data, n);
+      return true;
+    case kSnappyCompression:
+      if (!port::Snappy_GetUncompressedLength(data, n, &ulength)) {
+        return false;
+      }
+      uncompressed_.resize(ulength);
+      if (!port::Snappy_Uncompress(data, n, &uncompressed_[0])) {
+        return false;
+      }
+      break;
+    case kZstdCompression:
+      if (!port::Zstd_GetUncompressedLength(data, n, &ulength)) {
+        return false;
+      }
+      uncompressed_.resize(ulength);
+      if (!port::Zstd_Uncompress(data, n, &uncompressed_[0])) {
+        return false;
+      }
+      break;
+    default:
+      return false;
+  }
+  *record = Slice(uncompressed_);
+  return true;
+}
+
 void Reader::ReportCorruption(uint64_t bytes, const char* reason) {
   ReportDrop(bytes, Status::Corruption(reason));
 }
@@ -219,10 +350,26 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
     const uint32_t b = static_cast<uint32_t>(header[5]) & 0xff;
     const unsigned int type = header[6];
     const uint32_t length = a | (b << 8);
-    if (kHeaderSize + length > buffer_.size()) {
+    const bool recyclable = IsRecyclableType(type);
+    const int header_size = recyclable ? kRecyclableHeaderSize : kHeaderSize;
+    if (recycled_ && !recyclable && type != kZeroType) {
+      // A legacy record after recyclable ones is left over from an older
+      // use of this file.
+      buffer_.clear();
+      eof_ = true;
+      stale_data_ = true;
+      return kEof;
+    }
+    if (header_size + length > buffer_.size()) {
       size_t drop_size = buffer_.size();
       buffer_.clear();
       if (!eof_) {
+        if (recycled_) {
+          // Either stale bytes from the previous use of a recycled log
+          // file or a corrupted record, depending on what follows.
+          suspect_bytes_ += drop_size;
+          return kBadRecord;
+        }
         ReportCorruption(drop_size, "bad record length");
         return kBadRecord;
       }
@@ -243,8 +390,23 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
     // Check crc
     if (checksum_) {
       uint32_t expected_crc = crc32c::Unmask(DecodeFixed32(header));
-      uint32_t actual_crc = crc32c::Value(header + 6, 1 + length);
+      uint32_t actual_crc = crc32c::Value(header + 6, header_size - 6 + length);
       if (actual_crc != expected_crc) {
+        if (recycled_) {
+          // The tail of a recycled log holds stale bytes from the file's
+          // previous use, which usually fail the checksum.  A corrupted
+          // record is instead followed by more of this log.
+          const size_t record_size = header_size + length;
+          if (IsRecordOfThisLog(header + record_size,
+                                buffer_.size() - record_size)) {
+            ReportCorruption(record_size, "checksum mismatch");
+            buffer_.remove_prefix(record_size);
+            return kBadRecord;
+          }
+          suspect_bytes_ += buffer_.size();
+          buffer_.clear();
+          return kBadRecord;
+        }
         // Drop the rest of the buffer since "length" itself may have
         // been corrupted and if we trust it, we could find some
         // fragment of a real log record that just happens to look
@@ -256,16 +418,43 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
       }
     }
 
-    buffer_.remove_prefix(kHeaderSize + length);
+    if (recyclable) {
+      const uint32_t log_number = DecodeFixed32(header + kHeaderSize);
+      if (log_number != static_cast<uint32_t>(log_number_)) {
+        // A valid record written before this file was recycled.
+        buffer_.clear();
+        eof_ = true;
+        stale_data_ = true;
+        return kEof;
+      }
+      recycled_ = true;
+      if (suspect_bytes_ > 0) {
+        ReportCorruption(suspect_bytes_, "corrupted record in recycled log");
+        suspect_bytes_ = 0;
+      }
+    }
+
+    buffer_.remove_prefix(header_size + length);
 
     // Skip physical record that started before initial_offset_
-    if (end_of_buffer_offset_ - buffer_.size() - kHeaderSize - length <
+    if (end_of_buffer_offset_ - buffer_.size() - header_size - length <
         initial_offset_) {
+      if (type == kSetCompressionType ||
+          type == kRecyclableSetCompressionType) {
+        SetSkippedCompressionType(Slice(header + header_size, length));
+      }
       result->clear();
       return kBadRecord;
     }
 
-    *result = Slice(header + kHeaderSize, length);
+    *result = Slice(header + header_size, length);
+    if (recyclable) {
+      // Report the type the record would have in a regular log.
+      if (type == kRecyclableSetCompressionType) {
+        return kSetCompressionType;
+      }
+      return type - kRecyclableFullType + kFullType;
+    }
     return type;
   }
 }
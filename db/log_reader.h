@@ -8,6 +8,7 @@
 #include <cstdint>
 
 #include "db/log_format.h"
+#include "leveldb/options.h"
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
 
@@ -40,8 +41,12 @@ class Reader {
   //
   // The Reader will start reading at the first record located at physical
   // position >= initial_offset within the file.
+  //
+  // "log_number" is the number of the log being read.  Records written
+  // to a recycled log file that carry a different log number are left
+  // over from the file's previous use and end the log.
   Reader(SequentialFile* file, Reporter* reporter, bool checksum,
-         uint64_t initial_offset);
+         uint64_t initial_offset, uint64_t log_number);
 
   Reader(const Reader&) = delete;
   Reader& operator=(const Reader&) = delete;
@@ -60,6 +65,17 @@ class Reader {
   // Undefined before the first call to ReadRecord.
   uint64_t LastRecordOffset();
 
+  // Returns true if reading stopped at stale data left behind in a
+  // recycled log file by its previous use.
+  bool ReachedStaleData() const { return stale_data_; }
+
+  // Returns true if the records read so far were written in the
+  // recyclable format.
+  bool ReadRecyclableRecords() const { return recycled_; }
+
+  // Returns the compression type of the records read so far.
+  CompressionType compression_type() const { return compression_type_; }
+
  private:
   // Extend record types with the following special values
   enum {
@@ -77,9 +93,26 @@ class Reader {
   // Returns true on success. Handles reporting.
   bool SkipToInitialBlock();
 
+  // Reads the first record of the log, which sets the compression type of
+  // a compressed log, from the start of the file and sets "*bytes_read"
+  // to the number of bytes consumed.
+  Status ReadCompressionTypeRecord(uint64_t* bytes_read);
+
+  // Sets the compression type of the log from the payload of a record
+  // that is skipped because it lies before "initial_offset_".
+  void SetSkippedCompressionType(const Slice& payload);
+
   // Return type, or one of the preceding special values
   unsigned int ReadPhysicalRecord(Slice* result);
 
+  // Returns true if the "n" bytes at "p" start with a valid recyclable
+  // record of this log.
+  bool IsRecordOfThisLog(const char* p, size_t n) const;
+
+  // If the log is compressed, replace *record with its uncompressed
+  // contents.  Returns false if the record cannot be decompressed.
+  bool DecompressRecord(Slice* record);
+
   // Reports dropped bytes to the reporter.
   // buffer_ must be updated to remove the dropped bytes prior to invocation.
   void ReportCorruption(uint64_t bytes, const char* reason);
@@ -104,6 +137,23 @@ class Reader {
   // particular, a run of kMiddleType and kLastType records can be silently
   // skipped in this mode
   bool resyncing_;
+
+  const uint64_t log_number_;
+
+  // True once a record in the recyclable format has been read.  From then
+  // on, anything that does not look like a valid recyclable record of
+  // this log is assumed to be stale data and treated as the end of the log.
+  bool recycled_;
+
+  bool stale_data_;
+
+  // Bytes of a recycled log dropped since the last valid record.  They are
+  // reported as corruption if more of this log follows them, and are
+  // otherwise the stale tail of the file.
+  uint64_t suspect_bytes_;
+
+  CompressionType compression_type_;
+  std::string uncompressed_;  // Holds the last decompressed record
 };
 
 }  // namespace log
@@ -42,7 +42,7 @@ class LogTest : public testing::Test {
       : reading_(false),
         writer_(new Writer(&dest_)),
         reader_(new Reader(&source_, &report_, true /*checksum*/,
-                           0 /*initial_offset*/)) {}
+                           0 /*initial_offset*/, 0 /*log_number*/)) {}
 
   ~LogTest() {
     delete writer_;
@@ -54,6 +54,22 @@ class LogTest : public testing::Test {
     writer_ = new Writer(&dest_, dest_.contents_.size());
   }
 
+  // Start overwriting the log written so far from the beginning, as if
+  // the file had been recycled for log "log_number".
+  void RecycleLog(uint64_t log_number) {
+    delete writer_;
+    delete reader_;
+    stale_contents_ = dest_.contents_;
+    dest_.contents_.clear();
+    writer_ = new Writer(&dest_, log_number, true /*recycle_log_file*/);
+    reader_ = new Reader(&source_, &report_, true /*checksum*/,
+                         0 /*initial_offset*/, log_number);
+  }
+
+  Status AddCompressionTypeRecord(CompressionType type) {
+    return writer_->AddCompressionTypeRecord(type, /*zstd_level=*/1);
+  }
+
   void Write(const std::string& msg) {
     ASSERT_TRUE(!reading_) << "Write() after starting to read";
     writer_->AddRecord(Slice(msg));
@@ -64,6 +80,11 @@ class LogTest : public testing::Test {
   std::string Read() {
     if (!reading_) {
       reading_ = true;
+      if (dest_.contents_.size() < stale_contents_.size()) {
+        // Bytes past the last write keep their old values.
+        dest_.contents_.append(stale_contents_, dest_.contents_.size(),
+                               std::string::npos);
+      }
       source_.contents_ = Slice(dest_.contents_);
     }
     std::string scratch;
@@ -119,15 +140,17 @@ class LogTest : public testing::Test {
 
   void StartReadingAt(uint64_t initial_offset) {
     delete reader_;
-    reader_ = new Reader(&source_, &report_, true /*checksum*/, initial_offset);
+    reader_ = new Reader(&source_, &report_, true /*checksum*/, initial_offset,
+                         0 /*log_number*/);
   }
 
   void CheckOffsetPastEndReturnsNoRecords(uint64_t offset_past_end) {
     WriteInitialOffsetLog();
     reading_ = true;
     source_.contents_ = Slice(dest_.contents_);
-    Reader* offset_reader = new Reader(&source_, &report_, true /*checksum*/,
-                                       WrittenBytes() + offset_past_end);
+    Reader* offset_reader =
+        new Reader(&source_, &report_, true /*checksum*/,
+                   WrittenBytes() + offset_past_end, 0 /*log_number*/);
     Slice record;
     std::string scratch;
     ASSERT_TRUE(!offset_reader->ReadRecord(&record, &scratch));
@@ -139,8 +162,8 @@ class LogTest : public testing::Test {
     WriteInitialOffsetLog();
     reading_ = true;
     source_.contents_ = Slice(dest_.contents_);
-    Reader* offset_reader =
-        new Reader(&source_, &report_, true /*checksum*/, initial_offset);
+    Reader* offset_reader = new Reader(&source_, &report_, true /*checksum*/,
+                                       initial_offset, 0 /*log_number*/);
 
     // Read all records from expected_record_offset through the last one.
     ASSERT_LT(expected_record_offset, num_initial_offset_records_);
@@ -228,6 +251,7 @@ class LogTest : public testing::Test {
   static int num_initial_offset_records_;
 
   StringDest dest_;
+  std::string stale_contents_;  // Contents of the file before RecycleLog()
   StringSource source_;
   ReportCollector report_;
   bool reading_;
@@ -550,6 +574,210 @@ TEST_F(LogTest, ReadInitialOffsetIntoBlockPadding) {
   CheckInitialOffsetRecord(3 * log::kBlockSize - 3, 5);
 }
 
+TEST_F(LogTest, Recycled) {
+  RecycleLog(7);
+  Write("foo");
+  Write(BigString("large", 100000));
+  Write("");
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ(BigString("large", 100000), Read());
+  ASSERT_EQ("", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecycledStaleTail) {
+  RecycleLog(7);
+  for (int i = 0; i < 1000; i++) {
+    Write(NumberString(i));
+  }
+  RecycleLog(8);
+  Write("foo");
+  Write("bar");
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ("bar", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+  ASSERT_EQ("", ReportMessage());
+}
+
+TEST_F(LogTest, RecycledMisalignedStaleTail) {
+  RecycleLog(7);
+  Write(BigString("old", 3 * kBlockSize));
+  RecycleLog(8);
+  Write("foo");
+  Write(BigString("bar", kBlockSize));
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ(BigString("bar", kBlockSize), Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecycledCorruptedRecord) {
+  RecycleLog(7);
+  for (int i = 0; i < 1000; i++) {
+    Write(NumberString(i));
+  }
+  RecycleLog(8);
+  Write("foo");
+  Write("bar");
+  Write("baz");
+  IncrementByte(2 * kRecyclableHeaderSize + 3 + 1, 1);  // Corrupt "bar"
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ("baz", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(kRecyclableHeaderSize + 3, DroppedBytes());
+  ASSERT_EQ("OK", MatchError("checksum mismatch"));
+}
+
+TEST_F(LogTest, RecycledCorruptedBlock) {
+  RecycleLog(7);
+  for (int i = 0; i < 1000; i++) {
+    Write(NumberString(i));
+  }
+  RecycleLog(8);
+  // Fill the first block, then start the second one.
+  Write("foo");
+  Write("bar");
+  Write(std::string(kBlockSize - 3 * kRecyclableHeaderSize - 6, 'x'));
+  Write("baz");
+  // Make the length of "bar" run past the block.
+  SetByte(kRecyclableHeaderSize + 3 + 5, 0xff);
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ("baz", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(kBlockSize - kRecyclableHeaderSize - 3, DroppedBytes());
+  ASSERT_EQ("OK", MatchError("corrupted record in recycled log"));
+}
+
+TEST_F(LogTest, RecycledCorruptedTail) {
+  RecycleLog(7);
+  for (int i = 0; i < 1000; i++) {
+    Write(NumberString(i));
+  }
+  RecycleLog(8);
+  Write("foo");
+  Write("bar");
+  IncrementByte(kRecyclableHeaderSize + 3 + kRecyclableHeaderSize, 1);
+  // The last record cannot be told apart from stale data.
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecycledLegacyTail) {
+  for (int i = 0; i < 1000; i++) {
+    Write(NumberString(i));
+  }
+  RecycleLog(8);
+  Write("foo");
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecycledEmpty) {
+  RecycleLog(7);
+  Write("foo");
+  RecycleLog(8);
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, CompressionTypeRecordOnlyIfSupported) {
+  ASSERT_TRUE(AddCompressionTypeRecord(kSnappyCompression).ok());
+  if (CompressionSupported(kSnappyCompression, /*zstd_level=*/1)) {
+    ASSERT_EQ(kHeaderSize + 1, WrittenBytes());
+  } else {
+    ASSERT_EQ(0, WrittenBytes());
+  }
+  Write("foo");
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ("EOF", Read());
+}
+
+class CompressedLogTest : public LogTest,
+                          public testing::WithParamInterface<CompressionType> {
+};
+
+INSTANTIATE_TEST_SUITE_P(CompressionTests, CompressedLogTest,
+                         testing::Values(kSnappyCompression, kZstdCompression));
+
+TEST_P(CompressedLogTest, ReadWrite) {
+  if (!CompressionSupported(GetParam(), /*zstd_level=*/1)) {
+    GTEST_SKIP() << "skipping compression test: " << GetParam();
+  }
+  ASSERT_TRUE(AddCompressionTypeRecord(GetParam()).ok());
+  Write("foo");
+  Write("");
+  Write(BigString("compressible", 100000));
+  Random rnd(301);
+  std::string incompressible;
+  for (int i = 0; i < 10000; i++) {
+    incompressible.push_back(static_cast<char>(rnd.Uniform(256)));
+  }
+  Write(incompressible);
+  // The compressible record shrinks to well below its size.
+  ASSERT_LT(WrittenBytes(), 3 + 10000 + 100000 / 2);
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ("", Read());
+  ASSERT_EQ(BigString("compressible", 100000), Read());
+  ASSERT_EQ(incompressible, Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_P(CompressedLogTest, Recycled) {
+  if (!CompressionSupported(GetParam(), /*zstd_level=*/1)) {
+    GTEST_SKIP() << "skipping compression test: " << GetParam();
+  }
+  RecycleLog(7);
+  ASSERT_TRUE(AddCompressionTypeRecord(GetParam()).ok());
+  for (int i = 0; i < 1000; i++) {
+    Write(BigString(NumberString(i), 1000));
+  }
+  RecycleLog(8);
+  ASSERT_TRUE(AddCompressionTypeRecord(GetParam()).ok());
+  Write(BigString("foo", 1000));
+  ASSERT_EQ(BigString("foo", 1000), Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_P(CompressedLogTest, ReadFromInitialOffsetInFirstBlock) {
+  if (!CompressionSupported(GetParam(), /*zstd_level=*/1)) {
+    GTEST_SKIP() << "skipping compression test: " << GetParam();
+  }
+  ASSERT_TRUE(AddCompressionTypeRecord(GetParam()).ok());
+  Write(BigString("foo", 1000));
+  const uint64_t offset = WrittenBytes();
+  Write(BigString("bar", 1000));
+  StartReadingAt(offset);
+  ASSERT_EQ(BigString("bar", 1000), Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_P(CompressedLogTest, ReadFromInitialOffsetInLaterBlock) {
+  if (!CompressionSupported(GetParam(), /*zstd_level=*/1)) {
+    GTEST_SKIP() << "skipping compression test: " << GetParam();
+  }
+  ASSERT_TRUE(AddCompressionTypeRecord(GetParam()).ok());
+  Random rnd(301);
+  std::string incompressible;
+  for (int i = 0; i < 2 * kBlockSize; i++) {
+    incompressible.push_back(static_cast<char>(rnd.Uniform(256)));
+  }
+  Write(incompressible);
+  const uint64_t offset = WrittenBytes();
+  ASSERT_GT(offset, kBlockSize);
+  Write(BigString("bar", 1000));
+  StartReadingAt(offset);
+  ASSERT_EQ(BigString("bar", 1000), Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
 TEST_F(LogTest, ReadEnd) { CheckOffsetPastEndReturnsNoRecords(0); }
 
 TEST_F(LogTest, ReadPastEnd) { CheckOffsetPastEndReturnsNoRecords(5); }
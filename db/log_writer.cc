@@ -7,6 +7,7 @@
 #include <cstdint>
 
 #include "leveldb/env.h"
+#include "port/port.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
 
@@ -20,55 +21,96 @@ static void InitTypeCrc(uint32_t* type_crc) {
   }
 }
 
-Writer::Writer(WritableFile* dest) : dest_(dest), block_offset_(0) {
+Writer::Writer(WritableFile* dest)
+    : dest_(dest),
+      block_offset_(0),
+      log_number_(0),
+      recycle_log_file_(false),
+      compression_type_(kNoCompression),
+      zstd_level_(0) {
   InitTypeCrc(type_crc_);
 }
 
 Writer::Writer(WritableFile* dest, uint64_t dest_length)
-    : dest_(dest), block_offset_(dest_length % kBlockSize) {
+    : dest_(dest),
+      block_offset_(dest_length % kBlockSize),
+      log_number_(0),
+      recycle_log_file_(false),
+      compression_type_(kNoCompression),
+      zstd_level_(0) {
+  InitTypeCrc(type_crc_);
+}
+
+Writer::Writer(WritableFile* dest, uint64_t log_number, bool recycle_log_file)
+    : dest_(dest),
+      block_offset_(0),
+      log_number_(log_number),
+      recycle_log_file_(recycle_log_file),
+      compression_type_(kNoCompression),
+      zstd_level_(0) {
+  InitTypeCrc(type_crc_);
+}
+
+Writer::Writer(WritableFile* dest, uint64_t dest_length, uint64_t log_number,
+               bool recycle_log_file)
+    : dest_(dest),
+      block_offset_(dest_length % kBlockSize),
+      log_number_(log_number),
+      recycle_log_file_(recycle_log_file),
+      compression_type_(kNoCompression),
+      zstd_level_(0) {
   InitTypeCrc(type_crc_);
 }
 
 Writer::~Writer() = default;
 
 Status Writer::AddRecord(const Slice& slice) {
-  const char* ptr = slice.data();
-  size_t left = slice.size();
+  Slice record = slice;
+  if (compression_type_ != kNoCompression) {
+    CompressRecord(slice);
+    record = Slice(compressed_);
+  }
+  const char* ptr = record.data();
+  size_t left = record.size();
 
   // Fragment the record if necessary and emit it.  Note that if slice
   // is empty, we still want to iterate once to emit a single
   // zero-length record
+  const int header_size =
+      recycle_log_file_ ? kRecyclableHeaderSize : kHeaderSize;
   Status s;
   bool begin = true;
   do {
     const int leftover = kBlockSize - block_offset_;
     assert(leftover >= 0);
-    if (leftover < kHeaderSize) {
+    if (leftover < header_size) {
       // Switch to a new block
       if (leftover > 0) {
-        // Fill the trailer (literal below relies on kHeaderSize being 7)
-        static_assert(kHeaderSize == 7, "");
-        dest_->Append(Slice("\x00\x00\x00\x00\x00\x00", leftover));
+        // Fill the trailer (literal below relies on kRecyclableHeaderSize
+        // being 11)
+        static_assert(kRecyclableHeaderSize == 11, "");
+        dest_->Append(
+            Slice("\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00", leftover));
       }
       block_offset_ = 0;
     }
 
-    // Invariant: we never leave < kHeaderSize bytes in a block.
-    assert(kBlockSize - block_offset_ - kHeaderSize >= 0);
+    // Invariant: we never leave < header_size bytes in a block.
+    assert(kBlockSize - block_offset_ - header_size >= 0);
 
-    const size_t avail = kBlockSize - block_offset_ - kHeaderSize;
+    const size_t avail = kBlockSize - block_offset_ - header_size;
     const size_t fragment_length = (left < avail) ? left : avail;
 
     RecordType type;
     const bool end = (left == fragment_length);
     if (begin && end) {
-      type = kFullType;
+      type = recycle_log_file_ ? kRecyclableFullType : kFullType;
     } else if (begin) {
-      type = kFirstType;
+      type = recycle_log_file_ ? kRecyclableFirstType : kFirstType;
     } else if (end) {
-      type = kLastType;
+      type = recycle_log_file_ ? kRecyclableLastType : kLastType;
     } else {
-      type = kMiddleType;
+      type = recycle_log_file_ ? kRecyclableMiddleType : kMiddleType;
     }
 
     s = EmitPhysicalRecord(type, ptr, fragment_length);
@@ -79,31 +121,94 @@ Status Writer::AddRecord(const Slice& slice) {
   return s;
 }
 
+bool CompressionSupported(CompressionType type, int zstd_level) {
+  std::string out;
+  Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+  switch (type) {
+    case kSnappyCompression:
+      return port::Snappy_Compress(in.data(), in.size(), &out);
+    case kZstdCompression:
+      return port::Zstd_Compress(zstd_level, in.data(), in.size(), &out);
+    default:
+      return false;
+  }
+}
+
+Status Writer::AddCompressionTypeRecord(CompressionType type,
+                                        int zstd_level) {
+  assert(block_offset_ == 0);
+  assert(compression_type_ == kNoCompression);
+  if (!CompressionSupported(type, zstd_level)) {
+    return Status::OK();
+  }
+
+  const char payload = static_cast<char>(type);
+  Status s = EmitPhysicalRecord(
+      recycle_log_file_ ? kRecyclableSetCompressionType : kSetCompressionType,
+      &payload, 1);
+  if (s.ok()) {
+    compression_type_ = type;
+    zstd_level_ = zstd_level;
+  }
+  return s;
+}
+
+void Writer::CompressRecord(const Slice& record) {
+  bool ok = false;
+  switch (compression_type_) {
+    case kSnappyCompression:
+      ok = port::Snappy_Compress(record.data(), record.size(), &compressed_);
+      break;
+    case kZstdCompression:
+      ok = port::Zstd_Compress(zstd_level_, record.data(), record.size(),
+                               &compressed_);
+      break;
+    default:
+      break;
+  }
+  if (ok && compressed_.size() < record.size() - (record.size() / 8u)) {
+    compressed_.insert(0, 1, static_cast<char>(compression_type_));
+  } else {
+    // Compressed less than 12.5%, so just store the uncompressed form.
+    compressed_.assign(1, static_cast<char>(kNoCompression));
+    compressed_.append(record.data(), record.size());
+  }
+}
+
 Status Writer::EmitPhysicalRecord(RecordType t, const char* ptr,
                                   size_t length) {
   assert(length <= 0xffff);  // Must fit in two bytes
-  assert(block_offset_ + kHeaderSize + length <= kBlockSize);
 
   // Format the header
-  char buf[kHeaderSize];
+  char buf[kRecyclableHeaderSize];
   buf[4] = static_cast<char>(length & 0xff);
   buf[5] = static_cast<char>(length >> 8);
   buf[6] = static_cast<char>(t);
 
-  // Compute the crc of the record type and the payload.
-  uint32_t crc = crc32c::Extend(type_crc_[t], ptr, length);
+  // Compute the crc of the record type, the log number (if present) and
+  // the payload.
+  uint32_t crc = type_crc_[t];
+  size_t header_size = kHeaderSize;
+  if (IsRecyclableType(t)) {
+    // Only the low 32 bits of the log number are stored.
+    EncodeFixed32(buf + kHeaderSize, static_cast<uint32_t>(log_number_));
+    crc = crc32c::Extend(crc, buf + kHeaderSize, 4);
+    header_size = kRecyclableHeaderSize;
+  }
+  assert(block_offset_ + header_size + length <= kBlockSize);
+  crc = crc32c::Extend(crc, ptr, length);
   crc = crc32c::Mask(crc);  // Adjust for storage
   EncodeFixed32(buf, crc);
 
   // Write the header and the payload
-  Status s = dest_->Append(Slice(buf, kHeaderSize));
+  Status s = dest_->Append(Slice(buf, header_size));
   if (s.ok()) {
     s = dest_->Append(Slice(ptr, length));
     if (s.ok()) {
       s = dest_->Flush();
     }
   }
-  block_offset_ += kHeaderSize + length;
+  block_offset_ += header_size + length;
   return s;
 }
 
@@ -6,8 +6,10 @@
 #define STORAGE_LEVELDB_DB_LOG_WRITER_H_
 
 #include <cstdint>
+#include <string>
 
 #include "db/log_format.h"
+#include "leveldb/options.h"
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
 
@@ -17,6 +19,10 @@ class WritableFile;
 
 namespace log {
 
+// Returns true if log records can be compressed with "type" in this
+// build.  "zstd_level" is the compression level used for kZstdCompression.
+bool CompressionSupported(CompressionType type, int zstd_level);
+
 class Writer {
  public:
   // Create a writer that will append data to "*dest".
@@ -29,6 +35,20 @@ class Writer {
   // "*dest" must remain live while this Writer is in use.
   Writer(WritableFile* dest, uint64_t dest_length);
 
+  // Create a writer that will write data to "*dest", which may be a
+  // recycled log file holding stale records from its previous use.
+  // Records are tagged with "log_number" so that readers can detect
+  // where the new records end.
+  // "*dest" must remain live while this Writer is in use.
+  Writer(WritableFile* dest, uint64_t log_number, bool recycle_log_file);
+
+  // Create a writer that will append data to "*dest", which must have
+  // initial length "dest_length" and hold records of log "log_number"
+  // written in the recyclable format if "recycle_log_file" is true.
+  // "*dest" must remain live while this Writer is in use.
+  Writer(WritableFile* dest, uint64_t dest_length, uint64_t log_number,
+         bool recycle_log_file);
+
   Writer(const Writer&) = delete;
   Writer& operator=(const Writer&) = delete;
 
@@ -36,11 +56,29 @@ class Writer {
 
   Status AddRecord(const Slice& slice);
 
+  // Compress the payload of every record added from now on with "type".
+  // "zstd_level" is the compression level used for kZstdCompression.  If
+  // "type" is not supported by this build, records are left uncompressed
+  // and nothing is written.
+  //
+  // REQUIRES: no records have been added to this log yet.
+  Status AddCompressionTypeRecord(CompressionType type, int zstd_level);
+
  private:
   Status EmitPhysicalRecord(RecordType type, const char* ptr, size_t length);
 
+  // Store the compressed form of "record" in compressed_, prefixed with
+  // the compression type actually used for it.
+  void CompressRecord(const Slice& record);
+
   WritableFile* dest_;
   int block_offset_;  // Current offset in block
+  const uint64_t log_number_;
+  const bool recycle_log_file_;
+
+  CompressionType compression_type_;
+  int zstd_level_;
+  std::string compressed_;  // Scratch space for compressed records
 
   // crc32c values for all supported record types.  These are
   // pre-computed to reduce the overhead of computing the crc of the
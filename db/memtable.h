@@ -8,9 +8,11 @@
 #include <string>
 
 #include "db/dbformat.h"
-#include "db/skiplist.h"
+#include "db/memtablerep.h"
 #include "leveldb/db.h"
+#include "leveldb/options.h"
 #include "util/arena.h"
+#include "util/dynamic_bloom.h"
 
 namespace leveldb {
 
@@ -21,6 +23,12 @@ class MemTable {
  public:
   // MemTables are reference counted.  The initial reference count
   // is zero and the caller must call Ref() at least once.
+  //
+  // The contents are held in the data structure selected by
+  // options.memtable_rep (a skiplist if options are not given).  If
+  // options.memtable_bloom_size_ratio is set, lookups of user keys that
+  // were never added are answered by a bloom filter.
+  MemTable(const InternalKeyComparator& comparator, const Options& options);
   explicit MemTable(const InternalKeyComparator& comparator);
 
   MemTable(const MemTable&) = delete;
@@ -56,6 +64,11 @@ class MemTable {
   void Add(SequenceNumber seq, ValueType type, const Slice& key,
            const Slice& value);
 
+  // Same as Add(), but may be called from several threads at once.  Must
+  // not be called concurrently with Add().
+  void AddConcurrently(SequenceNumber seq, ValueType type, const Slice& key,
+                       const Slice& value);
+
   // If memtable contains a value for key, store it in *value and return true.
   // If memtable contains a deletion for key, store a NotFound() error
   // in *status and return true.
@@ -63,23 +76,13 @@ class MemTable {
   bool Get(const LookupKey& key, std::string* value, Status* s);
 
  private:
-  friend class MemTableIterator;
-  friend class MemTableBackwardIterator;
-
-  struct KeyComparator {
-    const InternalKeyComparator comparator;
-    explicit KeyComparator(const InternalKeyComparator& c) : comparator(c) {}
-    int operator()(const char* a, const char* b) const;
-  };
-
-  typedef SkipList<const char*, KeyComparator> Table;
-
   ~MemTable();  // Private since only Unref() should be used to delete it
 
-  KeyComparator comparator_;
+  MemTableKeyComparator comparator_;
   int refs_;
   Arena arena_;
-  Table table_;
+  MemTableRep* const table_;
+  DynamicBloom* const bloom_;  // nullptr if memtable_bloom_size_ratio is 0
 };
 
 }  // namespace leveldb
@@ -0,0 +1,152 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/memtablerep.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "db/inline_skiplist.h"
+#include "util/arena.h"
+
+namespace leveldb {
+
+int MemTableKeyComparator::operator()(const char* aptr,
+                                      const char* bptr) const {
+  // Internal keys are encoded as length-prefixed strings.
+  Slice a = GetMemTableEntryKey(aptr);
+  Slice b = GetMemTableEntryKey(bptr);
+  return comparator.Compare(a, b);
+}
+
+char* MemTableRep::Allocate(size_t len) { return arena_->Allocate(len); }
+
+char* MemTableRep::AllocateConcurrently(size_t len) {
+  return arena_->AllocateConcurrently(len);
+}
+
+namespace {
+
+// An iterator over a sorted array of entries that is not modified.
+class SortedArrayIterator : public MemTableRep::Iterator {
+ public:
+  SortedArrayIterator(const MemTableKeyComparator& cmp,
+                      std::vector<const char*>* entries)
+      : compare_(cmp) {
+    entries_.swap(*entries);
+    pos_ = entries_.size();
+  }
+
+  bool Valid() const override { return pos_ < entries_.size(); }
+
+  const char* key() const override {
+    assert(Valid());
+    return entries_[pos_];
+  }
+
+  void Next() override {
+    assert(Valid());
+    ++pos_;
+  }
+
+  void Prev() override {
+    assert(Valid());
+    pos_ = (pos_ == 0) ? entries_.size() : pos_ - 1;
+  }
+
+  void Seek(const char* target) override {
+    pos_ = std::lower_bound(entries_.begin(), entries_.end(), target,
+                            [this](const char* a, const char* b) {
+                              return compare_(a, b) < 0;
+                            }) -
+           entries_.begin();
+  }
+
+  void SeekToFirst() override { pos_ = 0; }
+
+  void SeekToLast() override {
+    pos_ = entries_.empty() ? 0 : entries_.size() - 1;
+  }
+
+ private:
+  const MemTableKeyComparator& compare_;
+  std::vector<const char*> entries_;
+  size_t pos_;  // entries_.size() if not valid
+};
+
+class SkipListRep : public MemTableRep {
+ public:
+  SkipListRep(const MemTableKeyComparator& cmp, Arena* arena)
+      : MemTableRep(arena), table_(cmp, arena) {}
+
+  char* Allocate(size_t len) override { return table_.AllocateKey(len); }
+
+  char* AllocateConcurrently(size_t len) override {
+    return table_.AllocateKeyConcurrently(len);
+  }
+
+  void Insert(const char* entry) override { table_.Insert(entry); }
+
+  void InsertConcurrently(const char* entry) override {
+    table_.InsertConcurrently(entry);
+  }
+
+  const char* Lookup(const char* key) const override {
+    Table::Iterator iter(&table_);
+    iter.Seek(key);
+    return iter.Valid() ? iter.key() : nullptr;
+  }
+
+  Iterator* NewIterator() const override {
+    return new SkipListIterator(&table_);
+  }
+
+ private:
+  typedef InlineSkipList<const MemTableKeyComparator&> Table;
+
+  class SkipListIterator : public Iterator {
+   public:
+    explicit SkipListIterator(const Table* table) : iter_(table) {}
+
+    bool Valid() const override { return iter_.Valid(); }
+    const char* key() const override { return iter_.key(); }
+    void Next() override { iter_.Next(); }
+    void Prev() override { iter_.Prev(); }
+    void Seek(const char* target) override { iter_.Seek(target); }
+    void SeekToFirst() override { iter_.SeekToFirst(); }
+    void SeekToLast() override { iter_.SeekToLast(); }
+
+   private:
+    Table::Iterator iter_;
+  };
+
+  Table table_;
+};
+
+}  // namespace
+
+MemTableRep::Iterator* NewSortedArrayIterator(
+    const MemTableKeyComparator& cmp, std::vector<const char*>* entries) {
+  return new SortedArrayIterator(cmp, entries);
+}
+
+MemTableRep* NewSkipListRep(const MemTableKeyComparator& cmp, Arena* arena) {
+  return new SkipListRep(cmp, arena);
+}
+
+MemTableRep* NewMemTableRep(const Options& options,
+                            const MemTableKeyComparator& cmp, Arena* arena) {
+  switch (options.memtable_rep) {
+    case kHashSkipListRep:
+      return NewHashSkipListRep(cmp, arena, options.prefix_extractor,
+                                options.memtable_hash_bucket_count);
+    case kVectorRep:
+      return NewVectorRep(cmp, arena);
+    case kSkipListRep:
+    default:
+      return NewSkipListRep(cmp, arena);
+  }
+}
+
+}  // namespace leveldb
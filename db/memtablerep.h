@@ -0,0 +1,142 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A MemTableRep is the data structure that holds the entries of a
+// MemTable.  Entries are opaque pointers to the encoding described in
+// memtable.cc, which starts with a length-prefixed internal key; a
+// MemTableRep only stores and orders these pointers.  The entries and
+// the nodes of the representation are allocated from the MemTable's
+// arena and are never freed before the MemTable is destroyed.
+//
+// Thread safety: writes are externally synchronized, unless they all go
+// through InsertConcurrently().  Reads may proceed concurrently with
+// writes.
+
+#ifndef STORAGE_LEVELDB_DB_MEMTABLEREP_H_
+#define STORAGE_LEVELDB_DB_MEMTABLEREP_H_
+
+#include <vector>
+
+#include "db/dbformat.h"
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+class Arena;
+
+// Return the internal key at the start of a memtable entry.
+inline Slice GetMemTableEntryKey(const char* entry) {
+  uint32_t len;
+  // +5: we assume "entry" is not corrupted
+  const char* p = GetVarint32Ptr(entry, entry + 5, &len);
+  return Slice(p, len);
+}
+
+// Orders memtable entries by their internal keys.
+struct MemTableKeyComparator {
+  const InternalKeyComparator comparator;
+  explicit MemTableKeyComparator(const InternalKeyComparator& c)
+      : comparator(c) {}
+  int operator()(const char* a, const char* b) const;
+};
+
+class MemTableRep {
+ public:
+  // Iteration over the entries of a MemTableRep in key order.  Seek
+  // targets are encoded like the start of an entry: a length-prefixed
+  // internal key.
+  class Iterator {
+   public:
+    Iterator() = default;
+
+    Iterator(const Iterator&) = delete;
+    Iterator& operator=(const Iterator&) = delete;
+
+    virtual ~Iterator() = default;
+
+    virtual bool Valid() const = 0;
+
+    // REQUIRES: Valid()
+    virtual const char* key() const = 0;
+
+    // REQUIRES: Valid()
+    virtual void Next() = 0;
+
+    // REQUIRES: Valid()
+    virtual void Prev() = 0;
+
+    // Advance to the first entry with a key >= target
+    virtual void Seek(const char* target) = 0;
+
+    virtual void SeekToFirst() = 0;
+    virtual void SeekToLast() = 0;
+  };
+
+  explicit MemTableRep(Arena* arena) : arena_(arena) {}
+
+  MemTableRep(const MemTableRep&) = delete;
+  MemTableRep& operator=(const MemTableRep&) = delete;
+
+  virtual ~MemTableRep() = default;
+
+  // Return memory for an entry of len bytes, to be filled in and passed
+  // to Insert().  Representations may allocate the entry together with
+  // their own bookkeeping for it.  The default allocates from the arena.
+  virtual char* Allocate(size_t len);
+
+  // Like Allocate(), but safe to call from several threads at once.  The
+  // result must be passed to InsertConcurrently().
+  virtual char* AllocateConcurrently(size_t len);
+
+  // Insert entry, which was returned by Allocate(), into the
+  // representation.
+  // REQUIRES: nothing that compares equal to entry is currently stored.
+  virtual void Insert(const char* entry) = 0;
+
+  // Like Insert(), but safe to call from several threads at once.  Must
+  // not be mixed with concurrent calls to Insert().
+  virtual void InsertConcurrently(const char* entry) = 0;
+
+  // Return the first entry whose key is >= key, provided it has the same
+  // user key as key.  Otherwise return either nullptr or the first entry
+  // whose key is >= key, so callers must check the user key.
+  virtual const char* Lookup(const char* key) const = 0;
+
+  // Return a new iterator over all of the entries.  The caller must
+  // delete it while the representation is live.
+  virtual Iterator* NewIterator() const = 0;
+
+  // Returns an estimate of the number of bytes of memory in use by this
+  // representation that was not allocated from the arena.
+  virtual size_t ApproximateMemoryUsage() const { return 0; }
+
+ protected:
+  Arena* const arena_;
+};
+
+// Return a new iterator over *entries, which must be sorted by cmp.  The
+// contents of *entries are moved into the iterator.
+MemTableRep::Iterator* NewSortedArrayIterator(const MemTableKeyComparator& cmp,
+                                              std::vector<const char*>* entries);
+
+// Return a new representation of the type selected by options.memtable_rep
+// that orders entries with cmp and allocates memory from arena.  The
+// caller must keep cmp and arena alive while the result is live.
+// options.prefix_extractor, if set, is applied to internal keys, as the
+// InternalKeySliceTransform of sanitized DB options is.
+MemTableRep* NewMemTableRep(const Options& options,
+                            const MemTableKeyComparator& cmp, Arena* arena);
+
+// Implementations of NewMemTableRep() for every MemTableRepType.
+MemTableRep* NewSkipListRep(const MemTableKeyComparator& cmp, Arena* arena);
+MemTableRep* NewHashSkipListRep(const MemTableKeyComparator& cmp, Arena* arena,
+                                const SliceTransform* prefix_extractor,
+                                size_t bucket_count);
+MemTableRep* NewVectorRep(const MemTableKeyComparator& cmp, Arena* arena);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_MEMTABLEREP_H_
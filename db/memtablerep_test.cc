@@ -0,0 +1,226 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <atomic>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "db/dbformat.h"
+#include "db/memtable.h"
+#include "gtest/gtest.h"
+#include "leveldb/comparator.h"
+#include "leveldb/env.h"
+#include "leveldb/iterator.h"
+#include "leveldb/slice_transform.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+namespace {
+
+// User key and sequence number of an entry, in memtable order.
+typedef std::pair<std::string, SequenceNumber> ModelKey;
+
+struct ModelOrder {
+  bool operator()(const ModelKey& a, const ModelKey& b) const {
+    if (a.first != b.first) return a.first < b.first;
+    return a.second > b.second;
+  }
+};
+
+typedef std::map<ModelKey, std::string, ModelOrder> Model;
+
+std::string RandomUserKey(Random* rnd) {
+  // Short keys fall outside the domain of the prefix extractor.
+  char buf[16];
+  std::snprintf(buf, sizeof(buf), "%c%d", 'a' + rnd->Uniform(4),
+                static_cast<int>(rnd->Uniform(rnd->OneIn(4) ? 10 : 500)));
+  return buf;
+}
+
+}  // namespace
+
+class MemTableRepTest : public testing::TestWithParam<MemTableRepType> {
+ public:
+  MemTableRepTest()
+      : icmp_(BytewiseComparator()),
+        prefix_(NewFixedPrefixTransform(2)),
+        iprefix_(prefix_) {
+    options_.memtable_rep = GetParam();
+    options_.memtable_hash_bucket_count = 16;  // Force collisions
+    options_.prefix_extractor = &iprefix_;
+    mem_ = new MemTable(icmp_, options_);
+    mem_->Ref();
+  }
+
+  ~MemTableRepTest() {
+    mem_->Unref();
+    delete prefix_;
+  }
+
+  // Return the value of key as of sequence number seq, "NOT_FOUND" for a
+  // deletion, or "MISSING" if the memtable knows nothing about key.
+  std::string Get(const std::string& key, SequenceNumber seq) {
+    LookupKey lkey(key, seq);
+    std::string value;
+    Status s;
+    if (!mem_->Get(lkey, &value, &s)) {
+      return "MISSING";
+    }
+    return s.IsNotFound() ? "NOT_FOUND" : value;
+  }
+
+  std::string ModelGet(const Model& model, const std::string& key,
+                       SequenceNumber seq) {
+    auto iter = model.lower_bound(ModelKey(key, seq));
+    if (iter == model.end() || iter->first.first != key) {
+      return "MISSING";
+    }
+    return iter->second;
+  }
+
+  static ModelKey Parse(const Slice& internal_key) {
+    ParsedInternalKey parsed;
+    EXPECT_TRUE(ParseInternalKey(internal_key, &parsed));
+    return ModelKey(parsed.user_key.ToString(), parsed.sequence);
+  }
+
+  const InternalKeyComparator icmp_;
+  const SliceTransform* const prefix_;
+  const InternalKeySliceTransform iprefix_;
+  Options options_;
+  MemTable* mem_;
+};
+
+INSTANTIATE_TEST_SUITE_P(MemTableReps, MemTableRepTest,
+                         testing::Values(kSkipListRep, kHashSkipListRep,
+                                         kVectorRep));
+
+TEST_P(MemTableRepTest, Empty) {
+  ASSERT_EQ("MISSING", Get("foo", kMaxSequenceNumber));
+  Iterator* iter = mem_->NewIterator();
+  iter->SeekToFirst();
+  ASSERT_TRUE(!iter->Valid());
+  iter->SeekToLast();
+  ASSERT_TRUE(!iter->Valid());
+  iter->Seek(InternalKey("foo", 1, kTypeValue).Encode());
+  ASSERT_TRUE(!iter->Valid());
+  delete iter;
+}
+
+TEST_P(MemTableRepTest, InsertAndLookup) {
+  Random rnd(301);
+  Model model;
+  const SequenceNumber kNumEntries = 3000;
+  for (SequenceNumber seq = 1; seq <= kNumEntries; seq++) {
+    std::string key = RandomUserKey(&rnd);
+    if (rnd.OneIn(5)) {
+      mem_->Add(seq, kTypeDeletion, key, Slice());
+      model[ModelKey(key, seq)] = "NOT_FOUND";
+    } else {
+      std::string value = "v" + std::to_string(seq);
+      mem_->Add(seq, kTypeValue, key, value);
+      model[ModelKey(key, seq)] = value;
+    }
+  }
+
+  for (int i = 0; i < 2000; i++) {
+    std::string key = RandomUserKey(&rnd);
+    SequenceNumber seq = rnd.OneIn(2) ? kMaxSequenceNumber
+                                      : rnd.Uniform(kNumEntries + 1);
+    ASSERT_EQ(ModelGet(model, key, seq), Get(key, seq)) << key << "@" << seq;
+  }
+
+  // Forward and backward iteration yield every entry in order.
+  Iterator* iter = mem_->NewIterator();
+  iter->SeekToFirst();
+  for (const auto& entry : model) {
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_TRUE(Parse(iter->key()) == entry.first);
+    iter->Next();
+  }
+  ASSERT_TRUE(!iter->Valid());
+  iter->SeekToLast();
+  for (auto it = model.rbegin(); it != model.rend(); ++it) {
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_TRUE(Parse(iter->key()) == it->first);
+    iter->Prev();
+  }
+  ASSERT_TRUE(!iter->Valid());
+
+  // Seek lands on the first entry at or after the target.
+  for (int i = 0; i < 1000; i++) {
+    std::string key = RandomUserKey(&rnd);
+    SequenceNumber seq = rnd.Uniform(kNumEntries + 1);
+    iter->Seek(InternalKey(key, seq, kValueTypeForSeek).Encode());
+    auto model_iter = model.lower_bound(ModelKey(key, seq));
+    if (model_iter == model.end()) {
+      ASSERT_TRUE(!iter->Valid());
+    } else {
+      ASSERT_TRUE(iter->Valid());
+      ASSERT_TRUE(Parse(iter->key()) == model_iter->first);
+    }
+  }
+  delete iter;
+
+  // Lookups still work once the memtable has been iterated over.
+  for (int i = 0; i < 1000; i++) {
+    std::string key = RandomUserKey(&rnd);
+    SequenceNumber seq = rnd.Uniform(kNumEntries + 1);
+    ASSERT_EQ(ModelGet(model, key, seq), Get(key, seq)) << key << "@" << seq;
+  }
+}
+
+namespace {
+
+struct ConcurrentAddState {
+  static const int kThreads = 4;
+  static const int kKeysPerThread = 5000;
+
+  MemTable* mem;
+  std::atomic<int> next_id{0};
+  std::atomic<int> done{0};
+};
+
+void ConcurrentAdder(void* arg) {
+  ConcurrentAddState* state = reinterpret_cast<ConcurrentAddState*>(arg);
+  const int id = state->next_id.fetch_add(1);
+  for (int i = 0; i < ConcurrentAddState::kKeysPerThread; i++) {
+    const int n = i * ConcurrentAddState::kThreads + id;
+    state->mem->AddConcurrently(n + 1, kTypeValue, std::to_string(n),
+                                std::to_string(n));
+  }
+  state->done.fetch_add(1, std::memory_order_release);
+}
+
+}  // namespace
+
+TEST_P(MemTableRepTest, AddConcurrently) {
+  ConcurrentAddState state;
+  state.mem = mem_;
+  for (int i = 0; i < ConcurrentAddState::kThreads; i++) {
+    Env::Default()->StartThread(ConcurrentAdder, &state);
+  }
+  while (state.done.load(std::memory_order_acquire) <
+         ConcurrentAddState::kThreads) {
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+
+  const int total =
+      ConcurrentAddState::kThreads * ConcurrentAddState::kKeysPerThread;
+  for (int n = 0; n < total; n++) {
+    ASSERT_EQ(std::to_string(n), Get(std::to_string(n), kMaxSequenceNumber));
+  }
+  int count = 0;
+  Iterator* iter = mem_->NewIterator();
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  delete iter;
+  ASSERT_EQ(total, count);
+}
+
+}  // namespace leveldb
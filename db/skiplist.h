@@ -8,7 +8,9 @@
 // Thread safety
 // -------------
 //
-// Writes require external synchronization, most likely a mutex.
+// Writes require external synchronization, most likely a mutex, unless
+// they all go through InsertConcurrently(), which synchronizes writers
+// with compare-and-swap operations on the links.
 // Reads require a guarantee that the SkipList will not be destroyed
 // while the read is in progress.  Apart from that, reads progress
 // without any internal locking or synchronization.
@@ -27,9 +29,12 @@
 //
 // ... prev vs. next pointer ordering ...
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <cstdlib>
+#include <functional>
+#include <thread>
 
 #include "util/arena.h"
 #include "util/random.h"
@@ -45,15 +50,24 @@ class SkipList {
   // Create a new SkipList object that will use "cmp" for comparing keys,
   // and will allocate memory using "*arena".  Objects allocated in the arena
   // must remain allocated for the lifetime of the skiplist object.
-  explicit SkipList(Comparator cmp, Arena* arena);
+  // If "concurrent" is true, the list is created with the thread-safe
+  // arena methods, so other threads may allocate from "*arena" meanwhile.
+  explicit SkipList(Comparator cmp, Arena* arena, bool concurrent = false);
 
   SkipList(const SkipList&) = delete;
   SkipList& operator=(const SkipList&) = delete;
 
-  // Insert key into the list.
+  // Insert key into the list.  Inserts that land next to the previous
+  // insert, such as keys inserted in increasing order, are O(1) amortized.
   // REQUIRES: nothing that compares equal to key is currently in the list.
   void Insert(const Key& key);
 
+  // Like Insert(), but safe to call from several threads at once without
+  // external synchronization.  Must not be mixed with concurrent calls to
+  // Insert().
+  // REQUIRES: nothing that compares equal to key is currently in the list.
+  void InsertConcurrently(const Key& key);
+
   // Returns true iff an entry that compares equal to key is in the list.
   bool Contains(const Key& key) const;
 
@@ -103,8 +117,9 @@ class SkipList {
     return max_height_.load(std::memory_order_relaxed);
   }
 
-  Node* NewNode(const Key& key, int height);
-  int RandomHeight();
+  Node* NewNode(const Key& key, int height, bool concurrent = false);
+  int RandomHeight() { return RandomHeight(&rnd_); }
+  static int RandomHeight(Random* rnd);
   bool Equal(const Key& a, const Key& b) const { return (compare_(a, b) == 0); }
 
   // Return true if key is greater than the data stored in "n"
@@ -117,6 +132,12 @@ class SkipList {
   // node at "level" for every level in [0..max_height_-1].
   Node* FindGreaterOrEqual(const Key& key, Node** prev) const;
 
+  // Starting from "before" (which must come before key), find the nodes
+  // between which key belongs at "level" and store them in *out_prev and
+  // *out_next.
+  void FindSpliceForLevel(const Key& key, Node* before, int level,
+                          Node** out_prev, Node** out_next) const;
+
   // Return the latest node with a key < key.
   // Return head_ if there is no such node.
   Node* FindLessThan(const Key& key) const;
@@ -131,12 +152,23 @@ class SkipList {
 
   Node* const head_;
 
-  // Modified only by Insert().  Read racily by readers, but stale
-  // values are ok.
+  // Modified only by Insert() and InsertConcurrently().  Read racily by
+  // readers, but stale values are ok.
   std::atomic<int> max_height_;  // Height of the entire list
 
-  // Read/written only by Insert().
+  // Read/written only by Insert().  InsertConcurrently() uses a
+  // thread-local generator instead.
   Random rnd_;
+
+  // Read/written only by Insert().  The nodes between which the last
+  // inserted key was linked at every level: splice_prev_[i] is the last
+  // node before splice_next_[i] at level i.  A level of the splice can be
+  // reused for the next key if the key falls between its nodes.
+  Node* splice_prev_[kMaxHeight];
+  Node* splice_next_[kMaxHeight];
+
+  // Cleared by InsertConcurrently(), which does not maintain the splice.
+  std::atomic<bool> splice_valid_;
 };
 
 // Implementation details follow
@@ -178,6 +210,15 @@ struct SkipList<Key, Comparator>::Node {
     next_[n].store(x, std::memory_order_relaxed);
   }
 
+  // Atomically replace the link at level n with x if it still points to
+  // expected.  Has release semantics on success, like SetNext().
+  bool CASNext(int n, Node* expected, Node* x) {
+    assert(n >= 0);
+    return next_[n].compare_exchange_strong(expected, x,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed);
+  }
+
  private:
   // Array of length equal to the node height.  next_[0] is lowest level link.
   // 注意, 这里具有原子性的是指针, 数组是的元素时原子变量, 而不是指针
@@ -186,9 +227,12 @@ struct SkipList<Key, Comparator>::Node {
 
 template <typename Key, class Comparator>
 typename SkipList<Key, Comparator>::Node* SkipList<Key, Comparator>::NewNode(
-    const Key& key, int height) {
-  char* const node_memory = arena_->AllocateAligned(
-      sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1));
+    const Key& key, int height, bool concurrent) {
+  const size_t node_size =
+      sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1);
+  char* const node_memory = concurrent
+                                ? arena_->AllocateAlignedConcurrently(node_size)
+                                : arena_->AllocateAligned(node_size);
   return new (node_memory) Node(key);
 }
 
@@ -245,14 +289,14 @@ inline void SkipList<Key, Comparator>::Iterator::SeekToLast() {
 }
 
 template <typename Key, class Comparator>
-int SkipList<Key, Comparator>::RandomHeight() {
+int SkipList<Key, Comparator>::RandomHeight(Random* rnd) {
   // Increase height with probability 1 in kBranching
   // 以概率 1 / kBranching 增加高度
   // 
   // 这就使第 n 层的节点数量大约为 n - 1 层节点数量的 1 / 4
   static const unsigned int kBranching = 4;
   int height = 1;
-  while (height < kMaxHeight && rnd_.OneIn(kBranching)) {
+  while (height < kMaxHeight && rnd->OneIn(kBranching)) {
     height++;
   }
   assert(height > 0);
@@ -289,6 +333,23 @@ SkipList<Key, Comparator>::FindGreaterOrEqual(const Key& key,
   }
 }
 
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::FindSpliceForLevel(const Key& key,
+                                                   Node* before, int level,
+                                                   Node** out_prev,
+                                                   Node** out_next) const {
+  while (true) {
+    Node* next = before->Next(level);
+    if (KeyIsAfterNode(key, next)) {
+      before = next;
+    } else {
+      *out_prev = before;
+      *out_next = next;
+      return;
+    }
+  }
+}
+
 template <typename Key, class Comparator>
 typename SkipList<Key, Comparator>::Node*
 SkipList<Key, Comparator>::FindLessThan(const Key& key) const {
@@ -331,32 +392,60 @@ typename SkipList<Key, Comparator>::Node* SkipList<Key, Comparator>::FindLast()
 }
 
 template <typename Key, class Comparator>
-SkipList<Key, Comparator>::SkipList(Comparator cmp, Arena* arena)
+SkipList<Key, Comparator>::SkipList(Comparator cmp, Arena* arena,
+                                    bool concurrent)
     : compare_(cmp),
       arena_(arena),
-      head_(NewNode(0 /* any key will do */, kMaxHeight)),
+      head_(NewNode(0 /* any key will do */, kMaxHeight, concurrent)),
       max_height_(1),
-      rnd_(0xdeadbeef) {
+      rnd_(0xdeadbeef),
+      splice_valid_(true) {
   for (int i = 0; i < kMaxHeight; i++) {
     head_->SetNext(i, nullptr);
+    splice_prev_[i] = head_;
+    splice_next_[i] = nullptr;
   }
 }
 
 template <typename Key, class Comparator>
 void SkipList<Key, Comparator>::Insert(const Key& key) {
-  // TODO(opt): We can use a barrier-free variant of FindGreaterOrEqual()
-  // here since Insert() is externally synchronized.
-  Node* prev[kMaxHeight];
-  Node* x = FindGreaterOrEqual(key, prev);
+  Node** const prev = splice_prev_;
+  Node** const next = splice_next_;
+  int level = 0;
+  if (!splice_valid_.load(std::memory_order_relaxed)) {
+    // Search from the top.
+    level = kMaxHeight;
+    splice_valid_.store(true, std::memory_order_relaxed);
+  }
+
+  // Find the lowest level of the previous splice that still brackets
+  // key.  Since the splice gets wider at higher levels, every level above
+  // it brackets key as well.  Give up early if key comes before the
+  // splice, which a full search from the top handles best.
+  while (level < kMaxHeight) {
+    if (prev[level] != head_ && !KeyIsAfterNode(key, prev[level])) {
+      level = kMaxHeight;
+    } else if (KeyIsAfterNode(key, next[level])) {
+      level++;
+    } else {
+      break;
+    }
+  }
+
+  // Recompute the splice below that level.  Levels at or above the
+  // height of the list are empty, so their splice is always head_ and
+  // nullptr.
+  level = std::min(level, GetMaxHeight());
+  for (int i = level - 1; i >= 0; i--) {
+    Node* before = (i + 1 < kMaxHeight) ? prev[i + 1] : head_;
+    FindSpliceForLevel(key, before, i, &prev[i], &next[i]);
+  }
 
   // Our data structure does not allow duplicate insertion
-  assert(x == nullptr || !Equal(key, x->key));
+  assert(next[0] == nullptr || !Equal(key, next[0]->key));
 
   int height = RandomHeight();
   if (height > GetMaxHeight()) {
-    for (int i = GetMaxHeight(); i < height; i++) {
-      prev[i] = head_;
-    }
     // It is ok to mutate max_height_ without any synchronization
     // with concurrent readers.  A concurrent reader that observes
     // the new value of max_height_ will see either the old value of
@@ -367,7 +456,7 @@ void SkipList<Key, Comparator>::Insert(const Key& key) {
     max_height_.store(height, std::memory_order_relaxed);
   }
 
-  x = NewNode(key, height);
+  Node* x = NewNode(key, height);
   for (int i = 0; i < height; i++) {
     // NoBarrier_SetNext() suffices since we will add a barrier when
     // we publish a pointer to "x" in prev[i].
@@ -383,8 +472,55 @@ void SkipList<Key, Comparator>::Insert(const Key& key) {
     // 且必须在 低 level 设置完后才能设置 高 level
     // 如果先在 高 level 中加入 x, 可能会出现其他线程并发查找时 x 低 level 的 _next 悬空的情况,
     // 从而出错, 而先设置 低 level 就不会有问题
-    x->NoBarrier_SetNext(i, prev[i]->NoBarrier_Next(i));
+    x->NoBarrier_SetNext(i, next[i]);
     prev[i]->SetNext(i, x);
+    // x now immediately precedes next[i], which makes it the splice
+    // for a key that follows it.
+    prev[i] = x;
+  }
+}
+
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::InsertConcurrently(const Key& key) {
+  splice_valid_.store(false, std::memory_order_relaxed);
+
+  // rnd_ belongs to Insert(), so use a generator private to this thread.
+  static thread_local Random rnd(static_cast<uint32_t>(
+      std::hash<std::thread::id>()(std::this_thread::get_id())));
+  const int height = RandomHeight(&rnd);
+
+  // Raise max_height_ first so that the search below visits every level
+  // we are going to link into.  Readers tolerate a max_height_ that is
+  // higher than the height of any linked node (see Insert()).
+  int max_height = GetMaxHeight();
+  while (height > max_height &&
+         !max_height_.compare_exchange_weak(max_height, height,
+                                            std::memory_order_relaxed)) {
+  }
+
+  Node* prev[kMaxHeight];
+  Node* next[kMaxHeight];
+  Node* before = head_;
+  for (int i = GetMaxHeight() - 1; i >= 0; i--) {
+    FindSpliceForLevel(key, before, i, &prev[i], &next[i]);
+    before = prev[i];
+  }
+
+  // Our data structure does not allow duplicate insertion
+  assert(next[0] == nullptr || !Equal(key, next[0]->key));
+
+  Node* x = NewNode(key, height, true);
+  for (int i = 0; i < height; i++) {
+    // Link bottom-up, as in Insert().  If another writer changed the
+    // splice at this level since we computed it, the CAS fails and we
+    // search again starting from prev[i], which still precedes key.
+    while (true) {
+      x->NoBarrier_SetNext(i, next[i]);
+      if (prev[i]->CASNext(i, next[i], x)) {
+        break;
+      }
+      FindSpliceForLevel(key, prev[i], i, &prev[i], &next[i]);
+    }
   }
 }
 
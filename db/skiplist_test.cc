@@ -125,6 +125,62 @@ TEST(SkipTest, InsertAndLookup) {
   }
 }
 
+// Checks that list holds exactly the keys of model, using both the
+// lowest level (iteration) and the upper levels (Seek).
+static void CheckContents(const SkipList<Key, Comparator>& list,
+                          const std::set<Key>& model) {
+  SkipList<Key, Comparator>::Iterator iter(&list);
+  iter.SeekToFirst();
+  for (Key k : model) {
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(k, iter.key());
+    iter.Next();
+  }
+  ASSERT_TRUE(!iter.Valid());
+  for (Key k : model) {
+    iter.Seek(k);
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(k, iter.key());
+    ASSERT_TRUE(list.Contains(k));
+    ASSERT_TRUE(!list.Contains(k + 1) || model.count(k + 1) == 1);
+  }
+}
+
+TEST(SkipTest, InsertPatterns) {
+  Arena arena;
+  Comparator cmp;
+  SkipList<Key, Comparator> list(cmp, &arena);
+  std::set<Key> model;
+  auto insert = [&](Key key) {
+    if (model.insert(key).second) {
+      list.Insert(key);
+    }
+  };
+
+  // Increasing keys, which reuse the previous splice.
+  for (Key k = 1000; k < 3000; k += 2) insert(k);
+  // Decreasing keys, which come before the previous splice.
+  for (int k = 999; k > 0; k -= 2) insert(k);
+  // Two interleaved increasing sequences.
+  for (Key k = 0; k < 1000; k++) {
+    insert(10000 + 2 * k);
+    insert(20000 + 2 * k);
+  }
+  // Keys that fill the gaps of earlier sequences.
+  for (Key k = 1001; k < 3000; k += 2) insert(k);
+  Random rnd(301);
+  for (int i = 0; i < 2000; i++) insert(rnd.Uniform(30000));
+  CheckContents(list, model);
+
+  // Inserts after concurrent inserts do not trust the old splice.
+  for (Key k = 30001; k < 30100; k += 2) {
+    model.insert(k);
+    list.InsertConcurrently(k);
+  }
+  for (Key k = 30000; k < 30100; k += 2) insert(k);
+  CheckContents(list, model);
+}
+
 // We want to make sure that with a single writer and multiple
 // concurrent readers (with no synchronization other than when a
 // reader's iterator is created), the reader always observes all the
@@ -365,4 +421,35 @@ TEST(SkipTest, Concurrent3) { RunConcurrent(3); }
 TEST(SkipTest, Concurrent4) { RunConcurrent(4); }
 TEST(SkipTest, Concurrent5) { RunConcurrent(5); }
 
+// Several threads calling InsertConcurrently() on the same list.
+static const int kInsertThreads = 4;
+static const int kKeysPerInsertThread = 20000;
+
+static void ConcurrentInserter(void* arg, int id) {
+  SkipList<Key, Comparator>* list =
+      reinterpret_cast<SkipList<Key, Comparator>*>(arg);
+  // Interleave the keys of all threads so that their splices collide.
+  for (int i = 0; i < kKeysPerInsertThread; i++) {
+    list->InsertConcurrently(static_cast<Key>(i) * kInsertThreads + id);
+  }
+}
+
+TEST(SkipTest, InsertConcurrently) {
+  Arena arena;
+  SkipList<Key, Comparator> list(Comparator(), &arena);
+  test::RunConcurrently(kInsertThreads, ConcurrentInserter, &list);
+
+  const Key total = static_cast<Key>(kInsertThreads) * kKeysPerInsertThread;
+  SkipList<Key, Comparator>::Iterator iter(&list);
+  iter.SeekToFirst();
+  for (Key k = 0; k < total; k++) {
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(k, iter.key());
+    iter.Next();
+  }
+  ASSERT_TRUE(!iter.Valid());
+  ASSERT_TRUE(list.Contains(total - 1));
+  ASSERT_TRUE(!list.Contains(total));
+}
+
 }  // namespace leveldb
@@ -4,6 +4,8 @@
 
 #include "db/table_cache.h"
 
+#include <vector>
+
 #include "db/filename.h"
 #include "leveldb/env.h"
 #include "leveldb/table.h"
@@ -29,17 +31,25 @@ static void UnrefEntry(void* arg1, void* arg2) {
   cache->Release(h);
 }
 
+// A row cache entry is the found internal key, length-prefixed, followed
+// by the found value.
+static void DeleteRow(const Slice& key, void* value) {
+  delete reinterpret_cast<std::string*>(value);
+}
+
 TableCache::TableCache(const std::string& dbname, const Options& options,
                        int entries)
     : env_(options.env),
       dbname_(dbname),
       options_(options),
-      cache_(NewLRUCache(entries)) {}
+      cache_(NewLRUCache(entries)),
+      row_cache_id_(options.row_cache != nullptr ? options.row_cache->NewId()
+                                                 : 0) {}
 
 TableCache::~TableCache() { delete cache_; }
 
 Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
-                             Cache::Handle** handle) {
+                             Cache::Handle** handle, int level) {
   Status s;
   char buf[sizeof(file_number)];
   EncodeFixed64(buf, file_number);
@@ -72,18 +82,25 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
       *handle = cache_->Insert(key, tf, 1, &DeleteEntry);
     }
   }
+  if (s.ok() && level == 0 &&
+      options_.pin_l0_filter_and_index_blocks_in_cache) {
+    // Tables stay pinned until they are closed, even if the file has
+    // left level 0 by then.
+    reinterpret_cast<TableAndFile*>(cache_->Value(*handle))
+        ->table->PinIndexAndFilters();
+  }
   return s;
 }
 
 Iterator* TableCache::NewIterator(const ReadOptions& options,
                                   uint64_t file_number, uint64_t file_size,
-                                  Table** tableptr) {
+                                  Table** tableptr, int level) {
   if (tableptr != nullptr) {
     *tableptr = nullptr;
   }
 
   Cache::Handle* handle = nullptr;
-  Status s = FindTable(file_number, file_size, &handle);
+  Status s = FindTable(file_number, file_size, &handle, level);
   if (!s.ok()) {
     return NewErrorIterator(s);
   }
@@ -97,20 +114,228 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
   return result;
 }
 
+bool TableCache::UseRowCache(const ReadOptions& options) const {
+  // A read without a snapshot reads at the latest sequence number, which
+  // is at least that of every entry in every table file, so it always
+  // finds the newest entry of the file for a key.  The row cache holds
+  // just that entry.
+  return options_.row_cache != nullptr && options.snapshot == nullptr;
+}
+
+std::string TableCache::RowCacheKey(uint64_t file_number,
+                                    const Slice& user_key) const {
+  std::string key;
+  key.reserve(2 * sizeof(uint64_t) + user_key.size());
+  PutFixed64(&key, row_cache_id_);
+  PutFixed64(&key, file_number);
+  key.append(user_key.data(), user_key.size());
+  return key;
+}
+
+bool TableCache::LookupRow(uint64_t file_number, const Slice& k, void* arg,
+                           void (*handle_result)(void*, const Slice&,
+                                                 const Slice&)) {
+  Cache* const row_cache = options_.row_cache;
+  Cache::Handle* handle =
+      row_cache->Lookup(RowCacheKey(file_number, ExtractUserKey(k)));
+  if (handle == nullptr) {
+    return false;
+  }
+  Slice row(*reinterpret_cast<std::string*>(row_cache->Value(handle)));
+  Slice found_key;
+  bool ok = GetLengthPrefixedSlice(&row, &found_key);
+  assert(ok);
+  (void)ok;
+  (*handle_result)(arg, found_key, row);
+  row_cache->Release(handle);
+  return true;
+}
+
+void TableCache::InsertRow(uint64_t file_number, const Slice& k,
+                           const Slice& found_key, const Slice& found_value) {
+  // The table only returns the first entry at or after k, which may
+  // belong to another user key.  Lookups of keys that are not in the
+  // table are not cached.
+  ParsedInternalKey parsed;
+  const Slice user_key = ExtractUserKey(k);
+  if (!ParseInternalKey(found_key, &parsed) || parsed.user_key != user_key) {
+    return;
+  }
+  std::string* row = new std::string;
+  PutLengthPrefixedSlice(row, found_key);
+  row->append(found_value.data(), found_value.size());
+  const std::string key = RowCacheKey(file_number, user_key);
+  Cache* const row_cache = options_.row_cache;
+  row_cache->Release(
+      row_cache->Insert(key, row, key.size() + row->size(), &DeleteRow));
+}
+
 Status TableCache::Get(const ReadOptions& options, uint64_t file_number,
                        uint64_t file_size, const Slice& k, void* arg,
                        void (*handle_result)(void*, const Slice&,
-                                             const Slice&)) {
+                                             const Slice&),
+                       int level) {
+  const bool use_row_cache = UseRowCache(options);
+  if (use_row_cache && LookupRow(file_number, k, arg, handle_result)) {
+    return Status::OK();
+  }
+
+  // Passes the entry found in the table on to handle_result, adding it
+  // to the row cache on the way.
+  struct RowSaver {
+    TableCache* table_cache;
+    uint64_t file_number;
+    Slice k;
+    void* arg;
+    void (*handle_result)(void*, const Slice&, const Slice&);
+
+    static void Save(void* arg, const Slice& found_key,
+                     const Slice& found_value) {
+      RowSaver* saver = reinterpret_cast<RowSaver*>(arg);
+      saver->table_cache->InsertRow(saver->file_number, saver->k, found_key,
+                                    found_value);
+      (*saver->handle_result)(saver->arg, found_key, found_value);
+    }
+  };
+  RowSaver saver = {this, file_number, k, arg, handle_result};
+
   Cache::Handle* handle = nullptr;
-  Status s = FindTable(file_number, file_size, &handle);
+  Status s = FindTable(file_number, file_size, &handle, level);
   if (s.ok()) {
     Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
-    s = t->InternalGet(options, k, arg, handle_result);
+    if (use_row_cache && options.fill_cache) {
+      s = t->InternalGet(options, k, &saver, &RowSaver::Save);
+    } else {
+      s = t->InternalGet(options, k, arg, handle_result);
+    }
     cache_->Release(handle);
   }
   return s;
 }
 
+void TableCache::MultiGet(const ReadOptions& options, FileLookup* lookups,
+                          int num_lookups) {
+  // Passes the entries found for keys[index[i]] on to handle_result as
+  // the entries of key index[i], adding them to the row cache on the way
+  // if insert is set.
+  struct RowSaver {
+    TableCache* table_cache;
+    uint64_t file_number;
+    const Slice* keys;
+    const int* index;
+    bool insert;
+    void* arg;
+    void (*handle_result)(void*, int, const Slice&, const Slice&);
+    int current;  // The key whose row cache entry is being replayed
+
+    static void Save(void* arg, int i, const Slice& found_key,
+                     const Slice& found_value) {
+      RowSaver* saver = reinterpret_cast<RowSaver*>(arg);
+      const int key_index = saver->index[i];
+      if (saver->insert) {
+        saver->table_cache->InsertRow(saver->file_number,
+                                      saver->keys[key_index], found_key,
+                                      found_value);
+      }
+      (*saver->handle_result)(saver->arg, key_index, found_key, found_value);
+    }
+
+    static void Replay(void* arg, const Slice& found_key,
+                       const Slice& found_value) {
+      RowSaver* saver = reinterpret_cast<RowSaver*>(arg);
+      (*saver->handle_result)(saver->arg, saver->current, found_key,
+                              found_value);
+    }
+  };
+
+  // The part of a lookup that is left once the row cache has been
+  // consulted, between starting and finishing it in the table.
+  struct PendingLookup {
+    RowSaver saver;
+    std::vector<int> missed;
+    std::vector<Slice> missed_keys;
+    Cache::Handle* handle;
+    Table* table;
+    Table::MultiGetState* state;
+  };
+  std::vector<PendingLookup> pending(num_lookups);
+  std::vector<const RandomAccessFile*> files;
+  std::vector<ReadRequest> reqs;
+  const bool use_row_cache = UseRowCache(options);
+  for (int l = 0; l < num_lookups; l++) {
+    FileLookup* lookup = &lookups[l];
+    PendingLookup* p = &pending[l];
+    p->saver = {this,  lookup->file_number, lookup->keys,
+                nullptr, false, lookup->arg,
+                lookup->handle_result, 0};
+    p->state = nullptr;
+    if (use_row_cache) {
+      for (int i = 0; i < lookup->n; i++) {
+        p->saver.current = i;
+        if (!LookupRow(lookup->file_number, lookup->keys[i], &p->saver,
+                       &RowSaver::Replay)) {
+          p->missed.push_back(i);
+          p->missed_keys.push_back(lookup->keys[i]);
+        }
+      }
+      if (p->missed.empty()) {
+        lookup->status = Status::OK();
+        continue;
+      }
+      p->saver.index = p->missed.data();
+      p->saver.insert = options.fill_cache;
+    }
+
+    lookup->status = FindTable(lookup->file_number, lookup->file_size,
+                               &p->handle, lookup->level);
+    if (!lookup->status.ok()) {
+      continue;
+    }
+    p->table = reinterpret_cast<TableAndFile*>(cache_->Value(p->handle))->table;
+    if (use_row_cache) {
+      p->state = p->table->StartMultiGet(
+          options, static_cast<int>(p->missed.size()), p->missed_keys.data(),
+          &files, &reqs);
+    } else {
+      p->state = p->table->StartMultiGet(options, lookup->n, lookup->keys,
+                                         &files, &reqs);
+    }
+  }
+
+  if (!reqs.empty()) {
+    env_->MultiRead(files.data(), reqs.data(), reqs.size());
+  }
+
+  for (int l = 0; l < num_lookups; l++) {
+    FileLookup* lookup = &lookups[l];
+    PendingLookup* p = &pending[l];
+    if (p->state == nullptr) {
+      continue;
+    }
+    if (use_row_cache) {
+      lookup->status = p->table->FinishMultiGet(p->state, options, reqs.data(),
+                                                &p->saver, &RowSaver::Save);
+    } else {
+      lookup->status =
+          p->table->FinishMultiGet(p->state, options, reqs.data(), lookup->arg,
+                                   lookup->handle_result);
+    }
+    cache_->Release(p->handle);
+  }
+}
+
+bool TableCache::PrefixMayMatch(uint64_t file_number, uint64_t file_size,
+                                const Slice& k) {
+  Cache::Handle* handle = nullptr;
+  if (!FindTable(file_number, file_size, &handle).ok()) {
+    return true;  // Let the read report the error
+  }
+  Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+  const bool result = t->PrefixMayMatch(k);
+  cache_->Release(handle);
+  return result;
+}
+
 void TableCache::Evict(uint64_t file_number) {
   char buf[sizeof(file_number)];
   EncodeFixed64(buf, file_number);
@@ -35,25 +35,74 @@ class TableCache {
   // underlies the returned iterator.  The returned "*tableptr" object is owned
   // by the cache and should not be deleted, and is valid for as long as the
   // returned iterator is live.
+  //
+  // "level" is the level of the file, or -1 if unknown.  The index and
+  // filter blocks of tables read as level-0 files are pinned in the block
+  // cache if options_.pin_l0_filter_and_index_blocks_in_cache is set.
   Iterator* NewIterator(const ReadOptions& options, uint64_t file_number,
-                        uint64_t file_size, Table** tableptr = nullptr);
+                        uint64_t file_size, Table** tableptr = nullptr,
+                        int level = -1);
 
   // If a seek to internal key "k" in specified file finds an entry,
   // call (*handle_result)(arg, found_key, found_value).
+  //
+  // If options_.row_cache is set and "options" does not name a snapshot,
+  // entries found for the user key of "k" are kept in the row cache and
+  // later calls for the same file and user key are answered from it.
   Status Get(const ReadOptions& options, uint64_t file_number,
              uint64_t file_size, const Slice& k, void* arg,
-             void (*handle_result)(void*, const Slice&, const Slice&));
+             void (*handle_result)(void*, const Slice&, const Slice&),
+             int level = -1);
+
+  // A lookup of keys[0,n-1], which must be in increasing order, in one
+  // file by MultiGet().  The handler is called as Get() would call it for
+  // each key, except that it is passed the index of the key.
+  struct FileLookup {
+    uint64_t file_number;
+    uint64_t file_size;
+    int level;
+    int n;
+    const Slice* keys;
+    void* arg;
+    void (*handle_result)(void*, int, const Slice&, const Slice&);
+    Status status;  // Set by MultiGet()
+  };
+
+  // Performs each of lookups[0,num_lookups-1] and sets its status.  Each
+  // table is looked up once for all of its keys, and the data blocks
+  // missing from the block cache are read from all of the tables with a
+  // single Env::MultiRead().
+  void MultiGet(const ReadOptions& options, FileLookup* lookups,
+                int num_lookups);
+
+  // Returns false if the prefix filter of the specified file rules out
+  // keys with the prefix of internal key "k".
+  bool PrefixMayMatch(uint64_t file_number, uint64_t file_size,
+                      const Slice& k);
 
   // Evict any entry for the specified file number
   void Evict(uint64_t file_number);
 
  private:
-  Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
+  Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**,
+                   int level = -1);
+
+  bool UseRowCache(const ReadOptions& options) const;
+  std::string RowCacheKey(uint64_t file_number, const Slice& user_key) const;
+  // If the row cache has an entry for the user key of internal key "k",
+  // pass it to handler and return true.
+  bool LookupRow(uint64_t file_number, const Slice& k, void* arg,
+                 void (*handle_result)(void*, const Slice&, const Slice&));
+  // Adds found_key/found_value, the entry found for internal key "k", to
+  // the row cache if it is an entry for the user key of "k".
+  void InsertRow(uint64_t file_number, const Slice& k, const Slice& found_key,
+                 const Slice& found_value);
 
   Env* const env_;
   const std::string dbname_;
   const Options& options_;
   Cache* cache_;
+  const uint64_t row_cache_id_;  // Keeps our row cache keys apart
 };
 
 }  // namespace leveldb
@@ -0,0 +1,91 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A MemTableRep that appends entries to an unsorted array.  The array is
+// sorted in place the first time it is iterated over after an insert, and
+// every iterator gets a copy of the sorted array, so that it is not
+// affected by later inserts.  Lookups scan the array unless it is sorted.
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "db/memtablerep.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+namespace {
+
+class VectorRep : public MemTableRep {
+ public:
+  VectorRep(const MemTableKeyComparator& cmp, Arena* arena)
+      : MemTableRep(arena), compare_(cmp), sorted_(true), memory_usage_(0) {}
+
+  void Insert(const char* entry) override {
+    MutexLock l(&mu_);
+    entries_.push_back(entry);
+    sorted_ = false;
+    memory_usage_.store(entries_.capacity() * sizeof(const char*),
+                        std::memory_order_relaxed);
+  }
+
+  void InsertConcurrently(const char* entry) override { Insert(entry); }
+
+  const char* Lookup(const char* key) const override {
+    MutexLock l(&mu_);
+    if (sorted_) {
+      auto iter = std::lower_bound(entries_.begin(), entries_.end(), key,
+                                   [this](const char* a, const char* b) {
+                                     return compare_(a, b) < 0;
+                                   });
+      return iter == entries_.end() ? nullptr : *iter;
+    }
+    const char* result = nullptr;
+    for (const char* entry : entries_) {
+      if (compare_(entry, key) >= 0 &&
+          (result == nullptr || compare_(entry, result) < 0)) {
+        result = entry;
+      }
+    }
+    return result;
+  }
+
+  Iterator* NewIterator() const override {
+    std::vector<const char*> entries;
+    {
+      MutexLock l(&mu_);
+      if (!sorted_) {
+        std::sort(entries_.begin(), entries_.end(),
+                  [this](const char* a, const char* b) {
+                    return compare_(a, b) < 0;
+                  });
+        sorted_ = true;
+      }
+      entries = entries_;
+    }
+    return NewSortedArrayIterator(compare_, &entries);
+  }
+
+  size_t ApproximateMemoryUsage() const override {
+    return memory_usage_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  const MemTableKeyComparator& compare_;
+  mutable port::Mutex mu_;
+  mutable std::vector<const char*> entries_ GUARDED_BY(mu_);
+  mutable bool sorted_ GUARDED_BY(mu_);
+  std::atomic<size_t> memory_usage_;  // Bytes allocated by entries_
+};
+
+}  // namespace
+
+MemTableRep* NewVectorRep(const MemTableKeyComparator& cmp, Arena* arena) {
+  return new VectorRep(cmp, arena);
+}
+
+}  // namespace leveldb
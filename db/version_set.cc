@@ -219,11 +219,86 @@ static Iterator* GetFileIterator(void* arg, const ReadOptions& options,
   }
 }
 
+namespace {
+
+// Wraps the iterator over a level > 0 in prefix seek mode.  The keys at
+// or after a Seek() target are in the first file whose largest key is
+// at or after it, or in later files.  If the prefix filter of that file
+// rules out the prefix of the target, its largest key is after all keys
+// with the prefix, so no file of the level has any of them and the level
+// is skipped without reading any blocks.
+class LevelPrefixSeekIterator : public Iterator {
+ public:
+  LevelPrefixSeekIterator(const InternalKeyComparator& icmp,
+                          const std::vector<FileMetaData*>* flist,
+                          TableCache* table_cache, Iterator* iter)
+      : icmp_(icmp),
+        flist_(flist),
+        table_cache_(table_cache),
+        iter_(iter),
+        ruled_out_(false) {}
+
+  ~LevelPrefixSeekIterator() override { delete iter_; }
+
+  bool Valid() const override { return !ruled_out_ && iter_->Valid(); }
+  void Seek(const Slice& target) override {
+    const size_t index = FindFile(icmp_, *flist_, target);
+    ruled_out_ = index < flist_->size() &&
+                 !table_cache_->PrefixMayMatch((*flist_)[index]->number,
+                                               (*flist_)[index]->file_size,
+                                               target);
+    if (!ruled_out_) {
+      iter_->Seek(target);
+    }
+  }
+  void SeekToFirst() override {
+    ruled_out_ = false;
+    iter_->SeekToFirst();
+  }
+  void SeekToLast() override {
+    ruled_out_ = false;
+    iter_->SeekToLast();
+  }
+  void Next() override {
+    assert(Valid());
+    iter_->Next();
+  }
+  void Prev() override {
+    assert(Valid());
+    iter_->Prev();
+  }
+  Slice key() const override {
+    assert(Valid());
+    return iter_->key();
+  }
+  Slice value() const override {
+    assert(Valid());
+    return iter_->value();
+  }
+  Status status() const override { return iter_->status(); }
+
+ private:
+  const InternalKeyComparator icmp_;
+  const std::vector<FileMetaData*>* const flist_;
+  TableCache* const table_cache_;
+  Iterator* const iter_;
+  bool ruled_out_;  // The last Seek() was ruled out by a prefix filter
+};
+
+}  // namespace
+
 Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
                                             int level) const {
-  return NewTwoLevelIterator(
+  Iterator* iter = NewTwoLevelIterator(
       new LevelFileNumIterator(vset_->icmp_, &files_[level]), &GetFileIterator,
       vset_->table_cache_, options);
+  const Options* db_options = vset_->options_;
+  if (options.prefix_same_as_start && db_options->prefix_extractor != nullptr &&
+      db_options->filter_policy != nullptr) {
+    iter = new LevelPrefixSeekIterator(vset_->icmp_, &files_[level],
+                                       vset_->table_cache_, iter);
+  }
+  return iter;
 }
 
 void Version::AddIterators(const ReadOptions& options,
@@ -231,7 +306,7 @@ void Version::AddIterators(const ReadOptions& options,
   // Merge all level zero files together since they may overlap
   for (size_t i = 0; i < files_[0].size(); i++) {
     iters->push_back(vset_->table_cache_->NewIterator(
-        options, files_[0][i]->number, files_[0][i]->file_size));
+        options, files_[0][i]->number, files_[0][i]->file_size, nullptr, 0));
   }
 
   // For levels > 0, we can use a concatenating iterator that sequentially
@@ -353,7 +428,8 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
 
       state->s = state->vset->table_cache_->Get(*state->options, f->number,
                                                 f->file_size, state->ikey,
-                                                &state->saver, SaveValue);
+                                                &state->saver, SaveValue,
+                                                level);
       if (!state->s.ok()) {
         state->found = true;
         return false;
@@ -399,6 +475,177 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
   return state.found ? state.s : Status::NotFound(Slice());
 }
 
+// Callback from TableCache::MultiGet(); arg is the array of the savers of
+// the keys passed to it.
+static void SaveMultiValue(void* arg, int index, const Slice& ikey,
+                           const Slice& v) {
+  Saver* savers = reinterpret_cast<Saver*>(arg);
+  SaveValue(&savers[index], ikey, v);
+}
+
+void Version::MultiGet(const ReadOptions& options, int n,
+                       const LookupKey* const* keys,
+                       std::string* const* values, Status* const* statuses,
+                       GetStats* stats) {
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+
+  // The state of Get() for each key.
+  struct KeyState {
+    FileMetaData* last_file_read;
+    int last_file_read_level;
+    bool done;
+  };
+  std::vector<KeyState> state(n);
+  int num_done = 0;
+  for (int i = 0; i < n; i++) {
+    state[i].last_file_read = nullptr;
+    state[i].last_file_read_level = -1;
+    state[i].done = false;
+    stats[i].seek_file = nullptr;
+    stats[i].seek_file_level = -1;
+    *statuses[i] = Status::NotFound(Slice());
+  }
+
+  // The keys (indexes into keys) to search for in one file.  Each has a
+  // saver of its own, since level-0 files searched together may all hold
+  // entries for a key and only the newest one counts.
+  struct FileBatch {
+    FileMetaData* file;
+    std::vector<int> keys;
+    std::vector<Slice> internal_keys;
+    std::vector<Saver> savers;
+    std::vector<std::string> values;
+  };
+
+  // Searches the files of batches, which are in the order Get() would
+  // search them, with a single TableCache::MultiGet() and updates the
+  // state of the keys that are not done yet as Get() would.
+  auto search_files = [&](int level, std::vector<FileBatch>* batches) {
+    std::vector<TableCache::FileLookup> lookups(batches->size());
+    for (size_t b = 0; b < batches->size(); b++) {
+      FileBatch* batch = &(*batches)[b];
+      const size_t batch_size = batch->keys.size();
+      batch->internal_keys.resize(batch_size);
+      batch->savers.resize(batch_size);
+      batch->values.resize(batch_size);
+      for (size_t j = 0; j < batch_size; j++) {
+        const LookupKey* key = keys[batch->keys[j]];
+        batch->internal_keys[j] = key->internal_key();
+        Saver* saver = &batch->savers[j];
+        saver->state = kNotFound;
+        saver->ucmp = ucmp;
+        saver->user_key = key->user_key();
+        saver->value = &batch->values[j];
+      }
+      TableCache::FileLookup* lookup = &lookups[b];
+      lookup->file_number = batch->file->number;
+      lookup->file_size = batch->file->file_size;
+      lookup->level = level;
+      lookup->n = static_cast<int>(batch_size);
+      lookup->keys = batch->internal_keys.data();
+      lookup->arg = batch->savers.data();
+      lookup->handle_result = SaveMultiValue;
+    }
+    vset_->table_cache_->MultiGet(options, lookups.data(),
+                                  static_cast<int>(lookups.size()));
+
+    for (size_t b = 0; b < batches->size(); b++) {
+      FileBatch& batch = (*batches)[b];
+      const Status& s = lookups[b].status;
+      for (size_t j = 0; j < batch.keys.size(); j++) {
+        const int i = batch.keys[j];
+        KeyState* ks = &state[i];
+        if (ks->done) {
+          continue;  // Settled by a newer file
+        }
+        if (stats[i].seek_file == nullptr && ks->last_file_read != nullptr) {
+          // We have had more than one seek for this read.  Charge the 1st
+          // file.
+          stats[i].seek_file = ks->last_file_read;
+          stats[i].seek_file_level = ks->last_file_read_level;
+        }
+        ks->last_file_read = batch.file;
+        ks->last_file_read_level = level;
+
+        const Saver& saver = batch.savers[j];
+        if (!s.ok() && saver.state == kNotFound) {
+          *statuses[i] = s;
+          ks->done = true;
+        } else if (saver.state == kFound) {
+          values[i]->swap(batch.values[j]);
+          *statuses[i] = Status::OK();
+          ks->done = true;
+        } else if (saver.state == kDeleted) {
+          ks->done = true;
+        } else if (saver.state == kCorrupt) {
+          *statuses[i] =
+              Status::Corruption("corrupted key for ", saver.user_key);
+          ks->done = true;
+        }
+        if (ks->done) {
+          num_done++;
+        }
+      }
+    }
+  };
+
+  std::vector<FileBatch> batches;
+
+  // Search all of the level-0 files that may hold some of the keys
+  // together, taking their results from newest to oldest.
+  std::vector<FileMetaData*> level0(files_[0]);
+  std::sort(level0.begin(), level0.end(), NewestFirst);
+  for (FileMetaData* f : level0) {
+    FileBatch batch;
+    batch.file = f;
+    for (int i = 0; i < n; i++) {
+      const Slice user_key = keys[i]->user_key();
+      if (ucmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
+          ucmp->Compare(user_key, f->largest.user_key()) <= 0) {
+        batch.keys.push_back(i);
+      }
+    }
+    if (!batch.keys.empty()) {
+      batches.push_back(std::move(batch));
+    }
+  }
+  if (!batches.empty()) {
+    search_files(0, &batches);
+  }
+
+  // Search the files of each other level together.  Files of a level are
+  // sorted and disjoint, so each key is in at most one of them and the
+  // keys searched in a file are consecutive in keys.
+  for (int level = 1; level < config::kNumLevels; level++) {
+    if (num_done == n) {
+      return;
+    }
+    const std::vector<FileMetaData*>& files = files_[level];
+    if (files.empty()) continue;
+
+    batches.clear();
+    for (int i = 0; i < n; i++) {
+      if (state[i].done) continue;
+
+      // Binary search to find earliest index whose largest key >= key.
+      uint32_t index = FindFile(vset_->icmp_, files, keys[i]->internal_key());
+      if (index >= files.size() ||
+          ucmp->Compare(keys[i]->user_key(),
+                        files[index]->smallest.user_key()) < 0) {
+        continue;  // No file of this level can hold the key
+      }
+      if (batches.empty() || batches.back().file != files[index]) {
+        batches.emplace_back();
+        batches.back().file = files[index];
+      }
+      batches.back().keys.push_back(i);
+    }
+    if (!batches.empty()) {
+      search_files(level, &batches);
+    }
+  }
+}
+
 bool Version::UpdateStats(const GetStats& stats) {
   FileMetaData* f = stats.seek_file;
   if (f != nullptr) {
@@ -903,7 +1150,7 @@ Status VersionSet::Recover(bool* save_manifest) {
     LogReporter reporter;
     reporter.status = &s;
     log::Reader reader(file, &reporter, true /*checksum*/,
-                       0 /*initial_offset*/);
+                       0 /*initial_offset*/, 0 /*log_number*/);
     Slice record;
     std::string scratch;
     while (reader.ReadRecord(&record, &scratch) && s.ok()) {
@@ -1064,6 +1311,30 @@ void VersionSet::Finalize(Version* v) {
 
   v->compaction_level_ = best_level;
   v->compaction_score_ = best_score;
+
+  // Estimate the pending compaction work.  Once level-0 reaches its
+  // compaction trigger all of its bytes will be merged into level-1.  Any
+  // bytes a level holds (including what it receives from the level
+  // above) beyond its limit get pushed down, rewriting about ten times
+  // as much data in the next level plus the bytes themselves.
+  uint64_t needed_bytes = 0;
+  uint64_t bytes_into_level = 0;
+  if (v->files_[0].size() >= config::kL0_CompactionTrigger) {
+    bytes_into_level = TotalFileSize(v->files_[0]);
+    needed_bytes += bytes_into_level;
+  }
+  for (int level = 1; level < config::kNumLevels - 1; level++) {
+    const uint64_t level_bytes =
+        TotalFileSize(v->files_[level]) + bytes_into_level;
+    const uint64_t max_bytes =
+        static_cast<uint64_t>(MaxBytesForLevel(options_, level));
+    bytes_into_level = 0;
+    if (level_bytes > max_bytes) {
+      bytes_into_level = level_bytes - max_bytes;
+      needed_bytes += bytes_into_level * 11;
+    }
+  }
+  v->estimated_compaction_needed_bytes_ = needed_bytes;
 }
 
 Status VersionSet::WriteSnapshot(log::Writer* log) {
@@ -1232,8 +1503,8 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
       if (c->level() + which == 0) {
         const std::vector<FileMetaData*>& files = c->inputs_[which];
         for (size_t i = 0; i < files.size(); i++) {
-          list[num++] = table_cache_->NewIterator(options, files[i]->number,
-                                                  files[i]->file_size);
+          list[num++] = table_cache_->NewIterator(
+              options, files[i]->number, files[i]->file_size, nullptr, 0);
         }
       } else {
         // Create concatenating iterator for the files from this level
@@ -75,6 +75,15 @@ class Version {
   Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
              GetStats* stats);
 
+  // Like calling Get(options, *keys[i], values[i], &stats[i]) and storing
+  // the result in statuses[i] for each i in [0,n-1], except that each
+  // table file is searched once for all of the keys that may be in it.
+  // REQUIRES: keys are sorted by user key
+  // REQUIRES: lock is not held
+  void MultiGet(const ReadOptions&, int n, const LookupKey* const* keys,
+                std::string* const* values, Status* const* statuses,
+                GetStats* stats);
+
   // Adds "stats" into the current state.  Returns true if a new
   // compaction may need to be triggered, false otherwise.
   // REQUIRES: lock is held
@@ -128,7 +137,8 @@ class Version {
         file_to_compact_(nullptr),
         file_to_compact_level_(-1),
         compaction_score_(-1),
-        compaction_level_(-1) {}
+        compaction_level_(-1),
+        estimated_compaction_needed_bytes_(0) {}
 
   Version(const Version&) = delete;
   Version& operator=(const Version&) = delete;
@@ -162,6 +172,10 @@ class Version {
   // are initialized by Finalize().
   double compaction_score_;
   int compaction_level_;
+
+  // Estimate of the bytes compactions must rewrite before every level is
+  // back under its size limit.  Initialized by Finalize().
+  uint64_t estimated_compaction_needed_bytes_;
 };
 
 class VersionSet {
@@ -208,6 +222,13 @@ class VersionSet {
   // Return the combined file size of all files at the specified level.
   int64_t NumLevelBytes(int level) const;
 
+  // Return an estimate of the number of bytes compactions have to
+  // rewrite before every level of the current version is within its
+  // size limit.
+  uint64_t EstimatedCompactionNeededBytes() const {
+    return current_->estimated_compaction_needed_bytes_;
+  }
+
   // Return the last sequence number.
   uint64_t LastSequence() const { return last_sequence_; }
 
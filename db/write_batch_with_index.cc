@@ -0,0 +1,430 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// The index is a skiplist of IndexEntry objects, each of which refers to
+// the key of one update stored in the batch's rep_.  Entries are ordered
+// by key and then from the newest update to the oldest, so the first
+// entry at or after a key is the update that is in effect for it.
+
+#include "leveldb/write_batch_with_index.h"
+
+#include <cstdint>
+
+#include "db/dbformat.h"
+#include "db/skiplist.h"
+#include "db/write_batch_internal.h"
+#include "leveldb/comparator.h"
+#include "leveldb/db.h"
+#include "leveldb/iterator.h"
+#include "leveldb/write_batch.h"
+#include "util/arena.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+namespace {
+
+struct IndexEntry {
+  size_t key_offset;  // Offset of the key in the batch contents
+  size_t key_size;
+  uint32_t index;  // Updates made later have larger indexes
+  ValueType type;
+  // If non-null, this is a search key that compares as the newest update
+  // of *search_key and the fields above are unused.
+  const Slice* search_key;
+};
+
+class IndexComparator {
+ public:
+  IndexComparator(const Comparator* comparator, const WriteBatch* batch)
+      : comparator_(comparator), batch_(batch) {}
+
+  int operator()(const IndexEntry* a, const IndexEntry* b) const {
+    int r = comparator_->Compare(Key(a), Key(b));
+    if (r == 0) {
+      if (a->index > b->index) {
+        r = -1;
+      } else if (a->index < b->index) {
+        r = +1;
+      }
+    }
+    return r;
+  }
+
+  Slice Key(const IndexEntry* entry) const {
+    if (entry->search_key != nullptr) {
+      return *entry->search_key;
+    }
+    // The batch contents may have been reallocated since the entry was
+    // made, so only offsets are kept.
+    return Slice(WriteBatchInternal::Contents(batch_).data() +
+                     entry->key_offset,
+                 entry->key_size);
+  }
+
+  // REQUIRES: entry->type == kTypeValue
+  Slice Value(const IndexEntry* entry) const {
+    Slice contents = WriteBatchInternal::Contents(batch_);
+    Slice input(contents.data() + entry->key_offset + entry->key_size,
+                contents.size() - entry->key_offset - entry->key_size);
+    Slice value;
+    bool ok = GetLengthPrefixedSlice(&input, &value);
+    assert(ok);
+    (void)ok;
+    return value;
+  }
+
+ private:
+  const Comparator* comparator_;
+  const WriteBatch* batch_;
+};
+
+typedef SkipList<const IndexEntry*, IndexComparator> BatchIndex;
+
+IndexEntry SearchEntry(const Slice* key) {
+  IndexEntry entry;
+  entry.key_offset = 0;
+  entry.key_size = 0;
+  entry.index = UINT32_MAX;
+  entry.type = kTypeValue;
+  entry.search_key = key;
+  return entry;
+}
+
+// Iterates over the updates in effect for each key of a batch, including
+// deletions.
+class BatchIndexIterator {
+ public:
+  BatchIndexIterator(const BatchIndex* index, const Comparator* comparator,
+                     const IndexComparator& cmp)
+      : iter_(index), comparator_(comparator), cmp_(cmp) {}
+
+  bool Valid() const { return iter_.Valid(); }
+  Slice key() const { return cmp_.Key(iter_.key()); }
+  Slice value() const { return cmp_.Value(iter_.key()); }
+  bool IsDeletion() const { return iter_.key()->type == kTypeDeletion; }
+
+  void SeekToFirst() { iter_.SeekToFirst(); }
+  void SeekToLast() {
+    iter_.SeekToLast();
+    MoveToNewest();
+  }
+  void Seek(const Slice& target) {
+    IndexEntry search = SearchEntry(&target);
+    iter_.Seek(&search);
+  }
+  // Position at the last key <= target.
+  void SeekForPrev(const Slice& target) {
+    Seek(target);
+    if (!iter_.Valid()) {
+      SeekToLast();
+    } else if (comparator_->Compare(key(), target) > 0) {
+      Prev();
+    }
+  }
+  void Next() {
+    // Skip the older updates of the current key.
+    const Slice current = key();
+    do {
+      iter_.Next();
+    } while (iter_.Valid() && comparator_->Compare(key(), current) == 0);
+  }
+  void Prev() {
+    iter_.Prev();
+    MoveToNewest();
+  }
+
+ private:
+  // Moves from any update of a key to its newest one.
+  void MoveToNewest() {
+    if (iter_.Valid()) {
+      Slice current = key();
+      IndexEntry search = SearchEntry(&current);
+      iter_.Seek(&search);
+    }
+  }
+
+  BatchIndex::Iterator iter_;
+  const Comparator* const comparator_;
+  const IndexComparator cmp_;
+};
+
+// Merges a base iterator with the updates of a batch, letting the batch
+// override and delete the base's entries.
+class BaseDeltaIterator : public Iterator {
+ public:
+  BaseDeltaIterator(Iterator* base, const BatchIndex* index,
+                    const Comparator* comparator, const IndexComparator& cmp)
+      : base_(base),
+        delta_(index, comparator, cmp),
+        comparator_(comparator),
+        forward_(true),
+        current_at_base_(true),
+        equal_keys_(false) {}
+
+  BaseDeltaIterator(const BaseDeltaIterator&) = delete;
+  BaseDeltaIterator& operator=(const BaseDeltaIterator&) = delete;
+
+  ~BaseDeltaIterator() override { delete base_; }
+
+  bool Valid() const override {
+    return current_at_base_ ? base_->Valid() : delta_.Valid();
+  }
+
+  void SeekToFirst() override {
+    forward_ = true;
+    base_->SeekToFirst();
+    delta_.SeekToFirst();
+    UpdateCurrent();
+  }
+
+  void SeekToLast() override {
+    forward_ = false;
+    base_->SeekToLast();
+    delta_.SeekToLast();
+    UpdateCurrent();
+  }
+
+  void Seek(const Slice& target) override {
+    forward_ = true;
+    base_->Seek(target);
+    delta_.Seek(target);
+    UpdateCurrent();
+  }
+
+  void Next() override {
+    assert(Valid());
+    if (!forward_) {
+      // Move both children to the first entry >= key(), which leaves the
+      // current entry where it is.
+      std::string current = key().ToString();
+      forward_ = true;
+      base_->Seek(current);
+      delta_.Seek(current);
+      UpdateCurrent();
+    }
+    Advance();
+  }
+
+  void Prev() override {
+    assert(Valid());
+    if (forward_) {
+      // Move both children to the last entry <= key().
+      std::string current = key().ToString();
+      forward_ = false;
+      base_->Seek(current);
+      if (!base_->Valid()) {
+        base_->SeekToLast();
+      } else if (comparator_->Compare(base_->key(), current) > 0) {
+        base_->Prev();
+      }
+      delta_.SeekForPrev(current);
+      UpdateCurrent();
+    }
+    Advance();
+  }
+
+  Slice key() const override {
+    return current_at_base_ ? base_->key() : delta_.key();
+  }
+
+  Slice value() const override {
+    return current_at_base_ ? base_->value() : delta_.value();
+  }
+
+  Status status() const override { return base_->status(); }
+
+ private:
+  void AdvanceBase() {
+    if (forward_) {
+      base_->Next();
+    } else {
+      base_->Prev();
+    }
+  }
+
+  void AdvanceDelta() {
+    if (forward_) {
+      delta_.Next();
+    } else {
+      delta_.Prev();
+    }
+  }
+
+  void Advance() {
+    if (equal_keys_) {
+      AdvanceBase();
+      AdvanceDelta();
+    } else if (current_at_base_) {
+      AdvanceBase();
+    } else {
+      AdvanceDelta();
+    }
+    UpdateCurrent();
+  }
+
+  // Picks the child whose entry comes first in the current direction,
+  // skipping the deletions of the batch and the base entries they delete.
+  void UpdateCurrent() {
+    while (true) {
+      equal_keys_ = false;
+      if (!delta_.Valid()) {
+        current_at_base_ = true;
+        return;
+      }
+      if (!base_->Valid()) {
+        if (!delta_.IsDeletion()) {
+          current_at_base_ = false;
+          return;
+        }
+        AdvanceDelta();
+        continue;
+      }
+      int r = comparator_->Compare(delta_.key(), base_->key());
+      if (!forward_) {
+        r = -r;
+      }
+      if (r > 0) {
+        current_at_base_ = true;
+        return;
+      }
+      equal_keys_ = (r == 0);
+      if (!delta_.IsDeletion()) {
+        current_at_base_ = false;
+        return;
+      }
+      if (equal_keys_) {
+        AdvanceBase();
+      }
+      AdvanceDelta();
+    }
+  }
+
+  Iterator* const base_;
+  BatchIndexIterator delta_;
+  const Comparator* const comparator_;
+  bool forward_;
+  bool current_at_base_;
+  // True if base_ and delta_ are both at the current key (and the current
+  // entry is delta_'s).
+  bool equal_keys_;
+};
+
+}  // namespace
+
+struct WriteBatchWithIndex::Rep {
+  explicit Rep(const Comparator* cmp)
+      : comparator(cmp),
+        index_cmp(cmp, &batch),
+        arena(new Arena),
+        index(new BatchIndex(index_cmp, arena)),
+        count(0) {}
+
+  ~Rep() {
+    delete index;
+    delete arena;
+  }
+
+  // Indexes the update that was just appended to batch at offset.
+  void AddEntry(size_t offset, ValueType type, const Slice& key) {
+    IndexEntry* entry = reinterpret_cast<IndexEntry*>(
+        arena->AllocateAligned(sizeof(IndexEntry)));
+    entry->key_offset = offset + 1 + VarintLength(key.size());
+    entry->key_size = key.size();
+    entry->index = count++;
+    entry->type = type;
+    entry->search_key = nullptr;
+    index->Insert(entry);
+  }
+
+  // Returns the update in effect for key, or nullptr if the batch does
+  // not update key.
+  const IndexEntry* Find(const Slice& key) const {
+    IndexEntry search = SearchEntry(&key);
+    BatchIndex::Iterator iter(index);
+    iter.Seek(&search);
+    if (!iter.Valid() ||
+        comparator->Compare(index_cmp.Key(iter.key()), key) != 0) {
+      return nullptr;
+    }
+    return iter.key();
+  }
+
+  const Comparator* const comparator;
+  WriteBatch batch;
+  const IndexComparator index_cmp;
+  Arena* arena;
+  BatchIndex* index;
+  uint32_t count;
+};
+
+WriteBatchWithIndex::WriteBatchWithIndex(const Comparator* comparator)
+    : rep_(new Rep(comparator)) {}
+
+WriteBatchWithIndex::WriteBatchWithIndex()
+    : WriteBatchWithIndex(BytewiseComparator()) {}
+
+WriteBatchWithIndex::~WriteBatchWithIndex() { delete rep_; }
+
+void WriteBatchWithIndex::Put(const Slice& key, const Slice& value) {
+  const size_t offset = WriteBatchInternal::ByteSize(&rep_->batch);
+  rep_->batch.Put(key, value);
+  rep_->AddEntry(offset, kTypeValue, key);
+}
+
+void WriteBatchWithIndex::Delete(const Slice& key) {
+  const size_t offset = WriteBatchInternal::ByteSize(&rep_->batch);
+  rep_->batch.Delete(key);
+  rep_->AddEntry(offset, kTypeDeletion, key);
+}
+
+void WriteBatchWithIndex::Clear() {
+  rep_->batch.Clear();
+  delete rep_->index;
+  delete rep_->arena;
+  rep_->arena = new Arena;
+  rep_->index = new BatchIndex(rep_->index_cmp, rep_->arena);
+  rep_->count = 0;
+}
+
+WriteBatch* WriteBatchWithIndex::GetWriteBatch() { return &rep_->batch; }
+
+Status WriteBatchWithIndex::GetFromBatch(const Slice& key,
+                                         std::string* value) const {
+  const IndexEntry* entry = rep_->Find(key);
+  if (entry == nullptr || entry->type == kTypeDeletion) {
+    return Status::NotFound(Slice());
+  }
+  Slice v = rep_->index_cmp.Value(entry);
+  value->assign(v.data(), v.size());
+  return Status::OK();
+}
+
+Status WriteBatchWithIndex::GetFromBatchAndDB(DB* db,
+                                              const ReadOptions& options,
+                                              const Slice& key,
+                                              std::string* value) const {
+  const IndexEntry* entry = rep_->Find(key);
+  if (entry == nullptr) {
+    return db->Get(options, key, value);
+  }
+  if (entry->type == kTypeDeletion) {
+    return Status::NotFound(Slice());
+  }
+  Slice v = rep_->index_cmp.Value(entry);
+  value->assign(v.data(), v.size());
+  return Status::OK();
+}
+
+Iterator* WriteBatchWithIndex::NewIterator() const {
+  return NewIteratorWithBase(NewEmptyIterator());
+}
+
+Iterator* WriteBatchWithIndex::NewIteratorWithBase(
+    Iterator* base_iterator) const {
+  return new BaseDeltaIterator(base_iterator, rep_->index, rep_->comparator,
+                               rep_->index_cmp);
+}
+
+}  // namespace leveldb
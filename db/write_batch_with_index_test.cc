@@ -0,0 +1,251 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/write_batch_with_index.h"
+
+#include <map>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "helpers/memenv/memenv.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "leveldb/iterator.h"
+#include "leveldb/write_batch.h"
+#include "util/random.h"
+#include "util/testutil.h"
+
+namespace leveldb {
+
+class WriteBatchWithIndexTest : public testing::Test {
+ public:
+  WriteBatchWithIndexTest() : env_(NewMemEnv(Env::Default())), db_(nullptr) {
+    Options options;
+    options.env = env_;
+    options.create_if_missing = true;
+    EXPECT_LEVELDB_OK(DB::Open(options, "/dbwbwi", &db_));
+  }
+
+  ~WriteBatchWithIndexTest() {
+    delete db_;
+    delete env_;
+  }
+
+  // Returns the contents of iter, walked forward or backward.
+  static std::string Contents(Iterator* iter, bool forward) {
+    std::string result;
+    if (forward) {
+      for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        result += iter->key().ToString() + "=" + iter->value().ToString() + ",";
+      }
+    } else {
+      for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+        result += iter->key().ToString() + "=" + iter->value().ToString() + ",";
+      }
+    }
+    EXPECT_LEVELDB_OK(iter->status());
+    return result;
+  }
+
+  std::string Get(const WriteBatchWithIndex& batch, const std::string& key) {
+    std::string value;
+    Status s = batch.GetFromBatchAndDB(db_, ReadOptions(), key, &value);
+    if (s.IsNotFound()) {
+      return "NOT_FOUND";
+    }
+    EXPECT_LEVELDB_OK(s);
+    return value;
+  }
+
+  Iterator* NewMergedIterator(const WriteBatchWithIndex& batch) {
+    return batch.NewIteratorWithBase(db_->NewIterator(ReadOptions()));
+  }
+
+  Env* env_;
+  DB* db_;
+};
+
+TEST_F(WriteBatchWithIndexTest, Empty) {
+  WriteBatchWithIndex batch;
+  std::string value;
+  ASSERT_TRUE(batch.GetFromBatch("foo", &value).IsNotFound());
+  Iterator* iter = batch.NewIterator();
+  ASSERT_EQ("", Contents(iter, true));
+  ASSERT_EQ("", Contents(iter, false));
+  delete iter;
+}
+
+TEST_F(WriteBatchWithIndexTest, GetFromBatch) {
+  WriteBatchWithIndex batch;
+  batch.Put("a", "va");
+  batch.Put("b", "vb");
+  batch.Delete("a");
+  batch.Put("b", "vb2");
+  batch.Delete("c");
+  batch.Put("c", "vc");
+
+  std::string value;
+  ASSERT_TRUE(batch.GetFromBatch("a", &value).IsNotFound());
+  ASSERT_LEVELDB_OK(batch.GetFromBatch("b", &value));
+  ASSERT_EQ("vb2", value);
+  ASSERT_LEVELDB_OK(batch.GetFromBatch("c", &value));
+  ASSERT_EQ("vc", value);
+  ASSERT_TRUE(batch.GetFromBatch("d", &value).IsNotFound());
+
+  Iterator* iter = batch.NewIterator();
+  ASSERT_EQ("b=vb2,c=vc,", Contents(iter, true));
+  ASSERT_EQ("c=vc,b=vb2,", Contents(iter, false));
+  delete iter;
+
+  batch.Clear();
+  ASSERT_TRUE(batch.GetFromBatch("b", &value).IsNotFound());
+  iter = batch.NewIterator();
+  ASSERT_EQ("", Contents(iter, true));
+  delete iter;
+}
+
+TEST_F(WriteBatchWithIndexTest, GetFromBatchAndDB) {
+  ASSERT_LEVELDB_OK(db_->Put(WriteOptions(), "a", "db_a"));
+  ASSERT_LEVELDB_OK(db_->Put(WriteOptions(), "b", "db_b"));
+  ASSERT_LEVELDB_OK(db_->Put(WriteOptions(), "c", "db_c"));
+
+  WriteBatchWithIndex batch;
+  batch.Put("a", "batch_a");
+  batch.Delete("b");
+  batch.Put("d", "batch_d");
+  ASSERT_EQ("batch_a", Get(batch, "a"));
+  ASSERT_EQ("NOT_FOUND", Get(batch, "b"));
+  ASSERT_EQ("db_c", Get(batch, "c"));
+  ASSERT_EQ("batch_d", Get(batch, "d"));
+  ASSERT_EQ("NOT_FOUND", Get(batch, "e"));
+
+  // Applying the batch gives the DB the contents the batch predicted.
+  ASSERT_LEVELDB_OK(db_->Write(WriteOptions(), batch.GetWriteBatch()));
+  batch.Clear();
+  ASSERT_EQ("batch_a", Get(batch, "a"));
+  ASSERT_EQ("NOT_FOUND", Get(batch, "b"));
+  ASSERT_EQ("db_c", Get(batch, "c"));
+  ASSERT_EQ("batch_d", Get(batch, "d"));
+}
+
+TEST_F(WriteBatchWithIndexTest, IteratorWithBase) {
+  ASSERT_LEVELDB_OK(db_->Put(WriteOptions(), "a", "db_a"));
+  ASSERT_LEVELDB_OK(db_->Put(WriteOptions(), "c", "db_c"));
+  ASSERT_LEVELDB_OK(db_->Put(WriteOptions(), "e", "db_e"));
+
+  WriteBatchWithIndex batch;
+  batch.Put("b", "batch_b");
+  batch.Put("c", "batch_c");
+  batch.Delete("e");
+  batch.Delete("f");
+  batch.Put("g", "batch_g");
+
+  Iterator* iter = NewMergedIterator(batch);
+  ASSERT_EQ("a=db_a,b=batch_b,c=batch_c,g=batch_g,", Contents(iter, true));
+  ASSERT_EQ("g=batch_g,c=batch_c,b=batch_b,a=db_a,", Contents(iter, false));
+
+  iter->Seek("c");
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ("c", iter->key().ToString());
+  ASSERT_EQ("batch_c", iter->value().ToString());
+  iter->Seek("d");
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ("g", iter->key().ToString());
+  iter->Seek("h");
+  ASSERT_TRUE(!iter->Valid());
+
+  // Change directions in the middle.
+  iter->Seek("b");
+  iter->Next();
+  ASSERT_EQ("c", iter->key().ToString());
+  iter->Prev();
+  ASSERT_EQ("b", iter->key().ToString());
+  iter->Prev();
+  ASSERT_EQ("a", iter->key().ToString());
+  iter->Next();
+  ASSERT_EQ("b", iter->key().ToString());
+  iter->Next();
+  iter->Next();
+  ASSERT_EQ("g", iter->key().ToString());
+  iter->Prev();
+  ASSERT_EQ("c", iter->key().ToString());
+  delete iter;
+}
+
+TEST_F(WriteBatchWithIndexTest, Randomized) {
+  std::map<std::string, std::string> model;
+  Random rnd(301);
+  auto random_key = [&rnd]() {
+    return std::string(1, static_cast<char>('a' + rnd.Uniform(26))) +
+           std::string(1, static_cast<char>('a' + rnd.Uniform(4)));
+  };
+  for (int i = 0; i < 100; i++) {
+    std::string key = random_key();
+    std::string value = "db" + std::to_string(i);
+    ASSERT_LEVELDB_OK(db_->Put(WriteOptions(), key, value));
+    model[key] = value;
+  }
+
+  WriteBatchWithIndex batch;
+  for (int i = 0; i < 200; i++) {
+    std::string key = random_key();
+    if (rnd.OneIn(3)) {
+      batch.Delete(key);
+      model.erase(key);
+    } else {
+      std::string value = "batch" + std::to_string(i);
+      batch.Put(key, value);
+      model[key] = value;
+    }
+  }
+
+  std::string expected_forward, expected_backward;
+  for (const auto& kv : model) {
+    expected_forward += kv.first + "=" + kv.second + ",";
+  }
+  for (auto it = model.rbegin(); it != model.rend(); ++it) {
+    expected_backward += it->first + "=" + it->second + ",";
+  }
+  Iterator* iter = NewMergedIterator(batch);
+  ASSERT_EQ(expected_forward, Contents(iter, true));
+  ASSERT_EQ(expected_backward, Contents(iter, false));
+
+  // Random walks in both directions agree with the model.
+  for (int i = 0; i < 1000; i++) {
+    std::string target = random_key();
+    iter->Seek(target);
+    auto model_iter = model.lower_bound(target);
+    for (int step = 0; step < 5; step++) {
+      if (model_iter == model.end()) {
+        ASSERT_TRUE(!iter->Valid());
+        break;
+      }
+      ASSERT_TRUE(iter->Valid());
+      ASSERT_EQ(model_iter->first, iter->key().ToString());
+      ASSERT_EQ(model_iter->second, iter->value().ToString());
+      if (rnd.OneIn(2)) {
+        iter->Next();
+        ++model_iter;
+      } else {
+        iter->Prev();
+        if (model_iter == model.begin()) {
+          ASSERT_TRUE(!iter->Valid());
+          break;
+        }
+        --model_iter;
+      }
+    }
+  }
+  delete iter;
+
+  for (char c = 'a'; c <= 'z'; c++) {
+    for (char d = 'a'; d <= 'd'; d++) {
+      std::string key = {c, d};
+      auto it = model.find(key);
+      ASSERT_EQ(it == model.end() ? "NOT_FOUND" : it->second, Get(batch, key));
+    }
+  }
+}
+
+}  // namespace leveldb
@@ -0,0 +1,65 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/write_controller.h"
+
+#include <algorithm>
+
+namespace leveldb {
+
+static const uint64_t kMicrosPerSecond = 1000000;
+
+// Credit is refilled in steps of this many micros, which is also the
+// shortest delay handed out.
+static const uint64_t kMicrosPerRefill = 1000;
+
+WriteController::WriteController()
+    : delayed_write_rate_(0), next_refill_time_(0), credit_in_bytes_(0) {}
+
+void WriteController::set_delayed_write_rate(uint64_t rate) {
+  if (rate == 0) {
+    // Start from an empty bucket the next time writes are throttled.
+    next_refill_time_ = 0;
+    credit_in_bytes_ = 0;
+  }
+  delayed_write_rate_ = rate;
+}
+
+uint64_t WriteController::GetDelay(uint64_t now_micros, uint64_t num_bytes) {
+  if (delayed_write_rate_ == 0) {
+    return 0;
+  }
+  if (credit_in_bytes_ >= num_bytes) {
+    credit_in_bytes_ -= num_bytes;
+    return 0;
+  }
+
+  if (next_refill_time_ == 0) {
+    next_refill_time_ = now_micros;
+  }
+  if (next_refill_time_ <= now_micros) {
+    // Refill for the time elapsed since the last refill.
+    const uint64_t elapsed = now_micros - next_refill_time_ + kMicrosPerRefill;
+    credit_in_bytes_ += static_cast<uint64_t>(
+        static_cast<double>(elapsed) / kMicrosPerSecond * delayed_write_rate_ +
+        0.999999);
+    next_refill_time_ = now_micros + kMicrosPerRefill;
+    if (credit_in_bytes_ >= num_bytes) {
+      credit_in_bytes_ -= num_bytes;
+      return 0;
+    }
+  }
+
+  // Not enough credit: sleep long enough to earn the rest at the
+  // current rate.  The time is reserved by pushing out the next refill.
+  const uint64_t bytes_over_budget = num_bytes - credit_in_bytes_;
+  const uint64_t needed_delay = static_cast<uint64_t>(
+      static_cast<double>(bytes_over_budget) / delayed_write_rate_ *
+      kMicrosPerSecond);
+  credit_in_bytes_ = 0;
+  next_refill_time_ += needed_delay;
+  return std::max(next_refill_time_ - now_micros, kMicrosPerRefill);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,51 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+#define STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+
+#include <cstdint>
+
+namespace leveldb {
+
+// WriteController throttles writes to a target rate with a token bucket.
+// DBImpl uses it to slow writers down gradually when compactions fall
+// behind instead of stalling them abruptly.
+//
+// WriteController is not thread-safe; DBImpl only uses it while holding
+// its mutex.
+class WriteController {
+ public:
+  WriteController();
+
+  WriteController(const WriteController&) = delete;
+  WriteController& operator=(const WriteController&) = delete;
+
+  // Set the rate (in bytes per second) at which writes may proceed.  A
+  // rate of zero disables throttling.
+  void set_delayed_write_rate(uint64_t rate);
+
+  uint64_t delayed_write_rate() const { return delayed_write_rate_; }
+
+  // Return true iff writes are currently being throttled.
+  bool IsDelayed() const { return delayed_write_rate_ > 0; }
+
+  // Charge a write of "num_bytes" at time "now_micros" and return the
+  // number of microseconds the writer should sleep before proceeding.
+  // Returns zero if writes are not throttled or enough credit has
+  // accumulated.
+  uint64_t GetDelay(uint64_t now_micros, uint64_t num_bytes);
+
+ private:
+  uint64_t delayed_write_rate_;
+
+  // Token bucket state.  Credit is refilled at most once per refill
+  // interval, based on the time elapsed since the last refill.
+  uint64_t next_refill_time_;
+  uint64_t credit_in_bytes_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
@@ -0,0 +1,75 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/write_controller.h"
+
+#include "gtest/gtest.h"
+
+namespace leveldb {
+
+static const uint64_t kMB = 1024 * 1024;
+static const uint64_t kSecond = 1000000;
+
+TEST(WriteControllerTest, NotDelayed) {
+  WriteController controller;
+  ASSERT_FALSE(controller.IsDelayed());
+  ASSERT_EQ(0, controller.GetDelay(kSecond, 100 * kMB));
+}
+
+TEST(WriteControllerTest, DelayScalesWithBytes) {
+  WriteController controller;
+  controller.set_delayed_write_rate(kMB);
+  ASSERT_TRUE(controller.IsDelayed());
+
+  // The first write only earns a single refill of credit, so writing a
+  // full second worth of bytes has to wait about a second.
+  uint64_t now = kSecond;
+  uint64_t delay = controller.GetDelay(now, kMB);
+  ASSERT_GT(delay, kSecond - 2000);
+  ASSERT_LE(delay, kSecond);
+
+  // Writes issued before that time has passed queue up behind it.
+  ASSERT_GT(controller.GetDelay(now, kMB), delay + kSecond - 2000);
+}
+
+TEST(WriteControllerTest, CreditAccumulates) {
+  WriteController controller;
+  controller.set_delayed_write_rate(kMB);
+  uint64_t now = kSecond;
+  ASSERT_GT(controller.GetDelay(now, 64 * 1024), 0);
+
+  // After a quiet period the accumulated credit covers the write.
+  now += 2 * kSecond;
+  ASSERT_EQ(0, controller.GetDelay(now, kMB));
+  ASSERT_EQ(0, controller.GetDelay(now, kMB / 2));
+}
+
+TEST(WriteControllerTest, SustainedRate) {
+  WriteController controller;
+  controller.set_delayed_write_rate(4 * kMB);
+
+  // Writers that sleep for the returned delay should progress at the
+  // configured rate.
+  uint64_t now = kSecond;
+  const uint64_t start = now;
+  uint64_t written = 0;
+  while (written < 40 * kMB) {
+    now += controller.GetDelay(now, 64 * 1024);
+    written += 64 * 1024;
+  }
+  const double seconds = static_cast<double>(now - start) / kSecond;
+  ASSERT_GT(seconds, 9.5);
+  ASSERT_LT(seconds, 10.5);
+}
+
+TEST(WriteControllerTest, Reset) {
+  WriteController controller;
+  controller.set_delayed_write_rate(kMB);
+  ASSERT_GT(controller.GetDelay(kSecond, kMB), 0);
+  controller.set_delayed_write_rate(0);
+  ASSERT_FALSE(controller.IsDelayed());
+  ASSERT_EQ(0, controller.GetDelay(kSecond, kMB));
+}
+
+}  // namespace leveldb
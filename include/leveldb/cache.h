@@ -43,6 +43,12 @@ class LEVELDB_EXPORT Cache;
 // Cache 的这种实现使用 最近最少使用 (LRU) 的淘汰策略
 LEVELDB_EXPORT Cache* NewLRUCache(size_t capacity);
 
+// Like NewLRUCache(capacity), but reserves up to high_pri_pool_ratio of
+// the capacity for entries inserted with Cache::kHighPriority.  Those are
+// only evicted once no low priority entries are left, or when they are
+// pushed out of the pool by newer high priority entries.
+LEVELDB_EXPORT Cache* NewLRUCache(size_t capacity, double high_pri_pool_ratio);
+
 class LEVELDB_EXPORT Cache {
  public:
   Cache() = default;
@@ -59,6 +65,9 @@ class LEVELDB_EXPORT Cache {
   // 存储在 cache 中的条目的 不透明 句柄
   struct Handle {};
 
+  // Eviction priority of an entry.
+  enum Priority { kHighPriority, kLowPriority };
+
   // Insert a mapping from key->value into the cache and assign it
   // the specified charge against the total cache capacity.
   //
@@ -78,6 +87,13 @@ class LEVELDB_EXPORT Cache {
   virtual Handle* Insert(const Slice& key, void* value, size_t charge,
                          void (*deleter)(const Slice& key, void* value)) = 0;
 
+  // Like Insert() above, but the cache may keep entries of high priority
+  // longer than entries of low priority, which is what Insert() above
+  // inserts.  The default implementation ignores the priority.
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                         void (*deleter)(const Slice& key, void* value),
+                         Priority priority);
+
   // If the cache has no mapping for "key", returns nullptr.
   //
   // Else return a handle that corresponds to the mapping.  The caller
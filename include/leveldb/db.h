@@ -87,6 +87,15 @@ class LEVELDB_EXPORT DB {
   virtual Status Get(const ReadOptions& options, const Slice& key,
                      std::string* value) = 0;
 
+  // For each i in [0,n-1], look up keys[i] as Get(options, keys[i],
+  // &values[i]) would and store the result in statuses[i].  All of the
+  // keys are read from the same snapshot of the database, which makes
+  // this cheaper than n calls to Get().
+  //
+  // The default implementation calls Get() for each key.
+  virtual void MultiGet(const ReadOptions& options, int n, const Slice* keys,
+                        std::string* values, Status* statuses);
+
   // Return a heap-allocated iterator over the contents of the database.
   // The result of NewIterator() is initially invalid (caller must
   // call one of the Seek methods on the iterator before using it).
@@ -121,6 +130,12 @@ class LEVELDB_EXPORT DB {
   //     of the sstables that make up the db contents.
   //  "leveldb.approximate-memory-usage" - returns the approximate number of
   //     bytes of memory in use by the DB.
+  //  "leveldb.num-immutable-mem-table" - returns the number of memtables
+  //     that are full and waiting to be compacted.
+  //  "leveldb.write-group-stats" - returns a multi-line string that
+  //     describes the batch groups written to the log so far: how many
+  //     there were, their average number of writers and bytes, and the
+  //     time spent waiting for sync writers to join a group.
   virtual bool GetProperty(const Slice& property, std::string* value) = 0;
 
   // For each i in [0,n-1], store in "sizes[i]", the approximate
@@ -145,6 +160,14 @@ class LEVELDB_EXPORT DB {
   // Therefore the following call will compact the entire database:
   //    db->CompactRange(nullptr, nullptr);
   virtual void CompactRange(const Slice* begin, const Slice* end) = 0;
+
+  // Write the contents of the memtable to a table file and wait until
+  // it has been installed, so that every write that returned before the
+  // call survives a crash, including writes made with
+  // WriteOptions::disable_wal.
+  //
+  // The default implementation returns a NotSupported status.
+  virtual Status FlushMemTable();
 };
 
 // Destroy the contents of the specified database.
@@ -19,6 +19,7 @@
 #include <vector>
 
 #include "leveldb/export.h"
+#include "leveldb/slice.h"
 #include "leveldb/status.h"
 
 // This workaround can be removed when leveldb::Env::DeleteFile is removed.
@@ -44,8 +45,8 @@ namespace leveldb {
 class FileLock;
 class Logger;
 class RandomAccessFile;
+struct ReadRequest;
 class SequentialFile;
-class Slice;
 class WritableFile;
 
 class LEVELDB_EXPORT Env {
@@ -85,6 +86,19 @@ class LEVELDB_EXPORT Env {
   virtual Status NewRandomAccessFile(const std::string& fname,
                                      RandomAccessFile** result) = 0;
 
+  // Perform each of the reads in reqs[0,num_reqs-1] as a
+  // RandomAccessFile::MultiRead() of files[i] would perform reqs[i].
+  // Unlike that method, the reads may be of several files.
+  // Implementations may issue all of the reads in parallel.  Returns when
+  // all of the reads have completed.
+  //
+  // The default implementation calls MultiRead() on each run of
+  // consecutive requests of the same file.
+  //
+  // Safe for concurrent use by multiple threads.
+  virtual void MultiRead(const RandomAccessFile* const* files,
+                         ReadRequest* reqs, size_t num_reqs);
+
   // Create an object that writes to a new file with the specified
   // name.  Deletes any existing file with the same name and creates a
   // new file.  On success, stores a pointer to the new file in
@@ -110,6 +124,20 @@ class LEVELDB_EXPORT Env {
   virtual Status NewAppendableFile(const std::string& fname,
                                    WritableFile** result);
 
+  // Rename the existing file "old_fname" to "fname" and return an object
+  // that overwrites it in place, starting at offset zero.  Unlike
+  // NewWritableFile(), the old contents are not truncated, so space that
+  // is already allocated to the file can be reused.  Bytes past the
+  // last write keep their old values.
+  //
+  // The returned file will only be accessed by one thread at a time.
+  //
+  // The default implementation renames the file and then calls
+  // NewWritableFile(), which does truncate it.
+  virtual Status ReuseWritableFile(const std::string& fname,
+                                   const std::string& old_fname,
+                                   WritableFile** result);
+
   // Returns true iff the named file exists.
   virtual bool FileExists(const std::string& fname) = 0;
 
@@ -248,6 +276,19 @@ class LEVELDB_EXPORT SequentialFile {
   virtual Status Skip(uint64_t n) = 0;
 };
 
+// One of the reads made by RandomAccessFile::MultiRead() or
+// Env::MultiRead().
+struct LEVELDB_EXPORT ReadRequest {
+  // Inputs: read up to "n" bytes starting at "offset" into "scratch".
+  uint64_t offset = 0;
+  size_t n = 0;
+  char* scratch = nullptr;
+
+  // Outputs, as for RandomAccessFile::Read().
+  Slice result;
+  Status status;
+};
+
 // A file abstraction for randomly reading the contents of a file.
 class LEVELDB_EXPORT RandomAccessFile {
  public:
@@ -269,6 +310,17 @@ class LEVELDB_EXPORT RandomAccessFile {
   // Safe for concurrent use by multiple threads.
   virtual Status Read(uint64_t offset, size_t n, Slice* result,
                       char* scratch) const = 0;
+
+  // Perform each of the reads in reqs[0,num_reqs-1] as
+  // Read(req.offset, req.n, &req.result, req.scratch) would, storing the
+  // status of each read in req.status.  Implementations may issue the
+  // reads in parallel, so that the whole call takes about as long as the
+  // slowest read.  Returns when all of the reads have completed.
+  //
+  // The default implementation calls Read() for each request in turn.
+  //
+  // Safe for concurrent use by multiple threads.
+  virtual void MultiRead(ReadRequest* reqs, size_t num_reqs) const;
 };
 
 // A file abstraction for sequential writing.  The implementation
@@ -287,6 +339,14 @@ class LEVELDB_EXPORT WritableFile {
   virtual Status Close() = 0;
   virtual Status Flush() = 0;
   virtual Status Sync() = 0;
+
+  // Hint that the file is expected to grow by at least "block_size"
+  // bytes at a time.  Implementations may preallocate space for the file
+  // in chunks of this size ahead of writes so that Sync() does not have
+  // to update allocation metadata as often, and should release the
+  // unused part on Close().  Zero disables preallocation.  The default
+  // implementation does nothing.
+  virtual void SetPreallocationBlockSize(size_t block_size);
 };
 
 // An interface for writing log messages.
@@ -349,12 +409,20 @@ class LEVELDB_EXPORT EnvWrapper : public Env {
                              RandomAccessFile** r) override {
     return target_->NewRandomAccessFile(f, r);
   }
+  void MultiRead(const RandomAccessFile* const* files, ReadRequest* reqs,
+                 size_t num_reqs) override {
+    target_->MultiRead(files, reqs, num_reqs);
+  }
   Status NewWritableFile(const std::string& f, WritableFile** r) override {
     return target_->NewWritableFile(f, r);
   }
   Status NewAppendableFile(const std::string& f, WritableFile** r) override {
     return target_->NewAppendableFile(f, r);
   }
+  Status ReuseWritableFile(const std::string& f, const std::string& old_f,
+                           WritableFile** r) override {
+    return target_->ReuseWritableFile(f, old_f, r);
+  }
   bool FileExists(const std::string& f) override {
     return target_->FileExists(f);
   }
@@ -100,6 +100,31 @@ class LEVELDB_EXPORT FilterPolicy {
 // 尾随空格 的 FilterPolicy (如 NewBloomFilterPolicy) 是不正确的.
 LEVELDB_EXPORT const FilterPolicy* NewBloomFilterPolicy(int bits_per_key);
 
+// Like NewBloomFilterPolicy(), but all probes for a key are confined to a
+// single 64-byte block of the filter, so a lookup touches one cache line
+// instead of up to one per probe, and the probes are checked with SIMD
+// instructions where available.  The false positive rate is slightly
+// higher than that of NewBloomFilterPolicy() with the same bits_per_key.
+// Filters have a different name and cannot be read by
+// NewBloomFilterPolicy(), so switching policies disables filters of
+// existing tables until they are rewritten by compactions.
+LEVELDB_EXPORT const FilterPolicy* NewCacheLocalBloomFilterPolicy(
+    int bits_per_key);
+
+// Return a new filter policy that uses a binary fuse filter, a static
+// filter that needs about 1.13 * fingerprint_bits bits per key for large
+// filters, at a false positive rate of 2^-fingerprint_bits.  For example,
+// 7 fingerprint bits give a false positive rate of ~0.8% at about 8 bits
+// per key, where a bloom filter needs about 10 bits per key.  Filters over
+// fewer keys need more bits per key, so this is best combined with
+// Options::full_table_filter.  Building a filter is slower than building
+// a bloom filter.  fingerprint_bits must be in [1,16].
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const FilterPolicy* NewBinaryFuseFilterPolicy(
+    int fingerprint_bits);
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_INCLUDE_FILTER_POLICY_H_
@@ -6,6 +6,7 @@
 #define STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
 
 #include <cstddef>
+#include <cstdint>
 
 #include "leveldb/export.h"
 
@@ -16,6 +17,7 @@ class Comparator;
 class Env;
 class FilterPolicy;
 class Logger;
+class SliceTransform;
 class Snapshot;
 
 // DB contents are stored in a set of blocks, each of which holds a
@@ -30,6 +32,24 @@ enum CompressionType {
   kZstdCompression = 0x2,
 };
 
+// The data structure that holds the contents of a memtable.
+enum MemTableRepType {
+  // A skiplist ordered by key.  Supports every operation in O(log n).
+  kSkipListRep = 0x0,
+  // A hash table of skiplists, one per key prefix (see
+  // Options::prefix_extractor).  Reads and writes of a single key only
+  // search the skiplist of its prefix, but iterating over the memtable
+  // first has to merge all of the skiplists.  Suited to workloads made
+  // of point lookups and writes.  Keys that the comparator considers
+  // equal must be identical.
+  kHashSkipListRep = 0x1,
+  // An unsorted array that is sorted the first time the memtable is
+  // iterated over (such as when it is written to a table file).  Writes
+  // are cheap appends, but reads of single keys scan the whole array.
+  // Suited to bulk loads that do not read until the load has finished.
+  kVectorRep = 0x2,
+};
+
 // Options to control the behavior of a database (passed to DB::Open)
 struct LEVELDB_EXPORT Options {
   // Create an Options object with default values for all fields.
@@ -76,12 +96,39 @@ struct LEVELDB_EXPORT Options {
   // on disk) before converting to a sorted on-disk file.
   //
   // Larger values increase performance, especially during bulk loads.
-  // Up to two write buffers may be held in memory at the same time,
-  // so you may wish to adjust this parameter to control memory usage.
-  // Also, a larger write buffer will result in a longer recovery time
-  // the next time the database is opened.
+  // Up to max_write_buffer_number write buffers may be held in memory
+  // at the same time, so you may wish to adjust this parameter to control
+  // memory usage.  Also, a larger write buffer will result in a longer
+  // recovery time the next time the database is opened.
   size_t write_buffer_size = 4 * 1024 * 1024;
 
+  // Maximum number of write buffers held in memory at the same time: the
+  // one being written to plus the full ones waiting to be compacted.
+  // When the current write buffer fills up and this many buffers exist,
+  // writes stall until a compaction finishes.  Values above 2 absorb
+  // write bursts that outpace compactions, at the cost of memory.  All
+  // waiting buffers are merged into a single level-0 table.
+  //
+  // Default: 2
+  int max_write_buffer_number = 2;
+
+  // Rate (in bytes per second) at which writes are admitted once level-0
+  // holds enough files to trigger a slowdown, or once the estimated
+  // pending compaction work exceeds soft_pending_compaction_bytes_limit.
+  // The rate is scaled down further as level-0 gets closer to the point
+  // where writes stop entirely, so writers are throttled smoothly
+  // instead of hitting a full stall.  Zero disables the slowdown.
+  //
+  // Default: 16MB/s
+  uint64_t delayed_write_rate = 16 * 1024 * 1024;
+
+  // Writes are slowed down to delayed_write_rate (or less) when the
+  // estimated number of bytes compactions need to rewrite to bring every
+  // level within its size limit exceeds this value.
+  //
+  // Default: 64GB
+  uint64_t soft_pending_compaction_bytes_limit = 64ull * 1024 * 1024 * 1024;
+
   // Number of open files that can be used by the DB.  You may need to
   // increase this if your database has a large working set (budget
   // one open file per 2MB of working set).
@@ -94,6 +141,34 @@ struct LEVELDB_EXPORT Options {
   // If null, leveldb will automatically create and use an 8MB internal cache.
   Cache* block_cache = nullptr;
 
+  // If true, the index and filter blocks of open tables are kept in
+  // block_cache, at high priority (see NewLRUCache()), instead of being
+  // held by each open table.  Their memory then counts against the
+  // capacity of block_cache, and they are read again after eviction.
+  // Without it, they take memory for as long as the table is open, which
+  // only max_open_files bounds.
+  //
+  // Default: false
+  bool cache_index_and_filter_blocks = false;
+
+  // If true and cache_index_and_filter_blocks is set, the index and
+  // filter blocks of level-0 tables stay in block_cache (still counting
+  // against its capacity) for as long as the tables are open.
+  //
+  // Default: false
+  bool pin_l0_filter_and_index_blocks_in_cache = false;
+
+  // If non-null, use the specified cache for the results of point lookups
+  // in table files, keyed by table file and user key.  A hit skips the
+  // index and data blocks of the table entirely, which pays off for
+  // workloads that read a small set of hot keys over and over.  Entries
+  // for deleted table files are never hit again and age out of the cache.
+  //
+  // Only reads that do not use an explicit snapshot use the row cache.
+  //
+  // Default: nullptr
+  Cache* row_cache = nullptr;
+
   // Approximate size of user data packed per block.  Note that the
   // block size specified here corresponds to uncompressed data.  The
   // actual size of the unit read from disk may be smaller if
@@ -105,6 +180,34 @@ struct LEVELDB_EXPORT Options {
   // leave this parameter alone.
   int block_restart_interval = 16;
 
+  // If true, each data block ends in a small hash index from keys to
+  // restart points, which point lookups use instead of a binary search
+  // over the restart points.  It maps keys without their last 8 bytes
+  // (the sequence number and type of the internal keys of the DB), so it
+  // costs about one byte per distinct user key.  Point lookups within a
+  // cached block get about 10-20% faster, more so with larger blocks.
+  // Tables written this way cannot be read by older versions of leveldb,
+  // which report them as corrupt (bad magic number).
+  //
+  // The index hashes the raw bytes of the keys, so it must only be
+  // enabled with a comparator under which two keys compare equal only
+  // if they are byte-for-byte identical (e.g. the default bytewise
+  // comparator, but not a case-insensitive one).
+  //
+  // Default: false
+  bool data_block_hash_index = false;
+
+  // If non-zero, the index of each table is split into partitions of
+  // about this many bytes, and only a small top-level index over the
+  // partitions is kept in memory while the table is open.  Partitions
+  // are read on demand through block_cache like data blocks.  This bounds
+  // the memory of open tables with large max_file_size, at the cost of
+  // an extra block lookup per read.  Tables written this way cannot be
+  // read by older versions of leveldb.
+  //
+  // Default: 0
+  size_t index_partition_size = 0;
+
   // Leveldb will write up to this amount of bytes to a file before
   // switching to a new one.
   // Most clients should leave this parameter alone.  However if your
@@ -141,10 +244,130 @@ struct LEVELDB_EXPORT Options {
   // Default: currently false, but may become true later.
   bool reuse_logs = false;
 
+  // If non-zero, space for log files is preallocated in chunks of this
+  // many bytes ahead of writes (if supported by the Env), so that syncing
+  // the log does not have to update allocation metadata on every call.
+  //
+  // Default: 0
+  size_t log_preallocation_block_size = 0;
+
+  // Like log_preallocation_block_size, but for table files.
+  //
+  // Default: 0
+  size_t table_preallocation_block_size = 0;
+
+  // If non-zero, up to this many obsolete log files are kept around and
+  // overwritten in place by new logs instead of creating new files, which
+  // avoids allocating space for the file again.  Logs are then written in
+  // a format that lets recovery tell new records from stale ones.  Logs
+  // written this way cannot be read by older versions of leveldb.
+  //
+  // Default: 0
+  size_t recycle_log_file_num = 0;
+
+  // Compress the records written to log files with the specified
+  // compression algorithm (zstd uses zstd_compression_level).  If the
+  // algorithm is not supported by this build, logs are left uncompressed.
+  // Compressed logs cannot be read by older versions of leveldb.
+  //
+  // Default: kNoCompression
+  CompressionType wal_compression = kNoCompression;
+
+  // Data structure used to hold the contents of each memtable.
+  //
+  // Default: kSkipListRep
+  MemTableRepType memtable_rep = kSkipListRep;
+
+  // If non-zero, memtables allocate their memory in chunks of this many
+  // bytes backed by huge pages (MAP_HUGETLB), which reduces TLB misses
+  // when searching large memtables.  The OS must have huge pages of this
+  // size reserved; otherwise ordinary memory is used for the chunks.
+  // Since whole chunks count towards write_buffer_size, this only makes
+  // sense for write buffers many times larger than a huge page.
+  //
+  // Default: 0
+  size_t memtable_huge_page_size = 0;
+
+  // Number of hash buckets of a kHashSkipListRep memtable.  The buckets
+  // are allocated up front and count towards write_buffer_size (eight
+  // bytes each).
+  //
+  // Default: 50000
+  size_t memtable_hash_bucket_count = 50000;
+
+  // If non-null, keys for which prefix_extractor->InDomain() is true are
+  // grouped by prefix_extractor->Transform() in data structures that
+  // support it, such as kHashSkipListRep memtables.  Other keys are each
+  // a group of their own.  Keys that the comparator considers equal must
+  // have equal prefixes.
+  //
+  // If filter_policy is also set, each table additionally stores a filter
+  // of the prefixes of its keys, which lets iterators in
+  // ReadOptions::prefix_same_as_start mode skip tables that hold no keys
+  // with the prefix they seek to.  This requires Transform() to return a
+  // prefix of the key, such that all keys with the same prefix are
+  // adjacent in comparator order.
+  //
+  // Default: nullptr
+  const SliceTransform* prefix_extractor = nullptr;
+
+  // If non-zero, each memtable keeps a bloom filter of the user keys it
+  // holds, sized to this fraction of write_buffer_size, and lookups of
+  // keys the filter rules out skip searching the memtable.  This helps
+  // workloads that read many keys that were not written recently.
+  // Values around 0.02 (about ten bits per 50-byte entry) work well.
+  //
+  // Default: 0
+  double memtable_bloom_size_ratio = 0;
+
   // If non-null, use the specified filter policy to reduce disk reads.
   // Many applications will benefit from passing the result of
   // NewBloomFilterPolicy() here.
   const FilterPolicy* filter_policy = nullptr;
+
+  // If true, tables store a single filter_policy filter over all of their
+  // keys instead of one filter per 2KB of data blocks.  Point lookups then
+  // check the filter before searching the index, so a lookup of a key that
+  // is not in a table does not touch its index at all.  Tables with
+  // either kind of filter can be read regardless of this setting.
+  //
+  // Default: false
+  bool full_table_filter = false;
+
+  // EXPERIMENTAL: If true, split the write path into two pipelined
+  // stages.  A batch group appends (and optionally syncs) its log record
+  // and then hands its memtable insert off to a second queue, so the next
+  // group can start writing to the log while the previous one is still
+  // being applied to the memtable.  Writes still become visible to
+  // readers in sequence number order.  This can improve throughput when
+  // many threads issue small concurrent writes.
+  //
+  // Default: false
+  bool enable_pipelined_write = false;
+
+  // EXPERIMENTAL: If true, once the log record of a batch group has been
+  // written, every writer in the group inserts its own batch into the
+  // memtable in parallel instead of the group leader applying the whole
+  // group alone.  This lets memtable insert throughput scale with the
+  // number of concurrent writers.
+  //
+  // Default: false
+  bool allow_concurrent_memtable_write = false;
+
+  // If non-zero, the leader of a batch group that contains a sync write
+  // waits up to this many microseconds for more writers to queue up
+  // before writing and syncing the log, so that a single sync covers
+  // more writes.  This trades a bounded amount of latency for fewer
+  // syncs when many threads issue small sync writes.
+  //
+  // Default: 0
+  uint64_t sync_group_commit_micros = 0;
+
+  // If non-zero, the wait controlled by sync_group_commit_micros ends as
+  // soon as at least this many bytes of batches are queued.
+  //
+  // Default: 0
+  size_t sync_group_commit_bytes = 0;
 };
 
 // Options that control read operations
@@ -162,6 +385,17 @@ struct LEVELDB_EXPORT ReadOptions {
   // not have been released).  If "snapshot" is null, use an implicit
   // snapshot of the state at the beginning of this read operation.
   const Snapshot* snapshot = nullptr;
+
+  // If true and the database has a prefix_extractor, an iterator that is
+  // positioned by Seek(target) only yields keys with the same prefix as
+  // target, and becomes invalid when Next() leaves the prefix.  Tables
+  // whose prefix filter rules out the prefix are not read at all.
+  // Iterators positioned by SeekToFirst() or SeekToLast(), and seeks to
+  // targets outside the domain of the prefix_extractor, are not bounded.
+  //
+  // Prev() is not supported on a bounded iterator: it invalidates the
+  // iterator and sets its status() to NotSupported.
+  bool prefix_same_as_start = false;
 };
 
 // Options that control write operations
@@ -183,6 +417,17 @@ struct LEVELDB_EXPORT WriteOptions {
   // with sync==true has similar crash semantics to a "write()"
   // system call followed by "fsync()".
   bool sync = false;
+
+  // If true, the write is applied to the memtable only and is not
+  // appended to the log.  Such writes are lost if the process or the
+  // machine crashes before the memtable holding them has been written
+  // to a table file, either by a regular compaction or by an explicit
+  // call to DB::FlushMemTable().  Deleting the DB flushes the memtable
+  // if it holds writes made this way.  Use this for data that can be
+  // rebuilt from elsewhere.
+  //
+  // REQUIRES: sync is false.
+  bool disable_wal = false;
 };
 
 }  // namespace leveldb
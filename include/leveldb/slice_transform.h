@@ -0,0 +1,49 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A SliceTransform maps a user key to a shorter slice of it, usually a
+// prefix, that groups related keys together.  A database can be told
+// about such a grouping through Options::prefix_extractor, which lets
+// some data structures work on groups of keys instead of single keys.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+#define STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+
+#include <cstddef>
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT SliceTransform {
+ public:
+  virtual ~SliceTransform();
+
+  // Return the name of this transform.  If the transform changes in an
+  // incompatible way, the name returned by this method must be changed.
+  virtual const char* Name() const = 0;
+
+  // Return the part of "key" that identifies its group.  The result
+  // must refer to data that lives as long as "key".
+  //
+  // REQUIRES: InDomain(key)
+  virtual Slice Transform(const Slice& key) const = 0;
+
+  // Return true if Transform() can be applied to "key".  Keys outside
+  // the domain are treated as a group of their own.
+  virtual bool InDomain(const Slice& key) const = 0;
+};
+
+// Return a new transform that maps a key to its first prefix_len bytes.
+// Keys shorter than prefix_len are not in its domain.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const SliceTransform* NewFixedPrefixTransform(
+    size_t prefix_len);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
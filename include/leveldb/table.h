@@ -6,7 +6,9 @@
 #define STORAGE_LEVELDB_INCLUDE_TABLE_H_
 
 #include <cstdint>
+#include <vector>
 
+#include "leveldb/cache.h"
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
 
@@ -14,10 +16,11 @@ namespace leveldb {
 
 class Block;
 class BlockHandle;
-class Footer;
+struct BlockContents;
 struct Options;
 class RandomAccessFile;
 struct ReadOptions;
+struct ReadRequest;
 class TableCache;
 
 // A Table is a sorted map from strings to strings.  Tables are
@@ -36,7 +39,8 @@ class LEVELDB_EXPORT Table {
   // "*source", but the client must ensure that "source" remains live
   // for the duration of the returned table's lifetime.
   //
-  // *file must remain live while this Table is in use.
+  // *file must remain live while this Table is in use, and so must
+  // options.block_cache, if any.
   static Status Open(const Options& options, RandomAccessFile* file,
                      uint64_t file_size, Table** table);
 
@@ -48,8 +52,16 @@ class LEVELDB_EXPORT Table {
   // Returns a new iterator over the table contents.
   // The result of NewIterator() is initially invalid (caller must
   // call one of the Seek methods on the iterator before using it).
+  //
+  // If ReadOptions::prefix_same_as_start is set, a Seek() to a key whose
+  // prefix the prefix filter of the table rules out leaves the iterator
+  // invalid without reading any blocks.
   Iterator* NewIterator(const ReadOptions&) const;
 
+  // Returns false if the table has a prefix filter that rules out keys
+  // with the prefix of "key" (see Options::prefix_extractor).
+  bool PrefixMayMatch(const Slice& key) const;
+
   // Given a key, return an approximate byte offset in the file where
   // the data for that key begins (or would begin if the key were
   // present in the file).  The returned value is in terms of file
@@ -61,20 +73,79 @@ class LEVELDB_EXPORT Table {
  private:
   friend class TableCache;
   struct Rep;
+  struct IndexAndFilters;
 
   static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
+  static Iterator* IndexPartitionReader(void*, const ReadOptions&,
+                                        const Slice&);
+  // Returns an iterator over the data block (or index partition, if
+  // !data_block) at index_value.  If lookup_key is non-null, the iterator
+  // is positioned for a point lookup of *lookup_key.
+  static Iterator* NewBlockIterator(Table* table, const ReadOptions&,
+                                    const Slice& index_value, bool data_block,
+                                    const Slice* lookup_key);
+
+  // Returns an iterator over the index entries of all data blocks, which
+  // reads index partitions on demand if the index is partitioned.
+  Iterator* NewIndexIterator(const ReadOptions&) const;
+  Iterator* NewIndexIterator(const ReadOptions&, IndexAndFilters* meta) const;
+
+  // Returns the index block and filters of the table, or nullptr after
+  // setting *s if they cannot be read.  *handle is set to the block cache
+  // handle to pass to ReleaseIndexAndFilters() when done with them.
+  IndexAndFilters* GetIndexAndFilters(Cache::Handle** handle,
+                                      Status* s) const;
+  void ReleaseIndexAndFilters(Cache::Handle* handle) const;
+  Status ReadIndexAndFilters(IndexAndFilters** result) const;
+  void IndexAndFiltersCacheKey(char* buf) const;
+
+  // Keeps the index block and filters in the block cache for as long as
+  // the table is open, if they are kept there.
+  void PinIndexAndFilters();
 
   explicit Table(Rep* rep) : rep_(rep) {}
 
   // Calls (*handle_result)(arg, ...) with the entry found after a call
-  // to Seek(key).  May not make such a call if filter policy says
-  // that key is not present.
+  // to Seek(key).  May not make such a call if filter policy or the hash
+  // index of the data block says that key is not present, and may pass
+  // a later entry instead of the one found by Seek(key) if it is not.
   Status InternalGet(const ReadOptions&, const Slice& key, void* arg,
                      void (*handle_result)(void* arg, const Slice& k,
                                            const Slice& v));
 
-  void ReadMeta(const Footer& footer);
-  void ReadFilter(const Slice& filter_handle_value);
+  // A lookup of several keys that StartMultiGet() has begun.
+  struct MultiGetState;
+
+  // Together with FinishMultiGet(), like calling InternalGet() for each of
+  // keys[0,n-1], which must be in increasing order, except that the
+  // handler is passed the index of the key.  The index block is walked
+  // once for all of the keys, and keys that fall into the same data block
+  // share a single read of it.
+  //
+  // Finds the data blocks of the keys and appends a read of each block
+  // missing from the block cache to *reqs, and the table's file to
+  // *files.  Those reads must be done (e.g. with Env::MultiRead()) before
+  // the returned state, which keeps a pointer to keys, is passed to
+  // FinishMultiGet().  The reads of several tables can be done at once.
+  MultiGetState* StartMultiGet(const ReadOptions&, int n, const Slice* keys,
+                               std::vector<const RandomAccessFile*>* files,
+                               std::vector<ReadRequest>* reqs) const;
+
+  // Searches the blocks found by StartMultiGet() for the keys, given the
+  // vector of reads it appended to, and deletes state.
+  Status FinishMultiGet(MultiGetState* state, const ReadOptions&,
+                        ReadRequest* reqs, void* arg,
+                        void (*handle_result)(void* arg, int index,
+                                              const Slice& k,
+                                              const Slice& v)) const;
+
+  void ReadMeta(IndexAndFilters* meta) const;
+  void ReadFilter(const Slice& filter_handle_value, bool full,
+                  IndexAndFilters* meta) const;
+  void ReadPrefixFilter(const Slice& filter_handle_value,
+                        IndexAndFilters* meta) const;
+  bool ReadFilterBlock(const Slice& filter_handle_value,
+                       BlockContents* block) const;
 
   Rep* const rep_;
 };
@@ -0,0 +1,108 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// WriteBatchWithIndex is a WriteBatch that also keeps its entries sorted
+// by key, so that the pending writes can be read back before the batch is
+// applied to a DB:
+//
+//    leveldb::WriteBatchWithIndex batch;
+//    batch.Put("key1", "value1");
+//    batch.Delete("key2");
+//    batch.GetFromBatchAndDB(db, leveldb::ReadOptions(), "key1", &value);
+//    leveldb::Iterator* it = batch.NewIteratorWithBase(
+//        db->NewIterator(leveldb::ReadOptions()));
+//    ... iterate over the DB as if the batch had been applied ...
+//    delete it;
+//    db->Write(leveldb::WriteOptions(), batch.GetWriteBatch());
+//
+// The index refers to the keys and values stored in the batch itself, so
+// keys are not copied a second time.
+//
+// Multiple threads can invoke const methods on a WriteBatchWithIndex
+// without external synchronization, but if any of the threads may call a
+// non-const method, all threads accessing the same WriteBatchWithIndex
+// must use external synchronization.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_WRITE_BATCH_WITH_INDEX_H_
+#define STORAGE_LEVELDB_INCLUDE_WRITE_BATCH_WITH_INDEX_H_
+
+#include <string>
+
+#include "leveldb/export.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Comparator;
+class DB;
+class Iterator;
+class Slice;
+class WriteBatch;
+struct ReadOptions;
+
+class LEVELDB_EXPORT WriteBatchWithIndex {
+ public:
+  // Keys are ordered by *comparator, which must remain live while this
+  // object is live and should be the comparator of the DB the batch is
+  // read together with.
+  explicit WriteBatchWithIndex(const Comparator* comparator);
+  WriteBatchWithIndex();
+
+  WriteBatchWithIndex(const WriteBatchWithIndex&) = delete;
+  WriteBatchWithIndex& operator=(const WriteBatchWithIndex&) = delete;
+
+  ~WriteBatchWithIndex();
+
+  // Store the mapping "key->value" in the batch.
+  void Put(const Slice& key, const Slice& value);
+
+  // Erase the mapping for "key", if any, when the batch is applied.
+  void Delete(const Slice& key);
+
+  // Clear all updates buffered in this batch.
+  void Clear();
+
+  // Returns the batch of updates, to be passed to DB::Write().  The
+  // result is owned by this object and must not be modified directly.
+  WriteBatch* GetWriteBatch();
+
+  // If the last update of "key" in the batch stores a value, store it in
+  // *value and return OK.
+  //
+  // If the batch does not store a value for "key" (because it deletes it
+  // or does not mention it), a status for which Status::IsNotFound()
+  // returns true is returned.
+  Status GetFromBatch(const Slice& key, std::string* value) const;
+
+  // Like DB::Get(db, options, key, value) on the DB as it would be once
+  // this batch is applied: updates in the batch take precedence over the
+  // contents of db.
+  Status GetFromBatchAndDB(DB* db, const ReadOptions& options,
+                           const Slice& key, std::string* value) const;
+
+  // Return an iterator over the mappings stored by the batch, in key
+  // order.  Deleted keys are skipped.
+  //
+  // The batch must not be modified while the iterator is live.  The
+  // caller should delete the iterator when it is no longer needed.
+  Iterator* NewIterator() const;
+
+  // Return an iterator over the contents of base_iterator (usually an
+  // iterator over a DB) with the updates of this batch applied on top:
+  // keys put by the batch show the batch's value and keys deleted by the
+  // batch are skipped.  The result takes ownership of base_iterator,
+  // which must order keys by the comparator of this batch.
+  //
+  // The batch must not be modified while the iterator is live.  The
+  // caller should delete the iterator when it is no longer needed.
+  Iterator* NewIteratorWithBase(Iterator* base_iterator) const;
+
+ private:
+  struct Rep;
+  Rep* rep_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_WRITE_BATCH_WITH_INDEX_H_
@@ -51,6 +51,11 @@ class CondVar {
   // REQUIRES: this thread holds *mu
   void Wait();
 
+  // Like Wait(), but also return once "micros" microseconds have
+  // passed.  May return early because of a spurious wakeup.
+  // REQUIRES: this thread holds *mu
+  void WaitFor(uint64_t micros);
+
   // If there are some threads waiting, wake up at least one of them.
   void Signal();
 
@@ -114,6 +119,10 @@ bool GetHeapProfile(void (*func)(void*, const char*, int), void* arg);
 // the newly extended CRC value (which may also be zero).
 uint32_t AcceleratedCRC32C(uint32_t crc, const char* buf, size_t size);
 
+// Hint that the cache line at addr is about to be read.  Does nothing if
+// the platform has no way to prefetch memory.  addr may be null.
+void Prefetch(const void* addr);
+
 }  // namespace port
 }  // namespace leveldb
 
@@ -34,6 +34,7 @@
 #endif  // HAVE_ZSTD
 
 #include <cassert>
+#include <chrono>  // NOLINT
 #include <condition_variable>  // NOLINT
 #include <cstddef>
 #include <cstdint>
@@ -79,6 +80,11 @@ class CondVar {
     cv_.wait(lock);
     lock.release();
   }
+  void WaitFor(uint64_t micros) {
+    std::unique_lock<std::mutex> lock(mu_->mu_, std::adopt_lock);
+    cv_.wait_for(lock, std::chrono::microseconds(micros));
+    lock.release();
+  }
   void Signal() { cv_.notify_one(); }
   void SignalAll() { cv_.notify_all(); }
 
@@ -217,6 +223,15 @@ inline uint32_t AcceleratedCRC32C(uint32_t crc, const char* buf, size_t size) {
 #endif  // HAVE_CRC32C
 }
 
+inline void Prefetch(const void* addr) {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(addr);
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)addr;
+#endif  // defined(__GNUC__) || defined(__clang__)
+}
+
 }  // namespace port
 }  // namespace leveldb
 
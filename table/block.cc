@@ -19,22 +19,38 @@ namespace leveldb {
 
 inline uint32_t Block::NumRestarts() const {
   assert(size_ >= sizeof(uint32_t));
-  return DecodeFixed32(data_ + size_ - sizeof(uint32_t));
+  const size_t limit =  // End of the restart array
+      hash_buckets_ != nullptr
+          ? reinterpret_cast<const char*>(hash_buckets_) - data_
+          : size_;
+  return DecodeFixed32(data_ + limit - sizeof(uint32_t));
 }
 
-Block::Block(const BlockContents& contents)
+Block::Block(const BlockContents& contents, bool hash_index)
     : data_(contents.data.data()),
       size_(contents.data.size()),
+      hash_buckets_(nullptr),
+      num_buckets_(0),
       owned_(contents.heap_allocated) {
-  if (size_ < sizeof(uint32_t)) {
+  size_t limit = size_;  // End of the restart array
+  if (hash_index && limit >= sizeof(uint32_t)) {
+    num_buckets_ = DecodeFixed32(data_ + limit - sizeof(uint32_t));
+    if (num_buckets_ > limit - sizeof(uint32_t)) {
+      limit = 0;  // The size is too small for num_buckets_
+    } else {
+      limit -= sizeof(uint32_t) + num_buckets_;
+      hash_buckets_ = reinterpret_cast<const uint8_t*>(data_ + limit);
+    }
+  }
+  if (limit < sizeof(uint32_t)) {
     size_ = 0;  // Error marker
   } else {
-    size_t max_restarts_allowed = (size_ - sizeof(uint32_t)) / sizeof(uint32_t);
+    size_t max_restarts_allowed = (limit - sizeof(uint32_t)) / sizeof(uint32_t);
     if (NumRestarts() > max_restarts_allowed) {
       // The size is too small for NumRestarts()
       size_ = 0;
     } else {
-      restart_offset_ = size_ - (1 + NumRestarts()) * sizeof(uint32_t);
+      restart_offset_ = limit - (1 + NumRestarts()) * sizeof(uint32_t);
     }
   }
 }
@@ -235,6 +251,15 @@ class Block::Iter : public Iterator {
     }
   }
 
+  // Like Seek(target), but with the knowledge that no key before restart
+  // point "index" is >= target.
+  void SeekFromRestartPoint(uint32_t index, const Slice& target) {
+    SeekToRestartPoint(index);
+    while (ParseNextKey() && Compare(key_, target) < 0) {
+      // Keep skipping
+    }
+  }
+
   void SeekToFirst() override {
     SeekToRestartPoint(0);
     ParseNextKey();
@@ -298,4 +323,26 @@ Iterator* Block::NewIterator(const Comparator* comparator) {
   }
 }
 
+Iterator* Block::NewPointLookupIterator(const Comparator* comparator,
+                                        const Slice& target) {
+  if (size_ < sizeof(uint32_t) || hash_buckets_ == nullptr ||
+      num_buckets_ == 0 || NumRestarts() == 0) {
+    Iterator* iter = NewIterator(comparator);
+    iter->Seek(target);
+    return iter;
+  }
+  const uint32_t num_restarts = NumRestarts();
+  Iter* iter = new Iter(comparator, data_, restart_offset_, num_restarts);
+  const uint8_t restart =
+      hash_buckets_[BlockHashIndexHash(target) % num_buckets_];
+  if (restart == kBlockHashNoEntry) {
+    // Not in the block: leave iter invalid
+  } else if (restart == kBlockHashCollision || restart >= num_restarts) {
+    iter->Seek(target);
+  } else {
+    iter->SeekFromRestartPoint(restart, target);
+  }
+  return iter;
+}
+
 }  // namespace leveldb
@@ -17,8 +17,9 @@ class Comparator;
 
 class Block {
  public:
-  // Initialize the block with the specified contents.
-  explicit Block(const BlockContents& contents);
+  // Initialize the block with the specified contents.  If hash_index is
+  // set, the block ends in a hash index (see block_builder.cc).
+  explicit Block(const BlockContents& contents, bool hash_index = false);
 
   Block(const Block&) = delete;
   Block& operator=(const Block&) = delete;
@@ -28,6 +29,13 @@ class Block {
   size_t size() const { return size_; }
   Iterator* NewIterator(const Comparator* comparator);
 
+  // Returns an iterator for a point lookup of target: like NewIterator()
+  // followed by Seek(target), except that the hash index of the block, if
+  // any, is used to find target.  If target is not in the block, the
+  // iterator may be invalid or positioned at any later entry.
+  Iterator* NewPointLookupIterator(const Comparator* comparator,
+                                   const Slice& target);
+
  private:
   class Iter;
 
@@ -35,8 +43,10 @@ class Block {
 
   const char* data_;
   size_t size_;
-  uint32_t restart_offset_;  // Offset in data_ of restart array
-  bool owned_;               // Block owns data_[]
+  uint32_t restart_offset_;      // Offset in data_ of restart array
+  const uint8_t* hash_buckets_;  // Hash index, or nullptr if none
+  uint32_t num_buckets_;         // Number of hash_buckets_
+  bool owned_;                   // Block owns data_[]
 };
 
 }  // namespace leveldb
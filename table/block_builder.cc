@@ -25,20 +25,39 @@
 //     restarts: uint32[num_restarts]
 //     num_restarts: uint32
 // restarts[i] contains the offset within the block of the ith restart point.
+//
+// Blocks built with a hash index have it appended after the trailer:
+//     buckets: uint8[num_buckets]
+//     num_buckets: uint32
+// Each key is hashed without its last 8 bytes (the sequence number and
+// type of internal keys; see BlockHashIndexHash()), and buckets[hash %
+// num_buckets] holds the index of the restart interval that contains the
+// first entry with that key prefix.  A bucket is kBlockHashNoEntry if no
+// key maps to it, and kBlockHashCollision if keys of different restart
+// intervals do, or the restart index does not fit in a byte.
 
 #include "table/block_builder.h"
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 
 #include "leveldb/comparator.h"
 #include "leveldb/options.h"
+#include "table/format.h"
 #include "util/coding.h"
 
 namespace leveldb {
 
-BlockBuilder::BlockBuilder(const Options* options)
-    : options_(options), restarts_(), counter_(0), finished_(false) {
+// Number of hashed keys per hash index bucket
+static const double kHashUtilRatio = 0.75;
+
+BlockBuilder::BlockBuilder(const Options* options, bool hash_index)
+    : options_(options),
+      hash_index_(hash_index),
+      restarts_(),
+      counter_(0),
+      finished_(false) {
   assert(options->block_restart_interval >= 1);
   restarts_.push_back(0);  // First restart point is at offset 0
 }
@@ -50,12 +69,19 @@ void BlockBuilder::Reset() {
   counter_ = 0;
   finished_ = false;
   last_key_.clear();
+  hash_entries_.clear();
 }
 
 size_t BlockBuilder::CurrentSizeEstimate() const {
-  return (buffer_.size() +                       // Raw data buffer
-          restarts_.size() * sizeof(uint32_t) +  // Restart array
-          sizeof(uint32_t));                     // Restart array length
+  size_t size = (buffer_.size() +                       // Raw data buffer
+                 restarts_.size() * sizeof(uint32_t) +  // Restart array
+                 sizeof(uint32_t));                     // Restart array length
+  if (hash_index_) {
+    size += (static_cast<size_t>(hash_entries_.size() / kHashUtilRatio) +
+             1 +                 // Hash buckets
+             sizeof(uint32_t));  // Number of buckets
+  }
+  return size;
 }
 
 Slice BlockBuilder::Finish() {
@@ -64,6 +90,25 @@ Slice BlockBuilder::Finish() {
     PutFixed32(&buffer_, restarts_[i]);
   }
   PutFixed32(&buffer_, restarts_.size());
+
+  if (hash_index_) {
+    const uint32_t num_buckets =
+        static_cast<uint32_t>(hash_entries_.size() / kHashUtilRatio) + 1;
+    std::vector<uint8_t> buckets(num_buckets, kBlockHashNoEntry);
+    for (const auto& entry : hash_entries_) {
+      uint8_t& bucket = buckets[entry.first % num_buckets];
+      const uint8_t restart = entry.second < kBlockHashCollision
+                                  ? static_cast<uint8_t>(entry.second)
+                                  : kBlockHashCollision;
+      if (bucket == kBlockHashNoEntry) {
+        bucket = restart;
+      } else if (bucket != restart) {
+        bucket = kBlockHashCollision;
+      }
+    }
+    buffer_.append(reinterpret_cast<const char*>(buckets.data()), num_buckets);
+    PutFixed32(&buffer_, num_buckets);
+  }
   finished_ = true;
   return Slice(buffer_);
 }
@@ -86,6 +131,19 @@ void BlockBuilder::Add(const Slice& key, const Slice& value) {
     restarts_.push_back(buffer_.size());
     counter_ = 0;
   }
+  if (hash_index_) {
+    // Only the first entry of a run of keys with the same prefix needs a
+    // bucket.
+    const size_t prefix = key.size() >= 8 ? key.size() - 8 : key.size();
+    const size_t last_prefix =
+        last_key_piece.size() >= 8 ? last_key_piece.size() - 8
+                                   : last_key_piece.size();
+    if (buffer_.empty() || prefix != last_prefix ||
+        memcmp(key.data(), last_key_piece.data(), prefix) != 0) {
+      hash_entries_.emplace_back(BlockHashIndexHash(key),
+                                 restarts_.size() - 1);
+    }
+  }
   const size_t non_shared = key.size() - shared;
 
   // Add "<shared><non_shared><value_size>" to buffer_
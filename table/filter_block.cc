@@ -5,6 +5,7 @@
 #include "table/filter_block.h"
 
 #include "leveldb/filter_policy.h"
+#include "leveldb/slice_transform.h"
 #include "util/coding.h"
 
 namespace leveldb {
@@ -103,4 +104,51 @@ bool FilterBlockReader::KeyMayMatch(uint64_t block_offset, const Slice& key) {
   return true;  // Errors are treated as potential matches
 }
 
+FullFilterBlockBuilder::FullFilterBlockBuilder(const FilterPolicy* policy)
+    : policy_(policy) {}
+
+void FullFilterBlockBuilder::AddKey(const Slice& key) {
+  start_.push_back(keys_.size());
+  keys_.append(key.data(), key.size());
+}
+
+Slice FullFilterBlockBuilder::Finish() {
+  const size_t num_keys = start_.size();
+  if (num_keys == 0) {
+    return Slice(result_);  // Empty filters do not match any keys
+  }
+
+  // Make list of keys from flattened key structure
+  start_.push_back(keys_.size());  // Simplify length computation
+  std::vector<Slice> keys(num_keys);
+  for (size_t i = 0; i < num_keys; i++) {
+    keys[i] = Slice(keys_.data() + start_[i], start_[i + 1] - start_[i]);
+  }
+  policy_->CreateFilter(&keys[0], static_cast<int>(num_keys), &result_);
+
+  keys_.clear();
+  start_.clear();
+  return Slice(result_);
+}
+
+FullFilterBlockReader::FullFilterBlockReader(const FilterPolicy* policy,
+                                             const Slice& contents)
+    : policy_(policy), filter_(contents) {}
+
+bool FullFilterBlockReader::KeyMayMatch(const Slice& key) {
+  if (filter_.empty()) {
+    return false;
+  }
+  return policy_->KeyMayMatch(key, filter_);
+}
+
+std::string PrefixFilterMetaKey(const FilterPolicy* policy,
+                                const SliceTransform* prefix_extractor) {
+  std::string key = "prefixfilter.";
+  key.append(policy->Name());
+  key.push_back('.');
+  key.append(prefix_extractor->Name());
+  return key;
+}
+
 }  // namespace leveldb
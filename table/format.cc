@@ -10,6 +10,7 @@
 #include "table/block.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
+#include "util/hash.h"
 
 namespace leveldb {
 
@@ -33,9 +34,20 @@ void Footer::EncodeTo(std::string* dst) const {
   const size_t original_size = dst->size();
   metaindex_handle_.EncodeTo(dst);
   index_handle_.EncodeTo(dst);
-  dst->resize(2 * BlockHandle::kMaxEncodedLength);  // Padding
-  PutFixed32(dst, static_cast<uint32_t>(kTableMagicNumber & 0xffffffffu));
-  PutFixed32(dst, static_cast<uint32_t>(kTableMagicNumber >> 32));
+  uint64_t magic = kTableMagicNumber;
+  if (flags_ != 0) {
+    // Handles of files smaller than 2^56 bytes leave room for the flags.
+    assert(dst->size() <= original_size + 2 * BlockHandle::kMaxEncodedLength -
+                              sizeof(uint32_t));
+    dst->resize(original_size + 2 * BlockHandle::kMaxEncodedLength -
+                sizeof(uint32_t));  // Padding
+    PutFixed32(dst, flags_);
+    magic = kExtendedTableMagicNumber;
+  } else {
+    dst->resize(original_size + 2 * BlockHandle::kMaxEncodedLength);  // Padding
+  }
+  PutFixed32(dst, static_cast<uint32_t>(magic & 0xffffffffu));
+  PutFixed32(dst, static_cast<uint32_t>(magic >> 32));
   assert(dst->size() == original_size + kEncodedLength);
   (void)original_size;  // Disable unused variable warning.
 }
@@ -50,7 +62,14 @@ Status Footer::DecodeFrom(Slice* input) {
   const uint32_t magic_hi = DecodeFixed32(magic_ptr + 4);
   const uint64_t magic = ((static_cast<uint64_t>(magic_hi) << 32) |
                           (static_cast<uint64_t>(magic_lo)));
-  if (magic != kTableMagicNumber) {
+  if (magic == kTableMagicNumber) {
+    flags_ = 0;
+  } else if (magic == kExtendedTableMagicNumber) {
+    flags_ = DecodeFixed32(magic_ptr - sizeof(uint32_t));
+    if ((flags_ & ~static_cast<uint32_t>(kKnownFlags)) != 0) {
+      return Status::NotSupported("sstable uses unknown features");
+    }
+  } else {
     return Status::Corruption("not an sstable (bad magic number)");
   }
 
@@ -74,14 +93,24 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
 
   // Read the block contents as well as the type/crc footer.
   // See table_builder.cc for the code that built this structure.
-  size_t n = static_cast<size_t>(handle.size());
-  char* buf = new char[n + kBlockTrailerSize];
+  char* buf = new char[BlockReadSize(handle)];
   Slice contents;
-  Status s = file->Read(handle.offset(), n + kBlockTrailerSize, &contents, buf);
+  Status s = file->Read(handle.offset(), BlockReadSize(handle), &contents, buf);
   if (!s.ok()) {
     delete[] buf;
     return s;
   }
+  return DecodeBlock(buf, contents, options, handle, result);
+}
+
+Status DecodeBlock(char* buf, const Slice& contents, const ReadOptions& options,
+                   const BlockHandle& handle, BlockContents* result) {
+  result->data = Slice();
+  result->cachable = false;
+  result->heap_allocated = false;
+
+  size_t n = static_cast<size_t>(handle.size());
+  Status s;
   if (contents.size() != n + kBlockTrailerSize) {
     delete[] buf;
     return Status::Corruption("truncated block read");
@@ -166,4 +195,9 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
   return Status::OK();
 }
 
+uint32_t BlockHashIndexHash(const Slice& key) {
+  const size_t n = key.size() >= 8 ? key.size() - 8 : key.size();
+  return Hash(key.data(), n, 0x5bd1e995);
+}
+
 }  // namespace leveldb
@@ -52,8 +52,26 @@ class Footer {
   // of two block handles and a magic number.
   enum { kEncodedLength = 2 * BlockHandle::kMaxEncodedLength + 8 };
 
+  // Flags for table features that older readers do not understand.  A
+  // footer with any flags set is written in an extended format that
+  // older readers reject as not being an sstable.
+  enum Flags : uint32_t {
+    // The index block is a top-level index over index partitions, each
+    // of which is an ordinary index block stored like a data block.
+    kPartitionedIndex = 0x1,
+
+    // Data blocks end in a hash index (see block_builder.cc).
+    kDataBlockHashIndex = 0x2,
+
+    kKnownFlags = kPartitionedIndex | kDataBlockHashIndex,
+  };
+
   Footer() = default;
 
+  // The feature flags of the table
+  uint32_t flags() const { return flags_; }
+  void set_flags(uint32_t flags) { flags_ = flags; }
+
   // The block handle for the metaindex block of the table
   const BlockHandle& metaindex_handle() const { return metaindex_handle_; }
   void set_metaindex_handle(const BlockHandle& h) { metaindex_handle_ = h; }
@@ -68,6 +86,7 @@ class Footer {
  private:
   BlockHandle metaindex_handle_;
   BlockHandle index_handle_;
+  uint32_t flags_ = 0;
 };
 
 // kTableMagicNumber was picked by running
@@ -75,6 +94,13 @@ class Footer {
 // and taking the leading 64 bits.
 static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
 
+// Magic number of footers that have flags: the flags are stored as a
+// fixed32 right before it, in the last bytes of the handle padding.
+// Picked by running
+//    echo http://code.google.com/p/leveldb/#extended-footer | sha1sum
+// and taking the leading 64 bits.
+static const uint64_t kExtendedTableMagicNumber = 0xae40257faeced186ull;
+
 // 1-byte type + 32-bit crc
 static const size_t kBlockTrailerSize = 5;
 
@@ -89,6 +115,29 @@ struct BlockContents {
 Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
                  const BlockHandle& handle, BlockContents* result);
 
+// Like ReadBlock(), but for a block that the caller has already read: buf
+// is a new[]-allocated buffer of BlockReadSize(handle) bytes that was
+// passed as scratch space to the read that returned contents.  Takes
+// ownership of buf.
+Status DecodeBlock(char* buf, const Slice& contents, const ReadOptions& options,
+                   const BlockHandle& handle, BlockContents* result);
+
+// Number of bytes to read from the file for the block identified by
+// "handle": the block contents followed by the type/crc trailer.
+inline size_t BlockReadSize(const BlockHandle& handle) {
+  return static_cast<size_t>(handle.size()) + kBlockTrailerSize;
+}
+
+// Bucket values of block hash indexes (see block_builder.cc) other than
+// restart point indexes.
+static const uint8_t kBlockHashNoEntry = 255;
+static const uint8_t kBlockHashCollision = 254;
+
+// Returns the hash of key used by block hash indexes.  Keys of at least 8
+// bytes are hashed without their last 8 bytes, so that all internal keys
+// of a user key hash alike.
+uint32_t BlockHashIndexHash(const Slice& key);
+
 // Implementation details follow.  Clients should ignore,
 
 inline BlockHandle::BlockHandle()
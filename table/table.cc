@@ -4,11 +4,15 @@
 
 #include "leveldb/table.h"
 
+#include <atomic>
+#include <vector>
+
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/slice_transform.h"
 #include "table/block.h"
 #include "table/filter_block.h"
 #include "table/format.h"
@@ -17,22 +21,52 @@
 
 namespace leveldb {
 
-struct Table::Rep {
-  ~Rep() {
+// The index block and filters of a table.  Owned by the table, or by
+// the block cache if options.cache_index_and_filter_blocks is set.
+struct Table::IndexAndFilters {
+  ~IndexAndFilters() {
     delete filter;
+    delete full_filter;
+    delete prefix_filter;
     delete[] filter_data;
+    delete[] prefix_filter_data;
     delete index_block;
   }
 
+  // Deleter of block cache entries
+  static void DeleteCached(const Slice& key, void* value) {
+    delete reinterpret_cast<IndexAndFilters*>(value);
+  }
+
+  Block* index_block = nullptr;
+  FilterBlockReader* filter = nullptr;
+  FullFilterBlockReader* full_filter = nullptr;
+  const char* filter_data = nullptr;  // Contents of filter or full_filter
+  FullFilterBlockReader* prefix_filter = nullptr;
+  const char* prefix_filter_data = nullptr;
+  size_t charge = 0;  // Bytes of the blocks above
+};
+
+struct Table::Rep {
+  ~Rep() {
+    delete meta;
+    if (pinned_meta.load(std::memory_order_relaxed) != nullptr) {
+      options.block_cache->Release(pinned_meta);
+    }
+  }
+
   Options options;
   Status status;
   RandomAccessFile* file;
   uint64_t cache_id;
-  FilterBlockReader* filter;
-  const char* filter_data;
+  IndexAndFilters* meta;  // nullptr if kept in options.block_cache
+  std::atomic<Cache::Handle*> pinned_meta;  // Handle of pinned meta, if any
 
   BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
-  Block* index_block;
+  BlockHandle index_handle;
+  bool partitioned_index;  // index_block is a top-level index over partitions
+  bool data_block_hash_index;  // Data blocks end in a hash index
+  bool has_prefix_filter;
 };
 
 Status Table::Open(const Options& options, RandomAccessFile* file,
@@ -52,34 +86,65 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
   s = footer.DecodeFrom(&footer_input);
   if (!s.ok()) return s;
 
-  // Read the index block
+  Rep* rep = new Table::Rep;
+  rep->options = options;
+  rep->file = file;
+  rep->metaindex_handle = footer.metaindex_handle();
+  rep->index_handle = footer.index_handle();
+  rep->partitioned_index = (footer.flags() & Footer::kPartitionedIndex) != 0;
+  rep->data_block_hash_index =
+      (footer.flags() & Footer::kDataBlockHashIndex) != 0;
+  rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
+  rep->meta = nullptr;
+  rep->pinned_meta = nullptr;
+  Table* result = new Table(rep);
+
+  // Read the index block and filters
+  IndexAndFilters* meta;
+  s = result->ReadIndexAndFilters(&meta);
+  if (!s.ok()) {
+    delete result;
+    return s;
+  }
+
+  // We've successfully read the footer and the index block: we're
+  // ready to serve requests.
+  rep->has_prefix_filter = meta->prefix_filter != nullptr;
+  if (options.cache_index_and_filter_blocks && options.block_cache != nullptr) {
+    char cache_key_buffer[16];
+    result->IndexAndFiltersCacheKey(cache_key_buffer);
+    Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+    options.block_cache->Release(
+        options.block_cache->Insert(key, meta, meta->charge,
+                                    &IndexAndFilters::DeleteCached,
+                                    Cache::kHighPriority));
+  } else {
+    rep->meta = meta;
+  }
+  *table = result;
+  return s;
+}
+
+Status Table::ReadIndexAndFilters(IndexAndFilters** result) const {
+  *result = nullptr;
   BlockContents index_block_contents;
   ReadOptions opt;
-  if (options.paranoid_checks) {
+  if (rep_->options.paranoid_checks) {
     opt.verify_checksums = true;
   }
-  s = ReadBlock(file, opt, footer.index_handle(), &index_block_contents);
-
+  Status s =
+      ReadBlock(rep_->file, opt, rep_->index_handle, &index_block_contents);
   if (s.ok()) {
-    // We've successfully read the footer and the index block: we're
-    // ready to serve requests.
-    Block* index_block = new Block(index_block_contents);
-    Rep* rep = new Table::Rep;
-    rep->options = options;
-    rep->file = file;
-    rep->metaindex_handle = footer.metaindex_handle();
-    rep->index_block = index_block;
-    rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
-    rep->filter_data = nullptr;
-    rep->filter = nullptr;
-    *table = new Table(rep);
-    (*table)->ReadMeta(footer);
+    IndexAndFilters* meta = new IndexAndFilters;
+    meta->index_block = new Block(index_block_contents);
+    meta->charge = meta->index_block->size();
+    ReadMeta(meta);
+    *result = meta;
   }
-
   return s;
 }
 
-void Table::ReadMeta(const Footer& footer) {
+void Table::ReadMeta(IndexAndFilters* meta) const {
   if (rep_->options.filter_policy == nullptr) {
     return;  // Do not need any metadata
   }
@@ -91,28 +156,45 @@ void Table::ReadMeta(const Footer& footer) {
     opt.verify_checksums = true;
   }
   BlockContents contents;
-  if (!ReadBlock(rep_->file, opt, footer.metaindex_handle(), &contents).ok()) {
+  if (!ReadBlock(rep_->file, opt, rep_->metaindex_handle, &contents).ok()) {
     // Do not propagate errors since meta info is not needed for operation
     return;
   }
-  Block* meta = new Block(contents);
+  Block* metaindex = new Block(contents);
 
-  Iterator* iter = meta->NewIterator(BytewiseComparator());
-  std::string key = "filter.";
+  Iterator* iter = metaindex->NewIterator(BytewiseComparator());
+  // A table has at most one kind of filter.
+  std::string key = "fullfilter.";
   key.append(rep_->options.filter_policy->Name());
   iter->Seek(key);
   if (iter->Valid() && iter->key() == Slice(key)) {
-    ReadFilter(iter->value());
+    ReadFilter(iter->value(), true, meta);
+  } else {
+    key = "filter.";
+    key.append(rep_->options.filter_policy->Name());
+    iter->Seek(key);
+    if (iter->Valid() && iter->key() == Slice(key)) {
+      ReadFilter(iter->value(), false, meta);
+    }
+  }
+  if (rep_->options.prefix_extractor != nullptr) {
+    key = PrefixFilterMetaKey(rep_->options.filter_policy,
+                              rep_->options.prefix_extractor);
+    iter->Seek(key);
+    if (iter->Valid() && iter->key() == Slice(key)) {
+      ReadPrefixFilter(iter->value(), meta);
+    }
   }
   delete iter;
-  delete meta;
+  delete metaindex;
 }
 
-void Table::ReadFilter(const Slice& filter_handle_value) {
+bool Table::ReadFilterBlock(const Slice& filter_handle_value,
+                            BlockContents* block) const {
   Slice v = filter_handle_value;
   BlockHandle filter_handle;
   if (!filter_handle.DecodeFrom(&v).ok()) {
-    return;
+    return false;
   }
 
   // We might want to unify with ReadBlock() if we start
@@ -121,17 +203,114 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
   if (rep_->options.paranoid_checks) {
     opt.verify_checksums = true;
   }
+  return ReadBlock(rep_->file, opt, filter_handle, block).ok();
+}
+
+void Table::ReadFilter(const Slice& filter_handle_value, bool full,
+                       IndexAndFilters* meta) const {
+  BlockContents block;
+  if (!ReadFilterBlock(filter_handle_value, &block)) {
+    return;
+  }
+  if (block.heap_allocated) {
+    meta->filter_data = block.data.data();  // Will need to delete later
+  }
+  meta->charge += block.data.size();
+  if (full) {
+    meta->full_filter =
+        new FullFilterBlockReader(rep_->options.filter_policy, block.data);
+  } else {
+    meta->filter =
+        new FilterBlockReader(rep_->options.filter_policy, block.data);
+  }
+}
+
+void Table::ReadPrefixFilter(const Slice& filter_handle_value,
+                             IndexAndFilters* meta) const {
   BlockContents block;
-  if (!ReadBlock(rep_->file, opt, filter_handle, &block).ok()) {
+  if (!ReadFilterBlock(filter_handle_value, &block)) {
     return;
   }
   if (block.heap_allocated) {
-    rep_->filter_data = block.data.data();  // Will need to delete later
+    meta->prefix_filter_data = block.data.data();  // Will need to delete later
   }
-  rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data);
+  meta->charge += block.data.size();
+  meta->prefix_filter =
+      new FullFilterBlockReader(rep_->options.filter_policy, block.data);
 }
 
-Table::~Table() { delete rep_; }
+void Table::IndexAndFiltersCacheKey(char* buf) const {
+  // The index block is not a data block, so its offset is not the key of
+  // any cached block of the table.
+  EncodeFixed64(buf, rep_->cache_id);
+  EncodeFixed64(buf + 8, rep_->index_handle.offset());
+}
+
+Table::IndexAndFilters* Table::GetIndexAndFilters(Cache::Handle** handle,
+                                                  Status* s) const {
+  *handle = nullptr;
+  if (rep_->meta != nullptr) {
+    return rep_->meta;
+  }
+  Cache* block_cache = rep_->options.block_cache;
+  Cache::Handle* pinned = rep_->pinned_meta.load(std::memory_order_acquire);
+  if (pinned != nullptr) {
+    return reinterpret_cast<IndexAndFilters*>(block_cache->Value(pinned));
+  }
+  char cache_key_buffer[16];
+  IndexAndFiltersCacheKey(cache_key_buffer);
+  Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+  *handle = block_cache->Lookup(key);
+  if (*handle == nullptr) {
+    IndexAndFilters* meta;
+    *s = ReadIndexAndFilters(&meta);
+    if (!s->ok()) {
+      return nullptr;
+    }
+    *handle = block_cache->Insert(key, meta, meta->charge,
+                                  &IndexAndFilters::DeleteCached,
+                                  Cache::kHighPriority);
+  }
+  return reinterpret_cast<IndexAndFilters*>(block_cache->Value(*handle));
+}
+
+void Table::ReleaseIndexAndFilters(Cache::Handle* handle) const {
+  if (handle != nullptr) {
+    rep_->options.block_cache->Release(handle);
+  }
+}
+
+void Table::PinIndexAndFilters() {
+  if (rep_->meta != nullptr ||
+      rep_->pinned_meta.load(std::memory_order_acquire) != nullptr) {
+    return;  // Not cached, or already pinned
+  }
+  Cache::Handle* handle;
+  Status s;
+  if (GetIndexAndFilters(&handle, &s) != nullptr) {
+    Cache::Handle* expected = nullptr;
+    if (!rep_->pinned_meta.compare_exchange_strong(
+            expected, handle, std::memory_order_acq_rel)) {
+      ReleaseIndexAndFilters(handle);  // Pinned by another thread
+    }
+  }
+}
+
+Table::~Table() {
+  if (rep_->meta == nullptr && rep_->options.block_cache != nullptr) {
+    // The cached index block and filters are of no use once the table is
+    // closed, and would otherwise hold on to the high priority pool.
+    Cache::Handle* pinned = rep_->pinned_meta.exchange(nullptr);
+    if (pinned != nullptr) {
+      rep_->options.block_cache->Release(pinned);
+    }
+    char cache_key_buffer[16];
+    IndexAndFiltersCacheKey(cache_key_buffer);
+    rep_->options.block_cache->Erase(
+        Slice(cache_key_buffer, sizeof(cache_key_buffer)));
+  }
+  delete rep_;
+}
 
 static void DeleteBlock(void* arg, void* ignored) {
   delete reinterpret_cast<Block*>(arg);
@@ -154,7 +333,20 @@ static void ReleaseBlock(void* arg, void* h) {
 // 将索引迭代器值（即编码的 BlockHandle）转换为对应块内容的迭代器
 Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
                              const Slice& index_value) {
-  Table* table = reinterpret_cast<Table*>(arg);
+  return NewBlockIterator(reinterpret_cast<Table*>(arg), options, index_value,
+                          true, nullptr);
+}
+
+Iterator* Table::IndexPartitionReader(void* arg, const ReadOptions& options,
+                                      const Slice& index_value) {
+  return NewBlockIterator(reinterpret_cast<Table*>(arg), options, index_value,
+                          false, nullptr);
+}
+
+Iterator* Table::NewBlockIterator(Table* table, const ReadOptions& options,
+                                  const Slice& index_value, bool data_block,
+                                  const Slice* lookup_key) {
+  const bool hash_index = data_block && table->rep_->data_block_hash_index;
   Cache* block_cache = table->rep_->options.block_cache;
   Block* block = nullptr;
   Cache::Handle* cache_handle = nullptr;
@@ -178,7 +370,7 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
       } else {
         s = ReadBlock(table->rep_->file, options, handle, &contents);
         if (s.ok()) {
-          block = new Block(contents);
+          block = new Block(contents, hash_index);
           if (contents.cachable && options.fill_cache) {
             cache_handle = block_cache->Insert(key, block, block->size(),
                                                &DeleteCachedBlock);
@@ -188,14 +380,19 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
     } else {
       s = ReadBlock(table->rep_->file, options, handle, &contents);
       if (s.ok()) {
-        block = new Block(contents);
+        block = new Block(contents, hash_index);
       }
     }
   }
 
   Iterator* iter;
   if (block != nullptr) {
-    iter = block->NewIterator(table->rep_->options.comparator);
+    const Comparator* comparator = table->rep_->options.comparator;
+    if (lookup_key != nullptr) {
+      iter = block->NewPointLookupIterator(comparator, *lookup_key);
+    } else {
+      iter = block->NewIterator(comparator);
+    }
     if (cache_handle == nullptr) {
       iter->RegisterCleanup(&DeleteBlock, block, nullptr);
     } else {
@@ -207,28 +404,139 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
   return iter;
 }
 
+Iterator* Table::NewIndexIterator(const ReadOptions& options) const {
+  Cache::Handle* handle;
+  Status s;
+  IndexAndFilters* meta = GetIndexAndFilters(&handle, &s);
+  if (meta == nullptr) {
+    return NewErrorIterator(s);
+  }
+  Iterator* iter = NewIndexIterator(options, meta);
+  if (handle != nullptr) {
+    iter->RegisterCleanup(&ReleaseBlock, rep_->options.block_cache, handle);
+  }
+  return iter;
+}
+
+Iterator* Table::NewIndexIterator(const ReadOptions& options,
+                                  IndexAndFilters* meta) const {
+  Iterator* iter = meta->index_block->NewIterator(rep_->options.comparator);
+  if (rep_->partitioned_index) {
+    // Index partitions are stored like data blocks and share the block
+    // cache with them, but never have a hash index.
+    iter = NewTwoLevelIterator(iter, &Table::IndexPartitionReader,
+                               const_cast<Table*>(this), options);
+  }
+  return iter;
+}
+
+namespace {
+
+// Wraps the iterator over a table that has a prefix filter in prefix seek
+// mode.  Seeks to keys whose prefix the filter rules out do not reach the
+// wrapped iterator.
+class PrefixSeekIterator : public Iterator {
+ public:
+  PrefixSeekIterator(const Table* table, Iterator* iter)
+      : table_(table), iter_(iter), ruled_out_(false) {}
+
+  ~PrefixSeekIterator() override { delete iter_; }
+
+  bool Valid() const override { return !ruled_out_ && iter_->Valid(); }
+  void Seek(const Slice& target) override {
+    ruled_out_ = !table_->PrefixMayMatch(target);
+    if (!ruled_out_) {
+      iter_->Seek(target);
+    }
+  }
+  void SeekToFirst() override {
+    ruled_out_ = false;
+    iter_->SeekToFirst();
+  }
+  void SeekToLast() override {
+    ruled_out_ = false;
+    iter_->SeekToLast();
+  }
+  void Next() override {
+    assert(Valid());
+    iter_->Next();
+  }
+  void Prev() override {
+    assert(Valid());
+    iter_->Prev();
+  }
+  Slice key() const override {
+    assert(Valid());
+    return iter_->key();
+  }
+  Slice value() const override {
+    assert(Valid());
+    return iter_->value();
+  }
+  Status status() const override { return iter_->status(); }
+
+ private:
+  const Table* const table_;
+  Iterator* const iter_;
+  bool ruled_out_;  // The last Seek() was ruled out by the prefix filter
+};
+
+}  // namespace
+
 Iterator* Table::NewIterator(const ReadOptions& options) const {
-  return NewTwoLevelIterator(
-      rep_->index_block->NewIterator(rep_->options.comparator),
-      &Table::BlockReader, const_cast<Table*>(this), options);
+  Iterator* iter =
+      NewTwoLevelIterator(NewIndexIterator(options), &Table::BlockReader,
+                          const_cast<Table*>(this), options);
+  if (options.prefix_same_as_start && rep_->has_prefix_filter) {
+    iter = new PrefixSeekIterator(this, iter);
+  }
+  return iter;
+}
+
+bool Table::PrefixMayMatch(const Slice& key) const {
+  const SliceTransform* prefix_extractor = rep_->options.prefix_extractor;
+  if (!rep_->has_prefix_filter || !prefix_extractor->InDomain(key)) {
+    return true;
+  }
+  Cache::Handle* handle;
+  Status s;
+  IndexAndFilters* meta = GetIndexAndFilters(&handle, &s);
+  if (meta == nullptr) {
+    return true;  // Let the read report the error
+  }
+  const bool result =
+      meta->prefix_filter == nullptr ||
+      meta->prefix_filter->KeyMayMatch(prefix_extractor->Transform(key));
+  ReleaseIndexAndFilters(handle);
+  return result;
 }
 
 Status Table::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
                           void (*handle_result)(void*, const Slice&,
                                                 const Slice&)) {
+  Cache::Handle* meta_handle;
   Status s;
-  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  IndexAndFilters* meta = GetIndexAndFilters(&meta_handle, &s);
+  if (meta == nullptr) {
+    return s;
+  }
+  if (meta->full_filter != nullptr && !meta->full_filter->KeyMayMatch(k)) {
+    ReleaseIndexAndFilters(meta_handle);
+    return Status::OK();  // Not found
+  }
+
+  Iterator* iiter = NewIndexIterator(options, meta);
   iiter->Seek(k);
   if (iiter->Valid()) {
     Slice handle_value = iiter->value();
-    FilterBlockReader* filter = rep_->filter;
+    FilterBlockReader* filter = meta->filter;
     BlockHandle handle;
     if (filter != nullptr && handle.DecodeFrom(&handle_value).ok() &&
         !filter->KeyMayMatch(handle.offset(), k)) {
       // Not found
     } else {
-      Iterator* block_iter = BlockReader(this, options, iiter->value());
-      block_iter->Seek(k);
+      Iterator* block_iter =
+          NewBlockIterator(this, options, iiter->value(), true, &k);
       if (block_iter->Valid()) {
         (*handle_result)(arg, block_iter->key(), block_iter->value());
       }
@@ -240,12 +548,184 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
     s = iiter->status();
   }
   delete iiter;
+  ReleaseIndexAndFilters(meta_handle);
+  return s;
+}
+
+struct Table::MultiGetState {
+  // A data block that holds some of the keys, pinned until we are done.
+  struct PinnedBlock {
+    BlockHandle handle;
+    Block* block = nullptr;
+    Cache::Handle* cache_handle = nullptr;
+    Status status;
+  };
+
+  int n;
+  const Slice* keys;
+  Status status;  // Of walking the index block
+  std::vector<PinnedBlock> blocks;
+  std::vector<int> key_block;  // Index in blocks, or -1 if absent
+  // blocks[missing[r]] is read by reqs[first_req + r].
+  std::vector<size_t> missing;
+  size_t first_req;
+};
+
+Table::MultiGetState* Table::StartMultiGet(
+    const ReadOptions& options, int n, const Slice* keys,
+    std::vector<const RandomAccessFile*>* files,
+    std::vector<ReadRequest>* reqs) const {
+  const Comparator* comparator = rep_->options.comparator;
+  Cache* block_cache = rep_->options.block_cache;
+
+  MultiGetState* state = new MultiGetState;
+  state->n = n;
+  state->keys = keys;
+  state->key_block.resize(n, -1);
+  state->first_req = reqs->size();
+  std::vector<MultiGetState::PinnedBlock>& blocks = state->blocks;
+
+  // Find the block of each key, walking the index block once.
+  Cache::Handle* meta_handle;
+  Status& s = state->status;
+  IndexAndFilters* meta = GetIndexAndFilters(&meta_handle, &s);
+  if (meta == nullptr) {
+    return state;
+  }
+  Iterator* iiter = NewIndexIterator(options, meta);
+  for (int i = 0; i < n; i++) {
+    if (meta->full_filter != nullptr &&
+        !meta->full_filter->KeyMayMatch(keys[i])) {
+      continue;  // Not found
+    }
+    // Keys are sorted, so the block of keys[i] is at or after the block
+    // of the previous key.  Only seek if it is past the current one.
+    if (!iiter->Valid() || comparator->Compare(keys[i], iiter->key()) > 0) {
+      iiter->Seek(keys[i]);
+      if (!iiter->Valid()) {
+        break;  // This key and all later ones are past the last block
+      }
+    }
+    Slice handle_value = iiter->value();
+    BlockHandle handle;
+    s = handle.DecodeFrom(&handle_value);
+    if (!s.ok()) {
+      break;
+    }
+    FilterBlockReader* filter = meta->filter;
+    if (filter != nullptr && !filter->KeyMayMatch(handle.offset(), keys[i])) {
+      continue;  // Not found
+    }
+    if (blocks.empty() || blocks.back().handle.offset() != handle.offset()) {
+      blocks.emplace_back();
+      blocks.back().handle = handle;
+    }
+    state->key_block[i] = static_cast<int>(blocks.size()) - 1;
+  }
+  if (s.ok()) {
+    s = iiter->status();
+  }
+  delete iiter;
+  ReleaseIndexAndFilters(meta_handle);
+
+  // Pin the blocks that are cached, and leave the others to be read.
+  char cache_key_buffer[16];
+  EncodeFixed64(cache_key_buffer, rep_->cache_id);
+  const Slice cache_key(cache_key_buffer, sizeof(cache_key_buffer));
+  for (size_t b = 0; b < blocks.size(); b++) {
+    if (block_cache != nullptr) {
+      EncodeFixed64(cache_key_buffer + 8, blocks[b].handle.offset());
+      blocks[b].cache_handle = block_cache->Lookup(cache_key);
+      if (blocks[b].cache_handle != nullptr) {
+        blocks[b].block =
+            reinterpret_cast<Block*>(block_cache->Value(blocks[b].cache_handle));
+        continue;
+      }
+    }
+    state->missing.push_back(b);
+    ReadRequest req;
+    req.offset = blocks[b].handle.offset();
+    req.n = BlockReadSize(blocks[b].handle);
+    req.scratch = new char[req.n];
+    reqs->push_back(req);
+    files->push_back(rep_->file);
+  }
+  return state;
+}
+
+Status Table::FinishMultiGet(MultiGetState* state, const ReadOptions& options,
+                             ReadRequest* reqs, void* arg,
+                             void (*handle_result)(void*, int, const Slice&,
+                                                   const Slice&)) const {
+  const Comparator* comparator = rep_->options.comparator;
+  Cache* block_cache = rep_->options.block_cache;
+  std::vector<MultiGetState::PinnedBlock>& blocks = state->blocks;
+  Status s = state->status;
+
+  // Decode the blocks that were read.
+  char cache_key_buffer[16];
+  EncodeFixed64(cache_key_buffer, rep_->cache_id);
+  const Slice cache_key(cache_key_buffer, sizeof(cache_key_buffer));
+  for (size_t r = 0; r < state->missing.size(); r++) {
+    ReadRequest* req = &reqs[state->first_req + r];
+    MultiGetState::PinnedBlock* pinned = &blocks[state->missing[r]];
+    if (!req->status.ok()) {
+      delete[] req->scratch;
+      pinned->status = req->status;
+      continue;
+    }
+    BlockContents contents;
+    pinned->status = DecodeBlock(req->scratch, req->result, options,
+                                 pinned->handle, &contents);
+    if (!pinned->status.ok()) {
+      continue;
+    }
+    pinned->block = new Block(contents, rep_->data_block_hash_index);
+    if (block_cache != nullptr && contents.cachable && options.fill_cache) {
+      EncodeFixed64(cache_key_buffer + 8, pinned->handle.offset());
+      pinned->cache_handle =
+          block_cache->Insert(cache_key, pinned->block, pinned->block->size(),
+                              &DeleteCachedBlock);
+    }
+  }
+
+  // Search each block for its keys.
+  Iterator* block_iter = nullptr;
+  int iter_block = -1;
+  for (int i = 0; i < state->n; i++) {
+    const int b = state->key_block[i];
+    if (b < 0) continue;
+    if (!blocks[b].status.ok()) {
+      if (s.ok()) s = blocks[b].status;
+      continue;
+    }
+    if (b != iter_block) {
+      delete block_iter;
+      block_iter = blocks[b].block->NewIterator(comparator);
+      iter_block = b;
+    }
+    block_iter->Seek(state->keys[i]);
+    if (block_iter->Valid()) {
+      (*handle_result)(arg, i, block_iter->key(), block_iter->value());
+    } else if (s.ok()) {
+      s = block_iter->status();
+    }
+  }
+  delete block_iter;
+
+  for (MultiGetState::PinnedBlock& pinned : blocks) {
+    if (pinned.cache_handle != nullptr) {
+      block_cache->Release(pinned.cache_handle);
+    } else {
+      delete pinned.block;
+    }
+  }
+  delete state;
   return s;
 }
 
 uint64_t Table::ApproximateOffsetOf(const Slice& key) const {
-  Iterator* index_iter =
-      rep_->index_block->NewIterator(rep_->options.comparator);
+  Iterator* index_iter = NewIndexIterator(ReadOptions());
   index_iter->Seek(key);
   uint64_t result;
   if (index_iter->Valid()) {
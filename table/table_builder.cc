@@ -5,11 +5,15 @@
 #include "leveldb/table_builder.h"
 
 #include <cassert>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/slice_transform.h"
 #include "table/block_builder.h"
 #include "table/filter_block.h"
 #include "table/format.h"
@@ -24,17 +28,30 @@ struct TableBuilder::Rep {
         index_block_options(opt),
         file(f),
         offset(0),
-        data_block(&options),
+        data_block(&options, opt.data_block_hash_index),
         index_block(&index_block_options),
         num_entries(0),
         closed(false),
-        filter_block(opt.filter_policy == nullptr
+        filter_block(opt.filter_policy == nullptr || opt.full_table_filter
                          ? nullptr
                          : new FilterBlockBuilder(opt.filter_policy)),
+        full_filter_block(opt.filter_policy == nullptr || !opt.full_table_filter
+                              ? nullptr
+                              : new FullFilterBlockBuilder(opt.filter_policy)),
+        prefix_filter_block(
+            opt.filter_policy == nullptr || opt.prefix_extractor == nullptr
+                ? nullptr
+                : new FullFilterBlockBuilder(opt.filter_policy)),
         pending_index_entry(false) {
     index_block_options.block_restart_interval = 1;
   }
 
+  // Moves the entries of index_block into a new index partition.
+  void FinishIndexPartition() {
+    index_partitions.emplace_back(last_key, index_block.Finish().ToString());
+    index_block.Reset();
+  }
+
   Options options;
   Options index_block_options;
   WritableFile* file;
@@ -46,6 +63,9 @@ struct TableBuilder::Rep {
   int64_t num_entries;
   bool closed;  // Either Finish() or Abandon() has been called.
   FilterBlockBuilder* filter_block;
+  FullFilterBlockBuilder* full_filter_block;
+  FullFilterBlockBuilder* prefix_filter_block;
+  std::string last_prefix;  // Last key added to prefix_filter_block
 
   // We do not emit the index entry for a block until we have seen the
   // first key for the next data block.  This allows us to use shorter
@@ -61,6 +81,12 @@ struct TableBuilder::Rep {
   bool pending_index_entry;
   BlockHandle pending_handle;  // Handle to add to index block
 
+  // Finished index partitions if options.index_partition_size is set, as
+  // (last key, block contents) pairs.  They are written out in Finish(),
+  // after the data blocks, and index_block then holds the current
+  // partition.
+  std::vector<std::pair<std::string, std::string>> index_partitions;
+
   std::string compressed_output;
 };
 
@@ -74,6 +100,8 @@ TableBuilder::TableBuilder(const Options& options, WritableFile* file)
 TableBuilder::~TableBuilder() {
   assert(rep_->closed);  // Catch errors where caller forgot to call Finish()
   delete rep_->filter_block;
+  delete rep_->full_filter_block;
+  delete rep_->prefix_filter_block;
   delete rep_;
 }
 
@@ -84,6 +112,18 @@ Status TableBuilder::ChangeOptions(const Options& options) {
   if (options.comparator != rep_->options.comparator) {
     return Status::InvalidArgument("changing comparator while building table");
   }
+  if (options.full_table_filter != rep_->options.full_table_filter) {
+    return Status::InvalidArgument(
+        "changing filter granularity while building table");
+  }
+  if (options.prefix_extractor != rep_->options.prefix_extractor) {
+    return Status::InvalidArgument(
+        "changing prefix extractor while building table");
+  }
+  if (options.data_block_hash_index != rep_->options.data_block_hash_index) {
+    return Status::InvalidArgument(
+        "changing data block hash index while building table");
+  }
 
   // Note that any live BlockBuilders point to rep_->options and therefore
   // will automatically pick up the updated options.
@@ -108,11 +148,27 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
     r->pending_handle.EncodeTo(&handle_encoding);
     r->index_block.Add(r->last_key, Slice(handle_encoding));
     r->pending_index_entry = false;
+    if (r->options.index_partition_size > 0 &&
+        r->index_block.CurrentSizeEstimate() >=
+            r->options.index_partition_size) {
+      r->FinishIndexPartition();
+    }
   }
 
   if (r->filter_block != nullptr) {
     r->filter_block->AddKey(key);
   }
+  if (r->full_filter_block != nullptr) {
+    r->full_filter_block->AddKey(key);
+  }
+  if (r->prefix_filter_block != nullptr &&
+      r->options.prefix_extractor->InDomain(key)) {
+    const Slice prefix = r->options.prefix_extractor->Transform(key);
+    if (prefix != Slice(r->last_prefix)) {
+      r->prefix_filter_block->AddKey(prefix);
+      r->last_prefix.assign(prefix.data(), prefix.size());
+    }
+  }
 
   r->last_key.assign(key.data(), key.size());
   r->num_entries++;
@@ -146,10 +202,14 @@ void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle) {
   //    block_data: uint8[n]
   //    type: uint8
   //    crc: uint32
+  CompressAndWriteBlock(block->Finish(), handle);
+  block->Reset();
+}
+
+void TableBuilder::CompressAndWriteBlock(const Slice& raw,
+                                         BlockHandle* handle) {
   assert(ok());
   Rep* r = rep_;
-  Slice raw = block->Finish();
-
   Slice block_contents;
   CompressionType type = r->options.compression;
   // TODO(postrelease): Support more compression options: zlib?
@@ -190,7 +250,6 @@ void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle) {
   }
   WriteRawBlock(block_contents, type, handle);
   r->compressed_output.clear();
-  block->Reset();
 }
 
 void TableBuilder::WriteRawBlock(const Slice& block_contents,
@@ -220,13 +279,26 @@ Status TableBuilder::Finish() {
   assert(!r->closed);
   r->closed = true;
 
-  BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+  BlockHandle filter_block_handle, prefix_filter_block_handle,
+      metaindex_block_handle, index_block_handle;
+  uint32_t footer_flags = 0;
+  if (r->options.data_block_hash_index) {
+    footer_flags |= Footer::kDataBlockHashIndex;
+  }
 
   // Write filter block
   if (ok() && r->filter_block != nullptr) {
     WriteRawBlock(r->filter_block->Finish(), kNoCompression,
                   &filter_block_handle);
   }
+  if (ok() && r->full_filter_block != nullptr) {
+    WriteRawBlock(r->full_filter_block->Finish(), kNoCompression,
+                  &filter_block_handle);
+  }
+  if (ok() && r->prefix_filter_block != nullptr) {
+    WriteRawBlock(r->prefix_filter_block->Finish(), kNoCompression,
+                  &prefix_filter_block_handle);
+  }
 
   // Write metaindex block
   if (ok()) {
@@ -239,6 +311,23 @@ Status TableBuilder::Finish() {
       filter_block_handle.EncodeTo(&handle_encoding);
       meta_index_block.Add(key, handle_encoding);
     }
+    if (r->full_filter_block != nullptr) {
+      // Add mapping from "fullfilter.Name" to location of filter data
+      std::string key = "fullfilter.";
+      key.append(r->options.filter_policy->Name());
+      std::string handle_encoding;
+      filter_block_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add(key, handle_encoding);
+    }
+    if (r->prefix_filter_block != nullptr) {
+      // Add mapping from "prefixfilter.Name.Prefix" to location of filter
+      // data
+      std::string handle_encoding;
+      prefix_filter_block_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add(PrefixFilterMetaKey(r->options.filter_policy,
+                                               r->options.prefix_extractor),
+                           handle_encoding);
+    }
 
     // TODO(postrelease): Add stats and other meta blocks
     WriteBlock(&meta_index_block, &metaindex_block_handle);
@@ -253,6 +342,25 @@ Status TableBuilder::Finish() {
       r->index_block.Add(r->last_key, Slice(handle_encoding));
       r->pending_index_entry = false;
     }
+    if (r->options.index_partition_size > 0 || !r->index_partitions.empty()) {
+      // Write the partitions, then a top-level index that maps the last
+      // key of each partition to its location.
+      if (!r->index_block.empty()) {
+        r->FinishIndexPartition();
+      }
+      footer_flags |= Footer::kPartitionedIndex;
+      for (const auto& partition : r->index_partitions) {
+        BlockHandle partition_handle;
+        CompressAndWriteBlock(partition.second, &partition_handle);
+        if (!ok()) break;
+        std::string handle_encoding;
+        partition_handle.EncodeTo(&handle_encoding);
+        r->index_block.Add(partition.first, Slice(handle_encoding));
+      }
+      r->index_partitions.clear();
+    }
+  }
+  if (ok()) {
     WriteBlock(&r->index_block, &index_block_handle);
   }
 
@@ -261,6 +369,7 @@ Status TableBuilder::Finish() {
     Footer footer;
     footer.set_metaindex_handle(metaindex_block_handle);
     footer.set_index_handle(index_block_handle);
+    footer.set_flags(footer_flags);
     std::string footer_encoding;
     footer.EncodeTo(&footer_encoding);
     r->status = r->file->Append(footer_encoding);
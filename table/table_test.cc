@@ -4,6 +4,8 @@
 
 #include "leveldb/table.h"
 
+#include <cstdio>
+#include <cstring>
 #include <map>
 #include <string>
 
@@ -11,8 +13,10 @@
 #include "db/dbformat.h"
 #include "db/memtable.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/cache.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
 #include "leveldb/table_builder.h"
@@ -182,7 +186,7 @@ class BlockConstructor : public Constructor {
   Status FinishImpl(const Options& options, const KVMap& data) override {
     delete block_;
     block_ = nullptr;
-    BlockBuilder builder(&options);
+    BlockBuilder builder(&options, options.data_block_hash_index);
 
     for (const auto& kvp : data) {
       builder.Add(kvp.first, kvp.second);
@@ -193,7 +197,7 @@ class BlockConstructor : public Constructor {
     contents.data = data_;
     contents.cachable = false;
     contents.heap_allocated = false;
-    block_ = new Block(contents);
+    block_ = new Block(contents, options.data_block_hash_index);
     return Status::OK();
   }
   Iterator* NewIterator() const override {
@@ -231,6 +235,10 @@ class TableConstructor : public Constructor {
     source_ = new StringSource(sink.contents());
     Options table_options;
     table_options.comparator = options.comparator;
+    table_options.filter_policy = options.filter_policy;
+    table_options.block_cache = options.block_cache;
+    table_options.cache_index_and_filter_blocks =
+        options.cache_index_and_filter_blocks;
     return Table::Open(table_options, source_, sink.contents().size(), &table_);
   }
 
@@ -377,30 +385,43 @@ struct TestArgs {
   TestType type;
   bool reverse_compare;
   int restart_interval;
+  size_t index_partition_size;
+  bool data_block_hash_index;
 };
 
 static const TestArgs kTestArgList[] = {
-    {TABLE_TEST, false, 16},
-    {TABLE_TEST, false, 1},
-    {TABLE_TEST, false, 1024},
-    {TABLE_TEST, true, 16},
-    {TABLE_TEST, true, 1},
-    {TABLE_TEST, true, 1024},
-
-    {BLOCK_TEST, false, 16},
-    {BLOCK_TEST, false, 1},
-    {BLOCK_TEST, false, 1024},
-    {BLOCK_TEST, true, 16},
-    {BLOCK_TEST, true, 1},
-    {BLOCK_TEST, true, 1024},
+    {TABLE_TEST, false, 16, 0, false},
+    {TABLE_TEST, false, 1, 0, false},
+    {TABLE_TEST, false, 1024, 0, false},
+    {TABLE_TEST, true, 16, 0, false},
+    {TABLE_TEST, true, 1, 0, false},
+    {TABLE_TEST, true, 1024, 0, false},
+
+    // Index partitions of a few entries each
+    {TABLE_TEST, false, 16, 64, false},
+    {TABLE_TEST, true, 16, 64, false},
+
+    // Data blocks with a hash index
+    {TABLE_TEST, false, 16, 0, true},
+    {TABLE_TEST, true, 1, 0, true},
+
+    {BLOCK_TEST, false, 16, 0, false},
+    {BLOCK_TEST, false, 1, 0, false},
+    {BLOCK_TEST, false, 1024, 0, false},
+    {BLOCK_TEST, true, 16, 0, false},
+    {BLOCK_TEST, true, 1, 0, false},
+    {BLOCK_TEST, true, 1024, 0, false},
+    {BLOCK_TEST, false, 16, 0, true},
+    {BLOCK_TEST, true, 1, 0, true},
 
     // Restart interval does not matter for memtables
-    {MEMTABLE_TEST, false, 16},
-    {MEMTABLE_TEST, true, 16},
+    {MEMTABLE_TEST, false, 16, 0, false},
+    {MEMTABLE_TEST, true, 16, 0, false},
 
     // Do not bother with restart interval variations for DB
-    {DB_TEST, false, 16},
-    {DB_TEST, true, 16},
+    {DB_TEST, false, 16, 0, false},
+    {DB_TEST, true, 16, 0, false},
+    {DB_TEST, false, 16, 0, true},
 };
 static const int kNumTestArgs = sizeof(kTestArgList) / sizeof(kTestArgList[0]);
 
@@ -414,6 +435,8 @@ class Harness : public testing::Test {
     options_ = Options();
 
     options_.block_restart_interval = args.restart_interval;
+    options_.index_partition_size = args.index_partition_size;
+    options_.data_block_hash_index = args.data_block_hash_index;
     // Use shorter block size for tests to exercise block boundary
     // conditions more.
     options_.block_size = 256;
@@ -700,7 +723,7 @@ TEST_F(Harness, Randomized) {
 
 TEST_F(Harness, RandomizedLongDB) {
   Random rnd(test::RandomSeed());
-  TestArgs args = {DB_TEST, false, 16};
+  TestArgs args = {DB_TEST, false, 16, 0, false};
   Init(args);
   int num_entries = 100000;
   for (int e = 0; e < num_entries; e++) {
@@ -785,6 +808,168 @@ TEST(TableTest, ApproximateOffsetOfPlain) {
   ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 610000, 612000));
 }
 
+TEST(TableTest, ApproximateOffsetOfPartitionedIndex) {
+  TableConstructor c(BytewiseComparator());
+  c.Add("k01", "hello");
+  c.Add("k02", "hello2");
+  c.Add("k03", std::string(10000, 'x'));
+  c.Add("k04", std::string(200000, 'x'));
+  c.Add("k05", std::string(300000, 'x'));
+  c.Add("k06", "hello3");
+  c.Add("k07", std::string(100000, 'x'));
+  std::vector<std::string> keys;
+  KVMap kvmap;
+  Options options;
+  options.block_size = 1024;
+  options.compression = kNoCompression;
+  options.index_partition_size = 1;  // One index entry per partition
+  c.Finish(options, &keys, &kvmap);
+
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("abc"), 0, 0));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k03"), 0, 0));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k04"), 10000, 11000));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k05"), 210000, 211000));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k07"), 510000, 511000));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 610000, 612000));
+}
+
+// Returns an internal key-like key: user_key followed by 8 bytes of
+// sequence number and type.
+static std::string HashIndexKey(const std::string& user_key, uint64_t seq) {
+  std::string key = user_key;
+  key.append(7, '\0');
+  key.push_back(static_cast<char>(10 - seq));  // Newest first, bytewise
+  return key;
+}
+
+TEST(BlockTest, HashIndexPointLookup) {
+  for (int restart_interval : {1, 4, 16}) {
+    Options options;
+    options.block_restart_interval = restart_interval;
+    BlockBuilder builder(&options, true);
+    // More restart points than fit in a bucket for restart_interval 1.
+    for (int i = 0; i < 600; i += 2) {
+      char user_key[16];
+      std::snprintf(user_key, sizeof(user_key), "key%06d", i);
+      for (uint64_t seq = 3; seq > 0; seq--) {
+        builder.Add(HashIndexKey(user_key, seq), "v" + std::to_string(seq));
+      }
+    }
+    const std::string data = builder.Finish().ToString();
+    BlockContents contents;
+    contents.data = data;
+    contents.cachable = false;
+    contents.heap_allocated = false;
+    Block block(contents, true);
+
+    Iterator* iter = block.NewIterator(BytewiseComparator());
+    for (int i = 0; i < 600; i++) {
+      char user_key[16];
+      std::snprintf(user_key, sizeof(user_key), "key%06d", i);
+      for (uint64_t seq = 4; seq > 0; seq--) {
+        const std::string target = HashIndexKey(user_key, seq);
+        iter->Seek(target);
+        Iterator* lookup =
+            block.NewPointLookupIterator(BytewiseComparator(), target);
+        if (i % 2 == 0) {
+          // Present user keys are found like Seek() finds them.
+          ASSERT_TRUE(iter->Valid());
+          ASSERT_TRUE(lookup->Valid()) << i << " " << seq;
+          ASSERT_EQ(iter->key().ToString(), lookup->key().ToString());
+          ASSERT_EQ(iter->value().ToString(), lookup->value().ToString());
+        } else if (lookup->Valid()) {
+          // Absent user keys are not found.
+          ASSERT_GT(lookup->key().ToString(), target);
+          ASSERT_NE(std::string(user_key),
+                    lookup->key().ToString().substr(0, strlen(user_key)));
+        }
+        ASSERT_LEVELDB_OK(lookup->status());
+        delete lookup;
+      }
+    }
+    delete iter;
+  }
+}
+
+TEST(TableTest, CacheIndexAndFilterBlocks) {
+  const FilterPolicy* filter_policy = NewBloomFilterPolicy(10);
+  Cache* block_cache = NewLRUCache(1 << 20, 0.5);
+  {  // Closes the table before the cache is deleted
+    TableConstructor c(BytewiseComparator());
+    for (int i = 0; i < 1000; i++) {
+      char key[16];
+      std::snprintf(key, sizeof(key), "k%05d", i);
+      c.Add(key, std::string(100, 'x'));
+    }
+    std::vector<std::string> keys;
+    KVMap kvmap;
+    Options options;
+    options.block_size = 1024;
+    options.compression = kNoCompression;
+    options.filter_policy = filter_policy;
+    options.block_cache = block_cache;
+    options.cache_index_and_filter_blocks = true;
+    c.Finish(options, &keys, &kvmap);
+
+    // The index and filter blocks are charged to the block cache.
+    const size_t meta_charge = block_cache->TotalCharge();
+    ASSERT_GT(meta_charge, 100 * 20);
+
+    // And are read back after they are evicted.
+    for (int round = 0; round < 2; round++) {
+      block_cache->Prune();
+      ASSERT_EQ(0, block_cache->TotalCharge());
+      Iterator* iter = c.NewIterator();
+      iter->Seek("k00500");
+      ASSERT_TRUE(iter->Valid());
+      ASSERT_EQ("k00500", iter->key().ToString());
+      ASSERT_TRUE(Between(c.ApproximateOffsetOf("k00500"), 50000, 60000));
+      delete iter;
+      ASSERT_GT(block_cache->TotalCharge(), meta_charge);
+    }
+  }
+
+  delete block_cache;
+  delete filter_policy;
+}
+
+TEST(TableTest, CachedIndexAndFilterBlocksErasedOnClose) {
+  const FilterPolicy* filter_policy = NewBloomFilterPolicy(10);
+  Cache* block_cache = NewLRUCache(1 << 20, 0.5);
+  Options options;
+  options.filter_policy = filter_policy;
+  options.block_cache = block_cache;
+  options.cache_index_and_filter_blocks = true;
+
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  for (int i = 0; i < 1000; i++) {
+    char key[16];
+    std::snprintf(key, sizeof(key), "k%05d", i);
+    builder.Add(key, std::string(100, 'x'));
+  }
+  ASSERT_LEVELDB_OK(builder.Finish());
+  StringSource source(sink.contents());
+
+  Table* tables[2];
+  for (Table*& table : tables) {
+    ASSERT_LEVELDB_OK(
+        Table::Open(options, &source, sink.contents().size(), &table));
+  }
+  const size_t meta_charge = block_cache->TotalCharge() / 2;
+  ASSERT_GT(meta_charge, 0);
+
+  // Closing a table drops its index and filter blocks from the cache, but
+  // leaves those of the other table alone.
+  delete tables[0];
+  ASSERT_EQ(meta_charge, block_cache->TotalCharge());
+  delete tables[1];
+  ASSERT_EQ(0, block_cache->TotalCharge());
+
+  delete block_cache;
+  delete filter_policy;
+}
+
 static bool CompressionSupported(CompressionType type) {
   std::string out;
   Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
@@ -4,26 +4,72 @@
 
 #include "util/arena.h"
 
+#if HAVE_MAP_HUGETLB
+#include <sys/mman.h>
+#endif  // HAVE_MAP_HUGETLB
+
+#include <algorithm>
+#include <new>
+#include <thread>
+
+#include "util/mutexlock.h"
+
 namespace leveldb {
 
 // 一个块的大小, 一般情况下, 用该大小来调用 new 获得新内存
 static const int kBlockSize = 4096;
 
+static const size_t kMaxShardBlockSize = 128 * 1024;
+
+static size_t NumShards() {
+  size_t cores = std::thread::hardware_concurrency();
+  size_t shards = 1;
+  while (shards < cores) {
+    shards *= 2;
+  }
+  return shards;
+}
+
 // 默认为空
-Arena::Arena()
-    : alloc_ptr_(nullptr), alloc_bytes_remaining_(0), memory_usage_(0) {}
+Arena::Arena(size_t huge_page_size)
+    : block_size_(huge_page_size > 0 ? huge_page_size : kBlockSize),
+      huge_page_size_(huge_page_size),
+      shard_block_size_(std::max<size_t>(
+          kBlockSize, std::min(kMaxShardBlockSize, block_size_ / 8))),
+      alloc_ptr_(nullptr),
+      alloc_bytes_remaining_(0),
+      memory_usage_(0),
+      num_shards_(NumShards()),
+      shard_storage_(
+          new char[num_shards_ * sizeof(Shard) + alignof(Shard) - 1]) {
+  uintptr_t start = reinterpret_cast<uintptr_t>(shard_storage_);
+  start = (start + alignof(Shard) - 1) & ~(uintptr_t{alignof(Shard)} - 1);
+  shards_ = reinterpret_cast<Shard*>(start);
+  for (size_t i = 0; i < num_shards_; i++) {
+    new (&shards_[i]) Shard();
+  }
+}
 
 Arena::~Arena() {
   for (size_t i = 0; i < blocks_.size(); i++) {
     delete[] blocks_[i];
   }
+#if HAVE_MAP_HUGETLB
+  for (size_t i = 0; i < huge_blocks_.size(); i++) {
+    munmap(huge_blocks_[i].first, huge_blocks_[i].second);
+  }
+#endif  // HAVE_MAP_HUGETLB
+  for (size_t i = 0; i < num_shards_; i++) {
+    shards_[i].~Shard();
+  }
+  delete[] shard_storage_;
 }
 
 /**
  * 进入该函数, 说明当前 分配状态 已经不足以满足分配需求
  */
 char* Arena::AllocateFallback(size_t bytes) {
-  if (bytes > kBlockSize / 4) {
+  if (bytes > block_size_ / 4) {
     // Object is more than a quarter of our block size.  Allocate it separately
     // to avoid wasting too much space in leftover bytes.
     // 为了避免浪费剩余字节
@@ -36,8 +82,9 @@ char* Arena::AllocateFallback(size_t bytes) {
   // We waste the remaining space in the current block.
   // 浪费当前块的剩余字节
   // 分配一个新的块
-  alloc_ptr_ = AllocateNewBlock(kBlockSize);
-  alloc_bytes_remaining_ = kBlockSize;
+  alloc_ptr_ = huge_page_size_ > 0 ? AllocateHugePageBlock(block_size_)
+                                   : AllocateNewBlock(block_size_);
+  alloc_bytes_remaining_ = block_size_;
 
   // 满足分配请求, 更新 分配状态
   char* result = alloc_ptr_;
@@ -78,6 +125,53 @@ char* Arena::AllocateAligned(size_t bytes) {
   return result;
 }
 
+char* Arena::AllocateConcurrently(size_t bytes) {
+  return AllocateFromShard(bytes, 1);
+}
+
+char* Arena::AllocateAlignedConcurrently(size_t bytes) {
+  return AllocateFromShard(bytes, (sizeof(void*) > 8) ? sizeof(void*) : 8);
+}
+
+Arena::Shard* Arena::CurrentShard() {
+  // Threads are numbered in the order they first allocate and keep using
+  // the shard their number picks, so up to num_shards_ threads each get a
+  // shard of their own.  (Thread id hashes are often just the pthread_t
+  // address, whose low bits are the same for every thread.)
+  static std::atomic<size_t> next_thread_index(0);
+  static thread_local size_t thread_index =
+      next_thread_index.fetch_add(1, std::memory_order_relaxed);
+  return &shards_[thread_index & (num_shards_ - 1)];
+}
+
+char* Arena::AllocateFromShard(size_t bytes, size_t align) {
+  assert(bytes > 0);
+  if (bytes > shard_block_size_ / 4) {
+    // Too large to carve out of a shard without wasting much of it.
+    MutexLock l(&mu_);
+    return AllocateAligned(bytes);
+  }
+
+  Shard* shard = CurrentShard();
+  MutexLock l(&shard->mu);
+  size_t current_mod =
+      reinterpret_cast<uintptr_t>(shard->alloc_ptr) & (align - 1);
+  size_t slop = (current_mod == 0 ? 0 : align - current_mod);
+  if (bytes + slop > shard->alloc_bytes_remaining) {
+    // Waste the rest of the shard's chunk and take a new one.
+    {
+      MutexLock arena_lock(&mu_);
+      shard->alloc_ptr = AllocateAligned(shard_block_size_);
+    }
+    shard->alloc_bytes_remaining = shard_block_size_;
+    slop = 0;
+  }
+  char* result = shard->alloc_ptr + slop;
+  shard->alloc_ptr += bytes + slop;
+  shard->alloc_bytes_remaining -= bytes + slop;
+  return result;
+}
+
 /**
  * 使用 new 分配一个新的 block (char数组)
  */
@@ -89,4 +183,20 @@ char* Arena::AllocateNewBlock(size_t block_bytes) {
   return result;
 }
 
+char* Arena::AllocateHugePageBlock(size_t block_bytes) {
+#if HAVE_MAP_HUGETLB
+  void* addr = mmap(nullptr, block_bytes, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (addr != MAP_FAILED) {
+    char* result = reinterpret_cast<char*>(addr);
+    huge_blocks_.push_back(std::make_pair(result, block_bytes));
+    memory_usage_.fetch_add(block_bytes + sizeof(char*),
+                            std::memory_order_relaxed);
+    return result;
+  }
+#endif  // HAVE_MAP_HUGETLB
+  // No huge pages reserved (or not supported): use ordinary memory.
+  return AllocateNewBlock(block_bytes);
+}
+
 }  // namespace leveldb
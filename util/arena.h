@@ -9,13 +9,20 @@
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <utility>
 #include <vector>
 
+#include "port/port.h"
+
 namespace leveldb {
 
 class Arena {
  public:
-  Arena();
+  // If huge_page_size is non-zero, small allocations are carved out of
+  // chunks of huge_page_size bytes that are mapped with huge pages when
+  // the OS has them available (and are ordinary memory otherwise).  This
+  // reduces TLB misses when walking structures spread over a large arena.
+  explicit Arena(size_t huge_page_size = 0);
 
   // 不可 拷贝构造 和 拷贝赋值
   Arena(const Arena&) = delete;
@@ -31,6 +38,13 @@ class Arena {
   // 分配内存 [带有 (正常的) 对齐保证 - 像 malloc 提供的一样]
   char* AllocateAligned(size_t bytes);
 
+  // Thread-safe variants of Allocate() and AllocateAligned().  They may be
+  // called from several threads at once, but not concurrently with the
+  // variants above.  Small allocations are served from per-thread shards
+  // so that concurrent callers rarely contend on a lock.
+  char* AllocateConcurrently(size_t bytes);
+  char* AllocateAlignedConcurrently(size_t bytes);
+
   // Returns an estimate of the total memory usage of data allocated
   // by the arena.
   // 返回由 arena 分配的数据的总内存使用量的 估计值
@@ -39,8 +53,25 @@ class Arena {
   }
 
  private:
+  // A chunk of memory that concurrent allocations are carved out of.
+  // Aligned to a cache line so that shards do not share lines.
+  struct alignas(64) Shard {
+    port::Mutex mu;
+    char* alloc_ptr = nullptr;
+    size_t alloc_bytes_remaining = 0;
+  };
+
   char* AllocateFallback(size_t bytes);
   char* AllocateNewBlock(size_t block_bytes);
+  char* AllocateHugePageBlock(size_t block_bytes);
+  char* AllocateFromShard(size_t bytes, size_t align);
+  Shard* CurrentShard();
+
+  // Size of the blocks that small allocations are carved out of.
+  const size_t block_size_;
+  const size_t huge_page_size_;
+  // Size of the chunks that shards take from the arena.
+  const size_t shard_block_size_;
 
   // Allocation state
   // 分配状态 (表明 当前块 分配的状态)
@@ -53,12 +84,27 @@ class Arena {
   // 使用 new[] 分配的内存块(s): 也就是实际分配的内存
   std::vector<char*> blocks_;
 
+  // Blocks mapped with huge pages, and their sizes.
+  std::vector<std::pair<char*, size_t>> huge_blocks_;
+
   // Total memory usage of the arena.
   //
   // TODO(costan): This member is accessed via atomics, but the others are
   //               accessed without any locking. Is this OK?
   // arena 的 内存使用总量
   std::atomic<size_t> memory_usage_;
+
+  // Serializes the *Concurrently() allocation methods' use of the state
+  // above.
+  port::Mutex mu_;
+
+  // Power of two number of shards, at least the number of cores.  The
+  // shards are constructed in shard_storage_, which is over-allocated so
+  // that they can start on a cache line (new[] only guarantees the
+  // alignment of max_align_t before C++17).
+  size_t num_shards_;
+  char* shard_storage_;
+  Shard* shards_;
 };
 
 inline char* Arena::Allocate(size_t bytes) {
@@ -4,8 +4,11 @@
 
 #include "util/arena.h"
 
+#include <cstring>
+
 #include "gtest/gtest.h"
 #include "util/random.h"
+#include "util/testutil.h"
 
 namespace leveldb {
 
@@ -69,4 +72,83 @@ TEST(ArenaTest, Simple) {
   }
 }
 
+TEST(ArenaTest, HugePages) {
+  // Works whether or not the OS has huge pages reserved.
+  const size_t kHugePageSize = 2 * 1024 * 1024;
+  Arena arena(kHugePageSize);
+  std::vector<std::pair<size_t, char*>> allocated;
+  size_t bytes = 0;
+  Random rnd(301);
+  for (int i = 0; i < 100000; i++) {
+    size_t s = rnd.Uniform(200) + 1;
+    char* r = rnd.OneIn(10) ? arena.AllocateAligned(s) : arena.Allocate(s);
+    std::memset(r, i % 256, s);
+    bytes += s;
+    allocated.push_back(std::make_pair(s, r));
+  }
+  // Small allocations are carved out of whole chunks, so at most the
+  // last chunk is mostly unused.
+  ASSERT_GE(arena.MemoryUsage(), bytes);
+  ASSERT_LE(arena.MemoryUsage(), bytes * 1.01 + kHugePageSize);
+  for (size_t i = 0; i < allocated.size(); i++) {
+    for (size_t b = 0; b < allocated[i].first; b++) {
+      ASSERT_EQ(int(allocated[i].second[b]) & 0xff, i % 256);
+    }
+  }
+}
+
+// Several threads allocating from the same arena.
+static const int kAllocThreads = 4;
+static const int kAllocationsPerThread = 20000;
+
+struct ConcurrentArenaState {
+  explicit ConcurrentArenaState(size_t huge_page_size)
+      : arena(huge_page_size) {}
+
+  Arena arena;
+  std::vector<std::pair<size_t, char*>> allocated[kAllocThreads];
+};
+
+static void ConcurrentAllocator(void* arg, int id) {
+  ConcurrentArenaState* state = reinterpret_cast<ConcurrentArenaState*>(arg);
+  Random rnd(301 + id);
+  for (int i = 0; i < kAllocationsPerThread; i++) {
+    // Mostly small allocations, with the occasional one too large for a
+    // shard.
+    size_t s = rnd.OneIn(1000) ? rnd.Uniform(100000) + 1 : rnd.Uniform(100) + 1;
+    char* r;
+    if (rnd.OneIn(2)) {
+      r = state->arena.AllocateAlignedConcurrently(s);
+      ASSERT_EQ(0, reinterpret_cast<uintptr_t>(r) & 7);
+    } else {
+      r = state->arena.AllocateConcurrently(s);
+    }
+    std::memset(r, id, s);
+    state->allocated[id].push_back(std::make_pair(s, r));
+  }
+}
+
+static void CheckConcurrentAllocations(size_t huge_page_size) {
+  ConcurrentArenaState state(huge_page_size);
+  test::RunConcurrently(kAllocThreads, ConcurrentAllocator, &state);
+
+  // No allocation was handed out twice.
+  size_t bytes = 0;
+  for (int id = 0; id < kAllocThreads; id++) {
+    for (const auto& a : state.allocated[id]) {
+      bytes += a.first;
+      for (size_t b = 0; b < a.first; b++) {
+        ASSERT_EQ(id, a.second[b]);
+      }
+    }
+  }
+  ASSERT_GE(state.arena.MemoryUsage(), bytes);
+}
+
+TEST(ArenaTest, AllocateConcurrently) { CheckConcurrentAllocations(0); }
+
+TEST(ArenaTest, AllocateConcurrentlyWithHugePages) {
+  CheckConcurrentAllocations(2 * 1024 * 1024);
+}
+
 }  // namespace leveldb
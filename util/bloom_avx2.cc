@@ -0,0 +1,61 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// This file is built with -mavx2 if HAVE_AVX2 is set, so it must not be
+// called into on CPUs without AVX2 except through
+// CanUseCacheLocalBloomProbesAVX2().
+
+#include "util/bloom_avx2.h"
+
+#include <cassert>
+
+#include "port/port.h"
+
+#if HAVE_AVX2
+#include <immintrin.h>
+#endif  // HAVE_AVX2
+
+namespace leveldb {
+
+bool CanUseCacheLocalBloomProbesAVX2() {
+#if HAVE_AVX2
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif  // HAVE_AVX2
+}
+
+bool CacheLocalBloomProbesAVX2(const char* block, uint32_t h, int k,
+                               const uint32_t* multipliers) {
+#if HAVE_AVX2
+  // Check eight probes at a time: compute their bit positions, gather the
+  // 32-bit words that hold them and test the bits.  Bit i of the block is
+  // bit i%32 of little-endian word i/32.
+  const __m256i hash = _mm256_set1_epi32(static_cast<int>(h));
+  const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  for (int j = 0; j < k; j += 8) {
+    const __m256i multiplier = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(&multipliers[j]));
+    const __m256i bitpos =
+        _mm256_srli_epi32(_mm256_mullo_epi32(hash, multiplier), 23);
+    const __m256i words = _mm256_i32gather_epi32(
+        reinterpret_cast<const int*>(block), _mm256_srli_epi32(bitpos, 5), 4);
+    const __m256i bits = _mm256_sllv_epi32(
+        _mm256_set1_epi32(1), _mm256_and_si256(bitpos, _mm256_set1_epi32(31)));
+    // Only the first k-j lanes are probes of this key.
+    const __m256i active = _mm256_cmpgt_epi32(_mm256_set1_epi32(k - j), lanes);
+    const __m256i missing =
+        _mm256_and_si256(_mm256_andnot_si256(words, bits), active);
+    if (!_mm256_testz_si256(missing, missing)) {
+      return false;
+    }
+  }
+  return true;
+#else
+  assert(false);
+  return true;
+#endif  // HAVE_AVX2
+}
+
+}  // namespace leveldb
@@ -0,0 +1,25 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_UTIL_BLOOM_AVX2_H_
+#define STORAGE_LEVELDB_UTIL_BLOOM_AVX2_H_
+
+#include <cstdint>
+
+namespace leveldb {
+
+// Returns true if CacheLocalBloomProbesAVX2() was built with AVX2 and the
+// CPU supports it.
+bool CanUseCacheLocalBloomProbesAVX2();
+
+// Returns true if every one of the first k probes of hash h is set in the
+// 64-byte block, where probe j is bit (h * multipliers[j]) >> 23 of it.
+// multipliers must hold k entries rounded up to a multiple of 8.  Must
+// only be called if CanUseCacheLocalBloomProbesAVX2() returns true.
+bool CacheLocalBloomProbesAVX2(const char* block, uint32_t h, int k,
+                               const uint32_t* multipliers);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_BLOOM_AVX2_H_
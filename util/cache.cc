@@ -17,6 +17,12 @@ namespace leveldb {
 
 Cache::~Cache() {}
 
+Cache::Handle* Cache::Insert(const Slice& key, void* value, size_t charge,
+                             void (*deleter)(const Slice& key, void* value),
+                             Priority priority) {
+  return Insert(key, value, charge, deleter);
+}
+
 namespace {
 
 // LRU cache implementation
@@ -74,6 +80,7 @@ struct LRUHandle {
   size_t charge;  // TODO(opt): Only allow uint32_t?
   size_t key_length;
   bool in_cache;     // Whether entry is in the cache.
+  bool in_high_pri_pool;  // Whether entry is in the high priority pool.
   uint32_t refs;     // References, including cache reference, if present.
   uint32_t hash;     // Hash of key(); used for fast sharding and comparisons
   char key_data[1];  // Beginning of key
@@ -232,13 +239,17 @@ class LRUCache {
   // Separate from constructor so caller can easily make an array of LRUCache
   // 与构造函数分开, 这样调用者可以轻松地制作 LRUCache 的数组
   // (因为 数组使用 空参 构造函数)
-  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+  void SetCapacity(size_t capacity, double high_pri_pool_ratio) {
+    capacity_ = capacity;
+    high_pri_capacity_ = static_cast<size_t>(capacity * high_pri_pool_ratio);
+  }
 
   // Like Cache methods, but with an extra "hash" parameter.
   // 像 Cache 的方法, 但有一个额外的 "hash" 参数 (hash 紧跟在 key 之后)
   Cache::Handle* Insert(const Slice& key, uint32_t hash, void* value,
                         size_t charge,
-                        void (*deleter)(const Slice& key, void* value));
+                        void (*deleter)(const Slice& key, void* value),
+                        Cache::Priority priority);
   Cache::Handle* Lookup(const Slice& key, uint32_t hash);
   void Release(Cache::Handle* handle);
   void Erase(const Slice& key, uint32_t hash);
@@ -255,14 +266,19 @@ class LRUCache {
   void Ref(LRUHandle* e);
   void Unref(LRUHandle* e);
   bool FinishErase(LRUHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Moves the oldest unused entries of the high priority pool to lru_
+  // while the pool is over its capacity.
+  void MaintainPoolSize() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   // Initialized before use.
   size_t capacity_;
+  size_t high_pri_capacity_;
 
   // mutex_ protects the following state.
   // mutex_ 保护 后面的状态 (所以 LRUCache 是 线程安全的)
   mutable port::Mutex mutex_;
   size_t usage_ GUARDED_BY(mutex_);
+  size_t high_pri_usage_ GUARDED_BY(mutex_);  // Charge of the pool entries
 
   // Dummy head of LRU list.
   // lru.prev is newest entry, lru.next is oldest entry.
@@ -280,16 +296,24 @@ class LRUCache {
   // 说明该 entry 虽然仍然被 一个 client 持有, 但是已经在被 顶替/Erase 了
   LRUHandle in_use_ GUARDED_BY(mutex_);
 
+  // Dummy head of the LRU list of the high priority pool, which is
+  // evicted from only once lru_ is empty.  Entries have refs==1,
+  // in_cache==true and in_high_pri_pool==true.
+  LRUHandle high_pri_lru_ GUARDED_BY(mutex_);
+
   HandleTable table_ GUARDED_BY(mutex_);
 };
 
-LRUCache::LRUCache() : capacity_(0), usage_(0) {
+LRUCache::LRUCache()
+    : capacity_(0), high_pri_capacity_(0), usage_(0), high_pri_usage_(0) {
   // Make empty circular linked lists.
   // 制作空的循环链表
   lru_.next = &lru_;
   lru_.prev = &lru_;
   in_use_.next = &in_use_;
   in_use_.prev = &in_use_;
+  high_pri_lru_.next = &high_pri_lru_;
+  high_pri_lru_.prev = &high_pri_lru_;
 }
 
 LRUCache::~LRUCache() {
@@ -305,6 +329,14 @@ LRUCache::~LRUCache() {
     Unref(e);
     e = next;
   }
+  for (LRUHandle* e = high_pri_lru_.next; e != &high_pri_lru_;) {
+    LRUHandle* next = e->next;
+    assert(e->in_cache);
+    e->in_cache = false;
+    assert(e->refs == 1);  // Invariant of high_pri_lru_ list.
+    Unref(e);
+    e = next;
+  }
 }
 
 // e->refs == 1 && e->in_cache 表明 e 对应的元素 在 lru_ 链表中
@@ -339,6 +371,22 @@ void LRUCache::Unref(LRUHandle* e) {
     // No longer in use; move to lru_ list.
     // 不再使用; 移动到链表 lru_
     LRU_Remove(e);
+    if (e->in_high_pri_pool) {
+      LRU_Append(&high_pri_lru_, e);
+      MaintainPoolSize();
+    } else {
+      LRU_Append(&lru_, e);
+    }
+  }
+}
+
+void LRUCache::MaintainPoolSize() {
+  while (high_pri_usage_ > high_pri_capacity_ &&
+         high_pri_lru_.next != &high_pri_lru_) {
+    LRUHandle* e = high_pri_lru_.next;
+    LRU_Remove(e);
+    e->in_high_pri_pool = false;
+    high_pri_usage_ -= e->charge;
     LRU_Append(&lru_, e);
   }
 }
@@ -387,7 +435,8 @@ void LRUCache::Release(Cache::Handle* handle) {
 Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
                                 size_t charge,
                                 void (*deleter)(const Slice& key,
-                                                void* value)) {
+                                                void* value),
+                                Cache::Priority priority) {
   MutexLock l(&mutex_);
 
   // 注意这里分配的 堆空间 大小
@@ -399,6 +448,7 @@ Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
   e->key_length = key.size();
   e->hash = hash;
   e->in_cache = false;
+  e->in_high_pri_pool = false;
   // [note] 这里因为返回了一个 handle 所以 refs 初始值为 1
   e->refs = 1;  // for the returned handle.
   std::memcpy(e->key_data, key.data(), key.size());
@@ -412,8 +462,13 @@ Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
     e->in_cache = true;
     LRU_Append(&in_use_, e);
     usage_ += charge;
+    if (priority == Cache::kHighPriority && high_pri_capacity_ > 0) {
+      e->in_high_pri_pool = true;
+      high_pri_usage_ += charge;
+    }
     // 如果 key 对应的数据已经存在, 则 FinishErase() 会将旧数据 删除
     FinishErase(table_.Insert(e));
+    MaintainPoolSize();
   } else {  // don't cache. (capacity_==0 is supported and turns off caching.)
     // next is read by key() in an assert, so it must be initialized
     // 不要缓存. (capacity_==0 是支持的, 用于 关闭缓存.)
@@ -422,8 +477,9 @@ Cache::Handle* LRUCache::Insert(const Slice& key, uint32_t hash, void* value,
   }
   // 当 缓存使用量 > 缓存容量 并且 lru_ 非空 的情况下
   //     调用 FinishErase() 将 lru_ 头部的项 移除
-  while (usage_ > capacity_ && lru_.next != &lru_) {
-    LRUHandle* old = lru_.next;
+  while (usage_ > capacity_ &&
+         (lru_.next != &lru_ || high_pri_lru_.next != &high_pri_lru_)) {
+    LRUHandle* old = lru_.next != &lru_ ? lru_.next : high_pri_lru_.next;
     assert(old->refs == 1);
     bool erased = FinishErase(table_.Remove(old->key(), old->hash));
     if (!erased) {  // to avoid unused variable when compiled NDEBUG
@@ -450,6 +506,10 @@ bool LRUCache::FinishErase(LRUHandle* e) {
     LRU_Remove(e);
     e->in_cache = false;
     usage_ -= e->charge;
+    if (e->in_high_pri_pool) {
+      e->in_high_pri_pool = false;
+      high_pri_usage_ -= e->charge;
+    }
     Unref(e);
   }
   return e != nullptr;
@@ -465,8 +525,8 @@ void LRUCache::Erase(const Slice& key, uint32_t hash) {
 // Prune() 删除数据库的 内存读取缓存, 以便客户端可以缓解其内存不足
 void LRUCache::Prune() {
   MutexLock l(&mutex_);
-  while (lru_.next != &lru_) {
-    LRUHandle* e = lru_.next;
+  while (lru_.next != &lru_ || high_pri_lru_.next != &high_pri_lru_) {
+    LRUHandle* e = lru_.next != &lru_ ? lru_.next : high_pri_lru_.next;
     assert(e->refs == 1);
     bool erased = FinishErase(table_.Remove(e->key(), e->hash));
     if (!erased) {  // to avoid unused variable when compiled NDEBUG
@@ -497,18 +557,25 @@ class ShardedLRUCache : public Cache {
 
  public:
   // 计算 每个分片的 容量大小 并设置
-  explicit ShardedLRUCache(size_t capacity) : last_id_(0) {
+  ShardedLRUCache(size_t capacity, double high_pri_pool_ratio)
+      : last_id_(0) {
     const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
     for (int s = 0; s < kNumShards; s++) {
-      shard_[s].SetCapacity(per_shard);
+      shard_[s].SetCapacity(per_shard, high_pri_pool_ratio);
     }
   }
   ~ShardedLRUCache() override {}
   // 根据 key 的 哈希值 的 前 kNumShardBits 位 来决定使用哪个分片
   Handle* Insert(const Slice& key, void* value, size_t charge,
                  void (*deleter)(const Slice& key, void* value)) override {
+    return Insert(key, value, charge, deleter, kLowPriority);
+  }
+  Handle* Insert(const Slice& key, void* value, size_t charge,
+                 void (*deleter)(const Slice& key, void* value),
+                 Priority priority) override {
     const uint32_t hash = HashSlice(key);
-    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter,
+                                      priority);
   }
   Handle* Lookup(const Slice& key) override {
     const uint32_t hash = HashSlice(key);
@@ -545,6 +612,10 @@ class ShardedLRUCache : public Cache {
 
 }  // end anonymous namespace
 
-Cache* NewLRUCache(size_t capacity) { return new ShardedLRUCache(capacity); }
+Cache* NewLRUCache(size_t capacity) { return new ShardedLRUCache(capacity, 0); }
+
+Cache* NewLRUCache(size_t capacity, double high_pri_pool_ratio) {
+  return new ShardedLRUCache(capacity, high_pri_pool_ratio);
+}
 
 }  // namespace leveldb
@@ -75,6 +75,12 @@ class CacheTest : public testing::Test {
                           &CacheTest::Deleter);
   }
 
+  void InsertHighPriority(int key, int value, int charge = 1) {
+    cache_->Release(cache_->Insert(EncodeKey(key), EncodeValue(value), charge,
+                                   &CacheTest::Deleter,
+                                   Cache::kHighPriority));
+  }
+
   // 擦除 key
   void Erase(int key) { cache_->Erase(EncodeKey(key)); }
   // 为了配合 Deleter 单独保存每一个 测试用例中删除的 key/value
@@ -189,6 +195,39 @@ TEST_F(CacheTest, EvictionPolicy) {
   cache_->Release(h);
 }
 
+TEST_F(CacheTest, HighPriorityPool) {
+  delete cache_;
+  cache_ = NewLRUCache(kCacheSize, 0.5);
+  InsertHighPriority(100, 101);
+  InsertHighPriority(200, 201);
+
+  // High priority entries outlive any number of low priority ones.
+  for (int i = 0; i < 2 * kCacheSize; i++) {
+    Insert(1000 + i, 2000 + i);
+  }
+  ASSERT_EQ(101, Lookup(100));
+  ASSERT_EQ(201, Lookup(200));
+  ASSERT_EQ(-1, Lookup(1000));
+  ASSERT_EQ(2000 + 2 * kCacheSize - 1, Lookup(1000 + 2 * kCacheSize - 1));
+
+  // But newer high priority entries push them out of the pool.
+  for (int i = 0; i < 2 * kCacheSize; i++) {
+    InsertHighPriority(10000 + i, 20000 + i);
+  }
+  ASSERT_EQ(-1, Lookup(100));
+  ASSERT_EQ(-1, Lookup(200));
+  ASSERT_LE(cache_->TotalCharge(), kCacheSize + 16);
+}
+
+TEST_F(CacheTest, HighPriorityWithoutPool) {
+  // Without a high priority pool, priorities make no difference.
+  InsertHighPriority(100, 101);
+  for (int i = 0; i < 2 * kCacheSize; i++) {
+    Insert(1000 + i, 2000 + i);
+  }
+  ASSERT_EQ(-1, Lookup(100));
+}
+
 // 使用超过缓存大小
 TEST_F(CacheTest, UseExceedsCacheSize) {
   // Overfill the cache, keeping handles on all inserted entries.
@@ -0,0 +1,39 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/dynamic_bloom.h"
+
+#include <cassert>
+#include <new>
+
+#include "util/arena.h"
+
+namespace leveldb {
+
+static const size_t kCacheLineSize = 64;
+
+DynamicBloom::DynamicBloom(Arena* arena, size_t total_bits, int num_probes)
+    : num_probes_(num_probes) {
+  assert(num_probes > 0);
+  size_t blocks = (total_bits + kBlockBits - 1) / kBlockBits;
+  if (blocks < 1) blocks = 1;
+  if (blocks > UINT32_MAX) blocks = UINT32_MAX;
+  num_blocks_ = static_cast<uint32_t>(blocks);
+
+  // Align the blocks to cache lines so that each probe sequence touches
+  // a single line.
+  const size_t bytes = size_t{num_blocks_} * kWordsPerBlock * sizeof(uint64_t);
+  char* raw = arena->AllocateAligned(bytes + kCacheLineSize - 1);
+  const uintptr_t misalignment =
+      reinterpret_cast<uintptr_t>(raw) & (kCacheLineSize - 1);
+  if (misalignment != 0) {
+    raw += kCacheLineSize - misalignment;
+  }
+  data_ = reinterpret_cast<std::atomic<uint64_t>*>(raw);
+  for (size_t i = 0; i < size_t{num_blocks_} * kWordsPerBlock; i++) {
+    new (&data_[i]) std::atomic<uint64_t>(0);
+  }
+}
+
+}  // namespace leveldb
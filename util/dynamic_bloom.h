@@ -0,0 +1,101 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_UTIL_DYNAMIC_BLOOM_H_
+#define STORAGE_LEVELDB_UTIL_DYNAMIC_BLOOM_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "leveldb/slice.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+class Arena;
+
+// A bloom filter that keys are added to one at a time, for in-memory
+// structures such as the memtable whose final number of keys is not
+// known up front.  All probes of a key fall into the same 64-byte block,
+// so a lookup touches a single cache line.
+//
+// Add() may run concurrently with MayContain(); AddConcurrently() may
+// also run concurrently with other calls to AddConcurrently().
+class DynamicBloom {
+ public:
+  // Allocates a filter of (about) total_bits bits from *arena, which
+  // must outlive the filter.
+  DynamicBloom(Arena* arena, size_t total_bits, int num_probes = 6);
+
+  DynamicBloom(const DynamicBloom&) = delete;
+  DynamicBloom& operator=(const DynamicBloom&) = delete;
+
+  void Add(const Slice& key) { AddHash(BloomHash(key), false); }
+  void AddConcurrently(const Slice& key) { AddHash(BloomHash(key), true); }
+
+  // Returns false if key was definitely not added.
+  bool MayContain(const Slice& key) const {
+    const uint32_t h = BloomHash(key);
+    const std::atomic<uint64_t>* block = Block(h);
+    uint32_t bits = h * 0x9e3779b9u;  // Remix for the in-block positions
+    const uint32_t delta = (bits >> 17) | (bits << 15);
+    for (int i = 0; i < num_probes_; i++) {
+      const uint32_t bitpos = bits & (kBlockBits - 1);
+      const uint64_t word = block[bitpos / 64].load(std::memory_order_relaxed);
+      if ((word & (uint64_t{1} << (bitpos % 64))) == 0) {
+        return false;
+      }
+      bits += delta;
+    }
+    return true;
+  }
+
+  size_t total_bits() const { return size_t{num_blocks_} * kBlockBits; }
+
+ private:
+  static constexpr uint32_t kBlockBits = 512;
+  static constexpr uint32_t kWordsPerBlock = kBlockBits / 64;
+
+  static uint32_t BloomHash(const Slice& key) {
+    return Hash(key.data(), key.size(), 0x5bd1e995);
+  }
+
+  // The high bits of h pick the block; the remixed hash picks the bits
+  // inside of it, so the two choices are independent.
+  std::atomic<uint64_t>* Block(uint32_t h) const {
+    const uint32_t index =
+        static_cast<uint32_t>((uint64_t{h} * num_blocks_) >> 32);
+    return data_ + size_t{index} * kWordsPerBlock;
+  }
+
+  void AddHash(uint32_t h, bool concurrent) {
+    std::atomic<uint64_t>* block = Block(h);
+    uint32_t bits = h * 0x9e3779b9u;
+    const uint32_t delta = (bits >> 17) | (bits << 15);
+    for (int i = 0; i < num_probes_; i++) {
+      const uint32_t bitpos = bits & (kBlockBits - 1);
+      const uint64_t mask = uint64_t{1} << (bitpos % 64);
+      std::atomic<uint64_t>* word = &block[bitpos / 64];
+      if (concurrent) {
+        // Skip the locked instruction if the bit is already set.
+        if ((word->load(std::memory_order_relaxed) & mask) == 0) {
+          word->fetch_or(mask, std::memory_order_relaxed);
+        }
+      } else {
+        word->store(word->load(std::memory_order_relaxed) | mask,
+                    std::memory_order_relaxed);
+      }
+      bits += delta;
+    }
+  }
+
+  uint32_t num_blocks_;
+  int num_probes_;
+  std::atomic<uint64_t>* data_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_DYNAMIC_BLOOM_H_
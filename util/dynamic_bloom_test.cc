@@ -0,0 +1,97 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/dynamic_bloom.h"
+
+#include "gtest/gtest.h"
+#include "util/arena.h"
+#include "util/coding.h"
+#include "util/testutil.h"
+
+namespace leveldb {
+
+static const int kVerbose = 0;
+
+static Slice Key(int i, char* buffer) {
+  EncodeFixed32(buffer, i);
+  return Slice(buffer, sizeof(uint32_t));
+}
+
+static double FalsePositiveRate(const DynamicBloom& bloom) {
+  char buffer[sizeof(int)];
+  int result = 0;
+  for (int i = 0; i < 10000; i++) {
+    if (bloom.MayContain(Key(i + 1000000000, buffer))) {
+      result++;
+    }
+  }
+  return result / 10000.0;
+}
+
+TEST(DynamicBloomTest, Empty) {
+  Arena arena;
+  DynamicBloom bloom(&arena, 1000);
+  ASSERT_TRUE(!bloom.MayContain("hello"));
+  ASSERT_TRUE(!bloom.MayContain("world"));
+}
+
+TEST(DynamicBloomTest, Small) {
+  Arena arena;
+  DynamicBloom bloom(&arena, 0);
+  ASSERT_EQ(512, bloom.total_bits());
+  bloom.Add("hello");
+  bloom.Add("world");
+  ASSERT_TRUE(bloom.MayContain("hello"));
+  ASSERT_TRUE(bloom.MayContain("world"));
+  ASSERT_TRUE(!bloom.MayContain("x"));
+  ASSERT_TRUE(!bloom.MayContain("foo"));
+}
+
+TEST(DynamicBloomTest, VaryingLengths) {
+  char buffer[sizeof(int)];
+  for (int length = 1; length <= 100000; length *= 10) {
+    Arena arena;
+    // Ten bits per key.
+    DynamicBloom bloom(&arena, length * 10);
+    for (int i = 0; i < length; i++) {
+      bloom.Add(Key(i, buffer));
+    }
+    for (int i = 0; i < length; i++) {
+      ASSERT_TRUE(bloom.MayContain(Key(i, buffer)))
+          << "Length " << length << "; key " << i;
+    }
+    // Blocking costs some accuracy compared to a standard bloom filter.
+    double rate = FalsePositiveRate(bloom);
+    if (kVerbose >= 1) {
+      std::fprintf(stderr, "False positives: %5.2f%% @ length = %6d\n",
+                   rate * 100.0, length);
+    }
+    ASSERT_LE(rate, 0.03);
+  }
+}
+
+// Several threads calling AddConcurrently() on the same filter.
+static const int kAddThreads = 4;
+static const int kKeysPerAddThread = 10000;
+
+static void ConcurrentAdder(void* arg, int id) {
+  DynamicBloom* bloom = reinterpret_cast<DynamicBloom*>(arg);
+  char buffer[sizeof(int)];
+  for (int i = 0; i < kKeysPerAddThread; i++) {
+    bloom->AddConcurrently(Key(i * kAddThreads + id, buffer));
+  }
+}
+
+TEST(DynamicBloomTest, AddConcurrently) {
+  Arena arena;
+  DynamicBloom bloom(&arena, kAddThreads * kKeysPerAddThread * 10);
+  test::RunConcurrently(kAddThreads, ConcurrentAdder, &bloom);
+
+  char buffer[sizeof(int)];
+  for (int i = 0; i < kAddThreads * kKeysPerAddThread; i++) {
+    ASSERT_TRUE(bloom.MayContain(Key(i, buffer))) << i;
+  }
+}
+
+}  // namespace leveldb
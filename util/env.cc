@@ -22,6 +22,30 @@ Status Env::NewAppendableFile(const std::string& fname, WritableFile** result) {
   return Status::NotSupported("NewAppendableFile", fname);
 }
 
+Status Env::ReuseWritableFile(const std::string& fname,
+                              const std::string& old_fname,
+                              WritableFile** result) {
+  Status s = RenameFile(old_fname, fname);
+  if (!s.ok()) {
+    *result = nullptr;
+    return s;
+  }
+  return NewWritableFile(fname, result);
+}
+
+void Env::MultiRead(const RandomAccessFile* const* files, ReadRequest* reqs,
+                    size_t num_reqs) {
+  size_t start = 0;
+  while (start < num_reqs) {
+    size_t end = start + 1;
+    while (end < num_reqs && files[end] == files[start]) {
+      end++;
+    }
+    files[start]->MultiRead(reqs + start, end - start);
+    start = end;
+  }
+}
+
 Status Env::RemoveDir(const std::string& dirname) { return DeleteDir(dirname); }
 Status Env::DeleteDir(const std::string& dirname) { return RemoveDir(dirname); }
 
@@ -32,8 +56,17 @@ SequentialFile::~SequentialFile() = default;
 
 RandomAccessFile::~RandomAccessFile() = default;
 
+void RandomAccessFile::MultiRead(ReadRequest* reqs, size_t num_reqs) const {
+  for (size_t i = 0; i < num_reqs; i++) {
+    ReadRequest* req = &reqs[i];
+    req->status = Read(req->offset, req->n, &req->result, req->scratch);
+  }
+}
+
 WritableFile::~WritableFile() = default;
 
+void WritableFile::SetPreallocationBlockSize(size_t block_size) {}
+
 Logger::~Logger() = default;
 
 FileLock::~FileLock() = default;
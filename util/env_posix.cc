@@ -13,6 +13,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cerrno>
 #include <cstddef>
@@ -20,6 +21,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <limits>
 #include <queue>
 #include <set>
@@ -27,6 +29,7 @@
 #include <thread>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "leveldb/env.h"
 #include "leveldb/slice.h"
@@ -36,6 +39,10 @@
 #include "util/env_posix_test_helper.h"
 #include "util/posix_logger.h"
 
+#if HAVE_LIBURING
+#include <liburing.h>
+#endif  // HAVE_LIBURING
+
 namespace leveldb {
 
 namespace {
@@ -49,6 +56,11 @@ constexpr const int kDefaultMmapLimit = (sizeof(void*) >= 8) ? 1000 : 0;
 // Can be set using EnvPosixTestHelper::SetReadOnlyMMapLimit().
 int g_mmap_limit = kDefaultMmapLimit;
 
+// Number of upcoming io_uring submissions that are to fail without
+// submitting anything.  Can be set using
+// EnvPosixTestHelper::SetIoUringSubmitFailures().
+std::atomic<int> g_io_uring_submit_failures{0};
+
 // Common flags defined for all posix open operations
 #if defined(HAVE_O_CLOEXEC)
 constexpr const int kOpenBaseFlags = O_CLOEXEC;
@@ -129,6 +141,132 @@ class Limiter {
   std::atomic<int> acquires_allowed_;
 };
 
+// Runs the reads of RandomAccessFile::MultiRead() and Env::MultiRead()
+// calls on a few helper threads.  The calling thread reads as well, so a
+// call never has to wait for helpers that are busy with other calls.
+class ParallelReader {
+ public:
+  static ParallelReader* Default();
+
+  // Calls file->Read() for each of reqs[0,num_reqs-1].
+  void Run(const RandomAccessFile* file, ReadRequest* reqs, size_t num_reqs) {
+    Run(file, nullptr, reqs, num_reqs);
+  }
+
+  // Calls files[i]->Read() for each reqs[i] of reqs[0,num_reqs-1].
+  void Run(const RandomAccessFile* const* files, ReadRequest* reqs,
+           size_t num_reqs) {
+    Run(nullptr, files, reqs, num_reqs);
+  }
+
+ private:
+  // Reads are I/O bound, so there can be more helpers than cores.
+  static constexpr int kMaxHelpers = 8;
+
+  struct Job {
+    const RandomAccessFile* file;
+    const RandomAccessFile* const* files;  // If non-null, used over file
+    ReadRequest* reqs;
+    size_t num_reqs;
+    std::atomic<size_t> next_req;  // Index of the first unclaimed request
+    int helpers;                   // Helpers queued for or running the job
+  };
+
+  ParallelReader() : work_cv_(&mu_), done_cv_(&mu_), started_helpers_(0) {}
+
+  // Performs requests of job until none are left to claim.
+  static void DoReads(Job* job) {
+    size_t i;
+    while ((i = job->next_req.fetch_add(1, std::memory_order_relaxed)) <
+           job->num_reqs) {
+      ReadRequest* req = &job->reqs[i];
+      const RandomAccessFile* file =
+          (job->files != nullptr) ? job->files[i] : job->file;
+      req->status =
+          file->Read(req->offset, req->n, &req->result, req->scratch);
+    }
+  }
+
+  void Run(const RandomAccessFile* file, const RandomAccessFile* const* files,
+           ReadRequest* reqs, size_t num_reqs);
+  void HelperMain();
+
+  port::Mutex mu_;
+  port::CondVar work_cv_ GUARDED_BY(mu_);
+  port::CondVar done_cv_ GUARDED_BY(mu_);
+  std::deque<Job*> queue_ GUARDED_BY(mu_);
+  int started_helpers_ GUARDED_BY(mu_);
+};
+
+ParallelReader* ParallelReader::Default() {
+  // Never destroyed, since the helper threads are never joined.
+  static ParallelReader* reader = new ParallelReader;
+  return reader;
+}
+
+void ParallelReader::Run(const RandomAccessFile* file,
+                         const RandomAccessFile* const* files,
+                         ReadRequest* reqs, size_t num_reqs) {
+  Job job;
+  job.file = file;
+  job.files = files;
+  job.reqs = reqs;
+  job.num_reqs = num_reqs;
+  job.next_req.store(0, std::memory_order_relaxed);
+  job.helpers = 0;
+
+  const size_t wanted_helpers =
+      std::min(num_reqs - 1, static_cast<size_t>(kMaxHelpers));
+  mu_.Lock();
+  while (started_helpers_ < static_cast<int>(wanted_helpers)) {
+    std::thread helper(&ParallelReader::HelperMain, this);
+    helper.detach();
+    started_helpers_++;
+  }
+  for (size_t i = 0; i < wanted_helpers; i++) {
+    queue_.push_back(&job);
+    job.helpers++;
+  }
+  work_cv_.SignalAll();
+  mu_.Unlock();
+
+  DoReads(&job);
+
+  mu_.Lock();
+  // Take back the slots that no helper has picked up yet; there is no
+  // work left for them.
+  for (auto it = queue_.begin(); it != queue_.end();) {
+    if (*it == &job) {
+      it = queue_.erase(it);
+      job.helpers--;
+    } else {
+      ++it;
+    }
+  }
+  while (job.helpers > 0) {
+    done_cv_.Wait();
+  }
+  mu_.Unlock();
+}
+
+void ParallelReader::HelperMain() {
+  mu_.Lock();
+  while (true) {
+    while (queue_.empty()) {
+      work_cv_.Wait();
+    }
+    Job* job = queue_.front();
+    queue_.pop_front();
+    mu_.Unlock();
+    DoReads(job);
+    mu_.Lock();
+    job->helpers--;
+    if (job->helpers == 0) {
+      done_cv_.SignalAll();
+    }
+  }
+}
+
 // Implements sequential read access in a file using read().
 //
 // Instances of this class are thread-friendly but not thread-safe, as required
@@ -223,7 +361,110 @@ class PosixRandomAccessFile final : public RandomAccessFile {
     return status;
   }
 
+  void MultiRead(ReadRequest* reqs, size_t num_reqs) const override {
+    if (num_reqs <= 1) {
+      RandomAccessFile::MultiRead(reqs, num_reqs);
+      return;
+    }
+#if HAVE_LIBURING
+    if (has_permanent_fd_ && IoUringMultiRead(reqs, num_reqs)) {
+      return;
+    }
+#endif  // HAVE_LIBURING
+    ParallelReader::Default()->Run(this, reqs, num_reqs);
+  }
+
  private:
+#if HAVE_LIBURING
+  // Submits all of the reads to a per-thread io_uring and waits for them
+  // to complete.  Returns false if io_uring is not usable, in which case
+  // no read was performed.
+  bool IoUringMultiRead(ReadRequest* reqs, size_t num_reqs) const {
+    static constexpr unsigned kQueueDepth = 64;
+    struct Ring {
+      Ring() { Init(); }
+      ~Ring() {
+        if (ok) io_uring_queue_exit(&ring);
+      }
+      void Init() { ok = (io_uring_queue_init(kQueueDepth, &ring, 0) == 0); }
+      struct io_uring ring;
+      bool ok;
+    };
+    static thread_local Ring ring;
+    if (!ring.ok) {
+      return false;
+    }
+
+    std::vector<bool> completed;
+    for (size_t start = 0; start < num_reqs; start += kQueueDepth) {
+      const size_t batch = std::min<size_t>(kQueueDepth, num_reqs - start);
+      for (size_t i = start; i < start + batch; i++) {
+        struct io_uring_sqe* sqe = io_uring_get_sqe(&ring.ring);
+        assert(sqe != nullptr);
+        io_uring_prep_read(sqe, fd_, reqs[i].scratch,
+                           static_cast<unsigned>(reqs[i].n),
+                           static_cast<off_t>(reqs[i].offset));
+        io_uring_sqe_set_data(sqe, &reqs[i]);
+      }
+
+      // The kernel may take fewer entries than were queued; keep
+      // submitting until it has all of them or refuses to take more.
+      size_t submitted = 0;
+      while (submitted < batch) {
+        int ret;
+        if (g_io_uring_submit_failures.load(std::memory_order_relaxed) > 0) {
+          g_io_uring_submit_failures.fetch_sub(1, std::memory_order_relaxed);
+          ret = -EIO;
+        } else {
+          ret = io_uring_submit(&ring.ring);
+        }
+        if (ret == -EINTR) continue;
+        if (ret <= 0) break;
+        submitted += ret;
+      }
+
+      completed.assign(batch, false);
+      for (size_t i = 0; i < submitted; i++) {
+        struct io_uring_cqe* cqe;
+        int wait_ret;
+        do {
+          wait_ret = io_uring_wait_cqe(&ring.ring, &cqe);
+        } while (wait_ret == -EINTR);
+        assert(wait_ret == 0);
+        (void)wait_ret;
+        ReadRequest* req =
+            reinterpret_cast<ReadRequest*>(io_uring_cqe_get_data(cqe));
+        if (cqe->res < 0) {
+          req->result = Slice(req->scratch, 0);
+          req->status = PosixError(filename_, -cqe->res);
+        } else {
+          req->result = Slice(req->scratch, cqe->res);
+          req->status = Status::OK();
+        }
+        completed[req - &reqs[start]] = true;
+        io_uring_cqe_seen(&ring.ring, cqe);
+      }
+
+      if (submitted < batch) {
+        // The entries that were not submitted are still queued in the
+        // ring and point into this call's buffers.  They cannot be taken
+        // back, so replace the ring before a later call submits them, and
+        // do the rest of the reads with pread().
+        io_uring_queue_exit(&ring.ring);
+        ring.Init();
+        for (size_t i = start; i < num_reqs; i++) {
+          if (i >= start + batch || !completed[i - start]) {
+            reqs[i].status = Read(reqs[i].offset, reqs[i].n, &reqs[i].result,
+                                  reqs[i].scratch);
+          }
+        }
+        return true;
+      }
+    }
+    return true;
+  }
+#endif  // HAVE_LIBURING
+
   const bool has_permanent_fd_;  // If false, the file is opened on every read.
   const int fd_;                 // -1 if has_permanent_fd_ is false.
   Limiter* const fd_limiter_;
@@ -279,6 +520,9 @@ class PosixWritableFile final : public WritableFile {
   PosixWritableFile(std::string filename, int fd)
       : pos_(0),
         fd_(fd),
+        file_size_(0),
+        preallocation_block_size_(0),
+        preallocated_size_(0),
         is_manifest_(IsManifest(filename)),
         filename_(std::move(filename)),
         dirname_(Dirname(filename_)) {}
@@ -321,6 +565,7 @@ class PosixWritableFile final : public WritableFile {
 
   Status Close() override {
     Status status = FlushBuffer();
+    ReleasePreallocatedSpace();
     const int close_result = ::close(fd_);
     if (close_result < 0 && status.ok()) {
       status = PosixError(filename_, errno);
@@ -331,6 +576,10 @@ class PosixWritableFile final : public WritableFile {
 
   Status Flush() override { return FlushBuffer(); }
 
+  void SetPreallocationBlockSize(size_t block_size) override {
+    preallocation_block_size_ = block_size;
+  }
+
   Status Sync() override {
     // Ensure new files referred to by the manifest are in the filesystem.
     //
@@ -358,6 +607,8 @@ class PosixWritableFile final : public WritableFile {
   }
 
   Status WriteUnbuffered(const char* data, size_t size) {
+    PrepareWrite(size);
+    file_size_ += size;
     while (size > 0) {
       ssize_t write_result = ::write(fd_, data, size);
       if (write_result < 0) {
@@ -372,6 +623,54 @@ class PosixWritableFile final : public WritableFile {
     return Status::OK();
   }
 
+  // Preallocate the blocks covering the next "size" bytes of the file if
+  // they have not been preallocated yet.  The file size is left
+  // unchanged, so readers never see the preallocated space.
+  void PrepareWrite(size_t size) {
+#if HAVE_FALLOCATE
+    if (preallocation_block_size_ == 0 || size == 0) {
+      return;
+    }
+    const uint64_t end = file_size_ + size;
+    if (end <= preallocated_size_) {
+      return;
+    }
+    const uint64_t block_size = preallocation_block_size_;
+    const uint64_t new_size = (end + block_size - 1) / block_size * block_size;
+    // Preallocation is only an optimization, so errors are ignored.
+    if (::fallocate(fd_, FALLOC_FL_KEEP_SIZE, preallocated_size_,
+                    new_size - preallocated_size_) == 0) {
+      preallocated_size_ = new_size;
+    } else {
+      preallocation_block_size_ = 0;  // Not supported by this file system
+    }
+#else
+    (void)size;
+#endif  // HAVE_FALLOCATE
+  }
+
+  // Release the preallocated blocks past the end of the file, which would
+  // otherwise stay allocated for as long as the file exists.
+  void ReleasePreallocatedSpace() {
+#if HAVE_FALLOCATE
+    if (preallocated_size_ == 0) {
+      return;
+    }
+    struct ::stat file_stat;
+    if (::fstat(fd_, &file_stat) == 0 &&
+        static_cast<uint64_t>(file_stat.st_size) < preallocated_size_) {
+      // Like preallocation, releasing the space is best effort.  Some file
+      // systems free the blocks past the end of the file on a truncation to
+      // the same size, others only on a hole punched there.
+      int truncate_result = ::ftruncate(fd_, file_stat.st_size);
+      (void)truncate_result;
+      ::fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  file_stat.st_size, preallocated_size_ - file_stat.st_size);
+    }
+    preallocated_size_ = 0;
+#endif  // HAVE_FALLOCATE
+  }
+
   Status SyncDirIfManifest() {
     Status status;
     if (!is_manifest_) {
@@ -459,6 +758,10 @@ class PosixWritableFile final : public WritableFile {
   size_t pos_;
   int fd_;
 
+  uint64_t file_size_;  // Bytes handed to write(2) so far.
+  size_t preallocation_block_size_;
+  uint64_t preallocated_size_;  // Bytes preallocated with fallocate(2).
+
   const bool is_manifest_;  // True if the file's name starts with MANIFEST.
   const std::string filename_;
   const std::string dirname_;  // The directory of filename_.
@@ -570,6 +873,22 @@ class PosixEnv : public Env {
     return status;
   }
 
+  void MultiRead(const RandomAccessFile* const* files, ReadRequest* reqs,
+                 size_t num_reqs) override {
+    if (num_reqs == 0) {
+      return;
+    }
+    if (std::all_of(files + 1, files + num_reqs,
+                    [files](const RandomAccessFile* f) {
+                      return f == files[0];
+                    })) {
+      // Let the file pick how to read, e.g. with io_uring.
+      files[0]->MultiRead(reqs, num_reqs);
+      return;
+    }
+    ParallelReader::Default()->Run(files, reqs, num_reqs);
+  }
+
   Status NewWritableFile(const std::string& filename,
                          WritableFile** result) override {
     int fd = ::open(filename.c_str(),
@@ -583,6 +902,26 @@ class PosixEnv : public Env {
     return Status::OK();
   }
 
+  Status ReuseWritableFile(const std::string& filename,
+                           const std::string& old_filename,
+                           WritableFile** result) override {
+    if (std::rename(old_filename.c_str(), filename.c_str()) != 0) {
+      *result = nullptr;
+      return PosixError(old_filename, errno);
+    }
+
+    // Do not truncate: the point of reusing the file is to overwrite
+    // blocks that are already allocated.
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | kOpenBaseFlags, 0644);
+    if (fd < 0) {
+      *result = nullptr;
+      return PosixError(filename, errno);
+    }
+
+    *result = new PosixWritableFile(filename, fd);
+    return Status::OK();
+  }
+
   Status NewAppendableFile(const std::string& filename,
                            WritableFile** result) override {
     int fd = ::open(filename.c_str(),
@@ -918,6 +1257,10 @@ void EnvPosixTestHelper::SetReadOnlyMMapLimit(int limit) {
   g_mmap_limit = limit;
 }
 
+void EnvPosixTestHelper::SetIoUringSubmitFailures(int count) {
+  g_io_uring_submit_failures.store(count, std::memory_order_relaxed);
+}
+
 Env* Env::Default() {
   static PosixDefaultEnv env_container;
   return env_container.env();
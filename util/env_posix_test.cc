@@ -3,6 +3,7 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include <sys/resource.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -176,6 +177,10 @@ class EnvPosixTest : public testing::Test {
     EnvPosixTestHelper::SetReadOnlyMMapLimit(mmap_limit);
   }
 
+  static void SetIoUringSubmitFailures(int count) {
+    EnvPosixTestHelper::SetIoUringSubmitFailures(count);
+  }
+
   EnvPosixTest() : env_(Env::Default()) {}
 
   Env* env_;
@@ -212,6 +217,202 @@ TEST_F(EnvPosixTest, TestOpenOnRead) {
   ASSERT_LEVELDB_OK(env_->RemoveFile(test_file));
 }
 
+TEST_F(EnvPosixTest, TestMultiRead) {
+  std::string test_dir;
+  ASSERT_LEVELDB_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file = test_dir + "/multi_read.txt";
+  std::string data;
+  for (int i = 0; i < 10000; i++) {
+    data.push_back(static_cast<char>('a' + i % 26));
+  }
+  ASSERT_LEVELDB_OK(WriteStringToFile(env_, data, test_file));
+
+  // Open enough files to get mmap-ed, pread() and open-on-read files.
+  const int kNumFiles = kReadOnlyFileLimit + kMMapLimit + 2;
+  leveldb::RandomAccessFile* files[kNumFiles] = {0};
+  for (int i = 0; i < kNumFiles; i++) {
+    ASSERT_LEVELDB_OK(env_->NewRandomAccessFile(test_file, &files[i]));
+  }
+  const int kNumReqs = 20;
+  for (int i = 0; i < kNumFiles; i++) {
+    ReadRequest reqs[kNumReqs];
+    std::string scratch[kNumReqs];
+    for (int r = 0; r < kNumReqs; r++) {
+      reqs[r].offset = r * 499;
+      reqs[r].n = 100 + r;
+      scratch[r].resize(reqs[r].n);
+      reqs[r].scratch = &scratch[r][0];
+    }
+    // Ends exactly at the end of the file.
+    reqs[kNumReqs - 1].offset = data.size() - reqs[kNumReqs - 1].n;
+    files[i]->MultiRead(reqs, kNumReqs);
+    for (int r = 0; r < kNumReqs; r++) {
+      ASSERT_LEVELDB_OK(reqs[r].status);
+      ASSERT_EQ(data.substr(reqs[r].offset, reqs[r].n),
+                reqs[r].result.ToString());
+    }
+  }
+  for (int i = 0; i < kNumFiles; i++) {
+    delete files[i];
+  }
+  ASSERT_LEVELDB_OK(env_->RemoveFile(test_file));
+}
+
+TEST_F(EnvPosixTest, TestMultiReadOfSeveralFiles) {
+  std::string test_dir;
+  ASSERT_LEVELDB_OK(env_->GetTestDirectory(&test_dir));
+  const int kNumFiles = 3;
+  std::string data[kNumFiles];
+  leveldb::RandomAccessFile* files[kNumFiles] = {0};
+  for (int i = 0; i < kNumFiles; i++) {
+    for (int j = 0; j < 5000; j++) {
+      data[i].push_back(static_cast<char>('a' + (i + j) % 26));
+    }
+    const std::string test_file =
+        test_dir + "/multi_read_" + std::to_string(i) + ".txt";
+    ASSERT_LEVELDB_OK(WriteStringToFile(env_, data[i], test_file));
+    ASSERT_LEVELDB_OK(env_->NewRandomAccessFile(test_file, &files[i]));
+  }
+
+  // Requests of the files are interleaved.
+  const int kNumReqs = 12;
+  ReadRequest reqs[kNumReqs];
+  const RandomAccessFile* req_files[kNumReqs];
+  std::string scratch[kNumReqs];
+  for (int r = 0; r < kNumReqs; r++) {
+    req_files[r] = files[r % kNumFiles];
+    reqs[r].offset = r * 300;
+    reqs[r].n = 50 + r;
+    scratch[r].resize(reqs[r].n);
+    reqs[r].scratch = &scratch[r][0];
+  }
+  env_->MultiRead(req_files, reqs, kNumReqs);
+  for (int r = 0; r < kNumReqs; r++) {
+    ASSERT_LEVELDB_OK(reqs[r].status);
+    ASSERT_EQ(data[r % kNumFiles].substr(reqs[r].offset, reqs[r].n),
+              reqs[r].result.ToString());
+  }
+
+  for (int i = 0; i < kNumFiles; i++) {
+    delete files[i];
+    ASSERT_LEVELDB_OK(env_->RemoveFile(test_dir + "/multi_read_" +
+                                       std::to_string(i) + ".txt"));
+  }
+}
+
+TEST_F(EnvPosixTest, TestMultiReadAfterFailedSubmit) {
+  std::string test_dir;
+  ASSERT_LEVELDB_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file = test_dir + "/multi_read_failed_submit.txt";
+  std::string data;
+  for (int i = 0; i < 10000; i++) {
+    data.push_back(static_cast<char>('a' + i % 26));
+  }
+  ASSERT_LEVELDB_OK(WriteStringToFile(env_, data, test_file));
+
+  // Use up the mmap regions so that the last file is read with pread() or
+  // io_uring.
+  leveldb::RandomAccessFile* files[kMMapLimit + 1] = {0};
+  for (int i = 0; i < kMMapLimit + 1; i++) {
+    ASSERT_LEVELDB_OK(env_->NewRandomAccessFile(test_file, &files[i]));
+  }
+  RandomAccessFile* file = files[kMMapLimit];
+
+  const int kNumReqs = 8;
+  ReadRequest first[kNumReqs];
+  std::string first_scratch[kNumReqs];
+  for (int r = 0; r < kNumReqs; r++) {
+    first[r].offset = r * 1000;
+    first[r].n = 100;
+    first_scratch[r].resize(first[r].n);
+    first[r].scratch = &first_scratch[r][0];
+  }
+  // The reads are done some other way when the submission fails.
+  SetIoUringSubmitFailures(1);
+  file->MultiRead(first, kNumReqs);
+  SetIoUringSubmitFailures(0);
+  for (int r = 0; r < kNumReqs; r++) {
+    ASSERT_LEVELDB_OK(first[r].status);
+    ASSERT_EQ(data.substr(first[r].offset, first[r].n),
+              first[r].result.ToString());
+  }
+
+  // A later MultiRead() must not perform reads left over from the failed
+  // submission, which would write into the buffers of the first call.
+  for (int r = 0; r < kNumReqs; r++) {
+    first_scratch[r].assign(first[r].n, 'X');
+  }
+  ReadRequest second[kNumReqs];
+  std::string second_scratch[kNumReqs];
+  for (int r = 0; r < kNumReqs; r++) {
+    second[r].offset = r * 1000 + 500;
+    second[r].n = 100;
+    second_scratch[r].resize(second[r].n);
+    second[r].scratch = &second_scratch[r][0];
+  }
+  file->MultiRead(second, kNumReqs);
+  for (int r = 0; r < kNumReqs; r++) {
+    ASSERT_LEVELDB_OK(second[r].status);
+    ASSERT_EQ(data.substr(second[r].offset, second[r].n),
+              second[r].result.ToString());
+    ASSERT_EQ(std::string(first[r].n, 'X'), first_scratch[r]);
+  }
+
+  for (int i = 0; i < kMMapLimit + 1; i++) {
+    delete files[i];
+  }
+  ASSERT_LEVELDB_OK(env_->RemoveFile(test_file));
+}
+
+TEST_F(EnvPosixTest, TestReuseWritableFile) {
+  std::string test_dir;
+  ASSERT_LEVELDB_OK(env_->GetTestDirectory(&test_dir));
+  const std::string old_file = test_dir + "/reuse_old.txt";
+  const std::string new_file = test_dir + "/reuse_new.txt";
+
+  ASSERT_LEVELDB_OK(WriteStringToFile(env_, "abcdefghij", old_file));
+  leveldb::WritableFile* file;
+  ASSERT_LEVELDB_OK(env_->ReuseWritableFile(new_file, old_file, &file));
+  ASSERT_LEVELDB_OK(file->Append("XYZ"));
+  ASSERT_LEVELDB_OK(file->Close());
+  delete file;
+
+  // The file is overwritten in place, not truncated.
+  ASSERT_FALSE(env_->FileExists(old_file));
+  std::string contents;
+  ASSERT_LEVELDB_OK(ReadFileToString(env_, new_file, &contents));
+  ASSERT_EQ("XYZdefghij", contents);
+  ASSERT_LEVELDB_OK(env_->RemoveFile(new_file));
+}
+
+TEST_F(EnvPosixTest, TestPreallocation) {
+  std::string test_dir;
+  ASSERT_LEVELDB_OK(env_->GetTestDirectory(&test_dir));
+  const std::string test_file = test_dir + "/preallocate.txt";
+
+  leveldb::WritableFile* file;
+  ASSERT_LEVELDB_OK(env_->NewWritableFile(test_file, &file));
+  file->SetPreallocationBlockSize(1 << 20);
+  std::string data(100000, 'x');
+  for (int i = 0; i < 30; i++) {
+    ASSERT_LEVELDB_OK(file->Append(data));
+    ASSERT_LEVELDB_OK(file->Sync());
+  }
+  ASSERT_LEVELDB_OK(file->Close());
+  delete file;
+
+  // Preallocated space must not show up in the file size.
+  uint64_t size;
+  ASSERT_LEVELDB_OK(env_->GetFileSize(test_file, &size));
+  ASSERT_EQ(30 * data.size(), size);
+
+  // Nor stay allocated once the file is closed.
+  struct stat file_stat;
+  ASSERT_EQ(0, ::stat(test_file.c_str(), &file_stat));
+  ASSERT_LT(file_stat.st_blocks * 512, size + (64 << 10));
+  ASSERT_LEVELDB_OK(env_->RemoveFile(test_file));
+}
+
 #if HAVE_O_CLOEXEC
 
 TEST_F(EnvPosixTest, TestCloseOnExecSequentialFile) {
@@ -21,6 +21,10 @@ class EnvPosixTestHelper {
   // Set the maximum number of read-only files that will be mapped via mmap.
   // Must be called before creating an Env.
   static void SetReadOnlyMMapLimit(int limit);
+
+  // Make the next "count" io_uring submissions of RandomAccessFile::
+  // MultiRead() fail, leaving their reads queued in the ring.
+  static void SetIoUringSubmitFailures(int count);
 };
 
 }  // namespace leveldb
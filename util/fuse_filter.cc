@@ -0,0 +1,284 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "leveldb/filter_policy.h"
+#include "leveldb/slice.h"
+#include "util/coding.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+namespace {
+
+// Size of the seed, segment_count, segment_lg and bits fields at the end
+// of a filter.
+static const size_t kTrailerSize = 8 + 4 + 1 + 1;
+
+// Number of seeds to try before giving up on building a filter.
+static const int kMaxAttempts = 100;
+
+// Segments have at most 2^kMaxSegmentLg slots.
+static const int kMaxSegmentLg = 18;
+
+// A binary fuse filter [Graf,Lemire 2022] stores one fingerprint_bits
+// wide slot per 1.125 keys or so (more for small filters).  Each key
+// maps to three slots in consecutive segments of the slot array, and
+// the slots are assigned such that the XOR of the three slots of a key
+// is the fingerprint of the key.  A key that was not added matches with
+// probability 2^-fingerprint_bits.
+//
+// Filter format:
+//    slots:          packed fingerprint_bits wide values, little-endian
+//    padding:        3 zero bytes, so that slots can be read as fixed32s
+//    seed:           fixed64
+//    segment_count:  fixed32
+//    segment_lg:     uint8      log2 of the number of slots per segment
+//    bits:           uint8      fingerprint_bits, or 0 if the filter
+//                               matches all keys
+//
+// The slots of a filter over no keys are empty and the filter never
+// matches.
+class BinaryFuseFilterPolicy : public FilterPolicy {
+ public:
+  explicit BinaryFuseFilterPolicy(int fingerprint_bits)
+      : bits_(std::max(1, std::min(fingerprint_bits, 16))) {}
+
+  const char* Name() const override { return "leveldb.BinaryFuseFilter"; }
+
+  void CreateFilter(const Slice* keys, int n, std::string* dst) const override {
+    // Keys that are equal, or whose hashes are, must be added only once.
+    std::vector<uint64_t> hashes(n);
+    for (int i = 0; i < n; i++) {
+      hashes[i] = FuseHash(keys[i]);
+    }
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+    const size_t size = hashes.size();
+
+    Layout layout(size);
+    std::vector<uint16_t> slots;
+    uint64_t seed = 0x726b2b9d438b9d4dull;
+    int bits = bits_;
+    if (size == 0) {
+      layout.Init(0, layout.segment_lg);
+    } else {
+      bool ok = false;
+      for (int attempt = 0; attempt < kMaxAttempts && !ok; attempt++) {
+        seed = seed * 0x5851f42d4c957f2dull + 0x14057b7ef767814full;
+        ok = Populate(hashes, layout, seed, &slots);
+      }
+      if (!ok) {
+        bits = 0;  // Should not happen; fall back to matching everything
+      }
+    }
+
+    // Pack the slots.
+    const size_t num_slots =
+        (size > 0 && bits > 0) ? layout.array_length : 0;
+    const size_t init_size = dst->size();
+    dst->resize(init_size + (num_slots * bits + 7) / 8 + 3, 0);
+    char* array = &(*dst)[init_size];
+    for (size_t i = 0; i < num_slots; i++) {
+      const size_t bitpos = i * bits;
+      char* p = array + bitpos / 8;
+      EncodeFixed32(p, DecodeFixed32(p) |
+                           (static_cast<uint32_t>(slots[i]) << (bitpos % 8)));
+    }
+    PutFixed64(dst, seed);
+    PutFixed32(dst, layout.segment_count);
+    dst->push_back(static_cast<char>(layout.segment_lg));
+    dst->push_back(static_cast<char>(bits));
+  }
+
+  bool KeyMayMatch(const Slice& key, const Slice& filter) const override {
+    const size_t len = filter.size();
+    if (len < kTrailerSize + 3) return false;
+    const char* trailer = filter.data() + len - kTrailerSize;
+    const int bits = static_cast<unsigned char>(trailer[13]);
+    if (bits == 0) return true;
+    if (bits > 16) return true;  // Reserved for new encodings
+
+    const uint32_t segment_count = DecodeFixed32(trailer + 8);
+    const int segment_lg = static_cast<unsigned char>(trailer[12]);
+    if (segment_count == 0) return false;
+    const uint64_t array_length = (uint64_t{segment_count} + 2)
+                                  << std::min(segment_lg, kMaxSegmentLg);
+    if (segment_lg > kMaxSegmentLg || array_length > UINT32_MAX ||
+        (array_length * bits + 7) / 8 > len - kTrailerSize - 3) {
+      return true;  // Corrupted: consider it a match
+    }
+    const Layout layout(segment_count, segment_lg);
+
+    const uint64_t hash = Remix(FuseHash(key), DecodeFixed64(trailer));
+    uint32_t h[3];
+    layout.Slots(hash, h);
+    const char* array = filter.data();
+    const uint32_t mask = (uint32_t{1} << bits) - 1;
+    uint32_t f = Fingerprint(hash) & mask;
+    for (int i = 0; i < 3; i++) {
+      const size_t bitpos = static_cast<size_t>(h[i]) * bits;
+      f ^= (DecodeFixed32(array + bitpos / 8) >> (bitpos % 8)) & mask;
+    }
+    return f == 0;
+  }
+
+ private:
+  // Sizes of the slot array for a given number of keys.
+  struct Layout {
+    explicit Layout(size_t size) {
+      segment_lg = size == 0 ? 2
+                             : static_cast<int>(std::floor(
+                                   std::log(static_cast<double>(size)) /
+                                       std::log(3.33) +
+                                   2.25));
+      segment_lg = std::max(0, std::min(segment_lg, kMaxSegmentLg));
+      const int64_t segment_length = int64_t{1} << segment_lg;
+      const double size_factor =
+          size <= 1 ? 0
+                    : std::max(1.125, 0.875 + 0.25 * std::log(1000000.0) /
+                                                  std::log(static_cast<double>(
+                                                      size)));
+      const int64_t capacity =
+          static_cast<int64_t>(std::round(size * size_factor));
+      int64_t count = (capacity + segment_length - 1) / segment_length - 2;
+      if (count < 1) count = 1;
+      Init(static_cast<uint32_t>(count), segment_lg);
+    }
+
+    Layout(uint32_t segment_count, int segment_lg) {
+      Init(segment_count, segment_lg);
+    }
+
+    void Init(uint32_t count, int lg) {
+      segment_count = count;
+      segment_lg = lg;
+      segment_length = uint32_t{1} << lg;
+      segment_count_length = segment_count << lg;
+      array_length = (segment_count + 2) << lg;
+    }
+
+    // Stores the slots of hash in h[0..2]: one in each of three
+    // consecutive segments.
+    void Slots(uint64_t hash, uint32_t h[3]) const {
+      const uint32_t mask = segment_length - 1;
+      h[0] = static_cast<uint32_t>(((hash >> 32) * segment_count_length) >>
+                                   32);
+      h[1] = (h[0] + segment_length) ^ (static_cast<uint32_t>(hash >> 18) & mask);
+      h[2] = (h[0] + 2 * segment_length) ^ (static_cast<uint32_t>(hash) & mask);
+    }
+
+    uint32_t segment_count;
+    int segment_lg;
+    uint32_t segment_length;
+    uint32_t segment_count_length;
+    uint32_t array_length;
+  };
+
+  static uint64_t FuseHash(const Slice& key) {
+    return Hash64(key.data(), key.size(), 0x2c6fe9967f4a7c15ull);
+  }
+
+  // Derives the hash used for the slots and fingerprint of a key from its
+  // 64-bit hash, differently for every seed.
+  static uint64_t Remix(uint64_t h, uint64_t seed) {
+    uint64_t x = h + seed;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+  }
+
+  static uint32_t Fingerprint(uint64_t hash) {
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+  }
+
+  // Assigns the slots of the filter for the given (distinct) hashes by
+  // peeling: repeatedly remove a key that is the only one left mapping to
+  // some slot, then assign the slots in reverse order of removal.  Returns
+  // false if some keys could not be peeled with this seed.
+  bool Populate(const std::vector<uint64_t>& hashes, const Layout& layout,
+                uint64_t seed, std::vector<uint16_t>* slots) const {
+    const size_t size = hashes.size();
+    const uint32_t n = layout.array_length;
+
+    // For each slot: 4 * (number of keys mapping to it) plus the XOR of
+    // which of its three slots (0, 1 or 2) it is for each of them, and
+    // the XOR of their hashes.  A slot with one key left thus knows the
+    // key and where the slot is among its three.
+    std::vector<uint8_t> count(n, 0);
+    std::vector<uint64_t> xor_hash(n, 0);
+    for (size_t i = 0; i < size; i++) {
+      const uint64_t hash = Remix(hashes[i], seed);
+      uint32_t h[3];
+      layout.Slots(hash, h);
+      for (int j = 0; j < 3; j++) {
+        count[h[j]] += 4;
+        if (count[h[j]] < 4) return false;  // Overflow: try another seed
+        count[h[j]] ^= j;
+        xor_hash[h[j]] ^= hash;
+      }
+    }
+
+    std::vector<uint32_t> alone;
+    alone.reserve(n);
+    for (uint32_t i = 0; i < n; i++) {
+      if ((count[i] >> 2) == 1) alone.push_back(i);
+    }
+    std::vector<uint64_t> peeled_hash;  // In order of removal
+    std::vector<uint8_t> peeled_found;  // Which of its slots freed each key
+    peeled_hash.reserve(size);
+    peeled_found.reserve(size);
+    while (!alone.empty()) {
+      const uint32_t index = alone.back();
+      alone.pop_back();
+      if ((count[index] >> 2) != 1) continue;  // Emptied in the meantime
+      const uint64_t hash = xor_hash[index];
+      const int found = count[index] & 3;
+      peeled_hash.push_back(hash);
+      peeled_found.push_back(static_cast<uint8_t>(found));
+      uint32_t h[3];
+      layout.Slots(hash, h);
+      for (int j = 0; j < 3; j++) {
+        const uint32_t other = h[j];
+        count[other] -= 4;
+        count[other] ^= j;
+        xor_hash[other] ^= hash;
+        if ((count[other] >> 2) == 1) alone.push_back(other);
+      }
+    }
+    if (peeled_hash.size() != size) {
+      return false;
+    }
+
+    const uint32_t mask = (uint32_t{1} << bits_) - 1;
+    slots->assign(n, 0);
+    for (size_t i = size; i-- > 0;) {
+      const uint64_t hash = peeled_hash[i];
+      uint32_t h[3];
+      layout.Slots(hash, h);
+      const int found = peeled_found[i];
+      uint32_t f = Fingerprint(hash) & mask;
+      for (int j = 0; j < 3; j++) {
+        if (j != found) f ^= (*slots)[h[j]];
+      }
+      (*slots)[h[found]] = static_cast<uint16_t>(f);
+    }
+    return true;
+  }
+
+  const int bits_;
+};
+}  // namespace
+
+const FilterPolicy* NewBinaryFuseFilterPolicy(int fingerprint_bits) {
+  return new BinaryFuseFilterPolicy(fingerprint_bits);
+}
+
+}  // namespace leveldb
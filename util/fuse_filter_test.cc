@@ -0,0 +1,175 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "gtest/gtest.h"
+#include "leveldb/filter_policy.h"
+#include "util/coding.h"
+#include "util/testutil.h"
+
+namespace leveldb {
+
+static const int kVerbose = 1;
+
+static Slice Key(int i, char* buffer) {
+  EncodeFixed32(buffer, i);
+  return Slice(buffer, sizeof(uint32_t));
+}
+
+class FuseFilterTest : public testing::Test {
+ public:
+  FuseFilterTest() : policy_(NewBinaryFuseFilterPolicy(8)) {}
+
+  ~FuseFilterTest() { delete policy_; }
+
+  void Reset() {
+    keys_.clear();
+    filter_.clear();
+  }
+
+  void Add(const Slice& s) { keys_.push_back(s.ToString()); }
+
+  void Build() {
+    std::vector<Slice> key_slices;
+    for (size_t i = 0; i < keys_.size(); i++) {
+      key_slices.push_back(Slice(keys_[i]));
+    }
+    filter_.clear();
+    policy_->CreateFilter(key_slices.data(),
+                          static_cast<int>(key_slices.size()), &filter_);
+    keys_.clear();
+  }
+
+  size_t FilterSize() const { return filter_.size(); }
+
+  bool Matches(const Slice& s) {
+    if (!keys_.empty()) {
+      Build();
+    }
+    return policy_->KeyMayMatch(s, filter_);
+  }
+
+  double FalsePositiveRate() {
+    char buffer[sizeof(int)];
+    int result = 0;
+    for (int i = 0; i < 100000; i++) {
+      if (Matches(Key(i + 1000000000, buffer))) {
+        result++;
+      }
+    }
+    return result / 100000.0;
+  }
+
+ private:
+  const FilterPolicy* policy_;
+  std::string filter_;
+  std::vector<std::string> keys_;
+};
+
+TEST_F(FuseFilterTest, EmptyFilter) {
+  ASSERT_TRUE(!Matches("hello"));
+  ASSERT_TRUE(!Matches("world"));
+  Build();
+  ASSERT_TRUE(!Matches("hello"));
+}
+
+TEST_F(FuseFilterTest, Small) {
+  Add("hello");
+  Add("world");
+  ASSERT_TRUE(Matches("hello"));
+  ASSERT_TRUE(Matches("world"));
+  ASSERT_TRUE(!Matches("x"));
+  ASSERT_TRUE(!Matches("foo"));
+}
+
+TEST_F(FuseFilterTest, Duplicates) {
+  Add("hello");
+  Add("hello");
+  Add("world");
+  Add("world");
+  Add("world");
+  ASSERT_TRUE(Matches("hello"));
+  ASSERT_TRUE(Matches("world"));
+  ASSERT_TRUE(!Matches("foo"));
+}
+
+static int NextLength(int length) {
+  if (length < 10) {
+    length += 1;
+  } else if (length < 100) {
+    length += 10;
+  } else if (length < 1000) {
+    length += 100;
+  } else if (length < 10000) {
+    length += 1000;
+  } else {
+    length *= 10;
+  }
+  return length;
+}
+
+TEST_F(FuseFilterTest, VaryingLengths) {
+  char buffer[sizeof(int)];
+
+  for (int length = 1; length <= 1000000; length = NextLength(length)) {
+    Reset();
+    for (int i = 0; i < length; i++) {
+      Add(Key(i, buffer));
+    }
+    Build();
+
+    // Large filters take 1.125 to 1.2 slots of 8 bits per key.
+    if (length >= 100000) {
+      ASSERT_LE(FilterSize(), static_cast<size_t>(length * 1.2) + 100)
+          << length;
+    }
+
+    // All added keys must match
+    for (int i = 0; i < length; i++) {
+      ASSERT_TRUE(Matches(Key(i, buffer)))
+          << "Length " << length << "; key " << i;
+    }
+
+    // Check false positive rate, which should be 1/256.
+    double rate = FalsePositiveRate();
+    if (kVerbose >= 1) {
+      std::fprintf(stderr,
+                   "False positives: %5.2f%% @ length = %7d ; bytes = %7d\n",
+                   rate * 100.0, length, static_cast<int>(FilterSize()));
+    }
+    ASSERT_LE(rate, 0.006);
+  }
+}
+
+TEST(FuseFilterPolicyTest, FingerprintBits) {
+  char buffer[sizeof(int)];
+  std::vector<std::string> keys;
+  for (int i = 0; i < 10000; i++) {
+    keys.push_back(Key(i, buffer).ToString());
+  }
+  std::vector<Slice> key_slices(keys.begin(), keys.end());
+
+  for (int bits : {1, 4, 7, 12, 16}) {
+    const FilterPolicy* policy = NewBinaryFuseFilterPolicy(bits);
+    std::string filter;
+    policy->CreateFilter(key_slices.data(), static_cast<int>(keys.size()),
+                         &filter);
+    for (const Slice& key : key_slices) {
+      ASSERT_TRUE(policy->KeyMayMatch(key, filter)) << bits;
+    }
+    int false_positives = 0;
+    for (int i = 0; i < 100000; i++) {
+      false_positives +=
+          policy->KeyMayMatch(Key(i + 1000000000, buffer), filter);
+    }
+    const double rate = false_positives / 100000.0;
+    if (kVerbose >= 1) {
+      std::fprintf(stderr, "%2d bits: %5.3f%% false positives, %5.2f bits/key\n",
+                   bits, rate * 100.0, filter.size() * 8.0 / keys.size());
+    }
+    ASSERT_LE(rate, 1.5 / (1 << bits) + 0.0005) << bits;
+    delete policy;
+  }
+}
+
+}  // namespace leveldb
@@ -52,4 +52,53 @@ uint32_t Hash(const char* data, size_t n, uint32_t seed) {
   return h;
 }
 
+uint64_t Hash64(const char* data, size_t n, uint64_t seed) {
+  const uint64_t m = 0xc6a4a7935bd1e995ull;
+  const int r = 47;
+  const char* limit = data + n;
+  uint64_t h = seed ^ (n * m);
+
+  // Pick up eight bytes at a time
+  while (data + 8 <= limit) {
+    uint64_t w = DecodeFixed64(data);
+    data += 8;
+    w *= m;
+    w ^= (w >> r);
+    w *= m;
+    h ^= w;
+    h *= m;
+  }
+
+  // Pick up remaining bytes
+  switch (limit - data) {
+    case 7:
+      h ^= uint64_t{static_cast<uint8_t>(data[6])} << 48;
+      FALLTHROUGH_INTENDED;
+    case 6:
+      h ^= uint64_t{static_cast<uint8_t>(data[5])} << 40;
+      FALLTHROUGH_INTENDED;
+    case 5:
+      h ^= uint64_t{static_cast<uint8_t>(data[4])} << 32;
+      FALLTHROUGH_INTENDED;
+    case 4:
+      h ^= uint64_t{static_cast<uint8_t>(data[3])} << 24;
+      FALLTHROUGH_INTENDED;
+    case 3:
+      h ^= uint64_t{static_cast<uint8_t>(data[2])} << 16;
+      FALLTHROUGH_INTENDED;
+    case 2:
+      h ^= uint64_t{static_cast<uint8_t>(data[1])} << 8;
+      FALLTHROUGH_INTENDED;
+    case 1:
+      h ^= uint64_t{static_cast<uint8_t>(data[0])};
+      h *= m;
+      break;
+  }
+
+  h ^= (h >> r);
+  h *= m;
+  h ^= (h >> r);
+  return h;
+}
+
 }  // namespace leveldb
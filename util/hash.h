@@ -14,6 +14,10 @@ namespace leveldb {
 
 uint32_t Hash(const char* data, size_t n, uint32_t seed);
 
+// Like Hash(), but with a 64-bit result, for structures that need more
+// hash bits per key than 32 (MurmurHash64A).
+uint64_t Hash64(const char* data, size_t n, uint64_t seed);
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_UTIL_HASH_H_
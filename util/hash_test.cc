@@ -38,4 +38,34 @@ TEST(HASH, SignedUnsignedIssue) {
       0xf333dabb);
 }
 
+TEST(HASH, Hash64) {
+  const uint8_t data1[1] = {0x62};
+  const uint8_t data2[2] = {0xc3, 0x97};
+  const uint8_t data3[3] = {0xe2, 0x99, 0xa5};
+  const uint8_t data4[4] = {0xe1, 0x80, 0xb9, 0x32};
+  const uint8_t data5[48] = {
+      0x01, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00,
+      0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00, 0x18, 0x28, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  };
+
+  ASSERT_EQ(Hash64(0, 0, 0xbc9f1d34), 0x4c61ea3eeda4cb87ull);
+  ASSERT_EQ(
+      Hash64(reinterpret_cast<const char*>(data1), sizeof(data1), 0xbc9f1d34),
+      0x091309f7ef916c8aull);
+  ASSERT_EQ(
+      Hash64(reinterpret_cast<const char*>(data2), sizeof(data2), 0xbc9f1d34),
+      0xa815bcdf1d1af01cull);
+  ASSERT_EQ(
+      Hash64(reinterpret_cast<const char*>(data3), sizeof(data3), 0xbc9f1d34),
+      0x02167564e4d06430ull);
+  ASSERT_EQ(
+      Hash64(reinterpret_cast<const char*>(data4), sizeof(data4), 0xbc9f1d34),
+      0x8f7ed82ffc21071full);
+  ASSERT_EQ(
+      Hash64(reinterpret_cast<const char*>(data5), sizeof(data5), 0x12345678),
+      0xce196580c97aff1eull);
+}
+
 }  // namespace leveldb
@@ -6,6 +6,8 @@
 
 #include <string>
 
+#include "port/port.h"
+#include "port/thread_annotations.h"
 #include "util/random.h"
 
 namespace leveldb {
@@ -47,5 +49,48 @@ Slice CompressibleString(Random* rnd, double compressed_fraction, size_t len,
   return Slice(*dst);
 }
 
+namespace {
+
+struct ConcurrentRun {
+  ConcurrentRun(void (*function)(void*, int), void* arg)
+      : function(function), arg(arg), next_id(0), done(0), done_cv(&mu) {}
+
+  void (*const function)(void*, int);
+  void* const arg;
+  port::Mutex mu;
+  int next_id GUARDED_BY(mu);
+  int done GUARDED_BY(mu);
+  port::CondVar done_cv;
+};
+
+void ConcurrentRunThread(void* arg) {
+  ConcurrentRun* run = reinterpret_cast<ConcurrentRun*>(arg);
+  run->mu.Lock();
+  const int id = run->next_id++;
+  run->mu.Unlock();
+
+  (*run->function)(run->arg, id);
+
+  run->mu.Lock();
+  run->done++;
+  run->done_cv.SignalAll();
+  run->mu.Unlock();
+}
+
+}  // namespace
+
+void RunConcurrently(int num_threads, void (*function)(void* arg, int id),
+                     void* arg) {
+  ConcurrentRun run(function, arg);
+  for (int i = 0; i < num_threads; i++) {
+    Env::Default()->StartThread(ConcurrentRunThread, &run);
+  }
+  run.mu.Lock();
+  while (run.done < num_threads) {
+    run.done_cv.Wait();
+  }
+  run.mu.Unlock();
+}
+
 }  // namespace test
 }  // namespace leveldb
@@ -43,6 +43,12 @@ std::string RandomKey(Random* rnd, int len);
 Slice CompressibleString(Random* rnd, double compressed_fraction, size_t len,
                          std::string* dst);
 
+// Start "num_threads" threads that each call (*function)(arg, id) with a
+// distinct id in [0, num_threads), and return once all of them have
+// returned.
+void RunConcurrently(int num_threads, void (*function)(void* arg, int id),
+                     void* arg);
+
 // A wrapper that allows injection of errors.
 class ErrorEnv : public EnvWrapper {
  public: